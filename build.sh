@@ -1,48 +1,120 @@
 #!/bin/bash
 
-qu3e_sources="src/broadphase/*.cpp src/collision/*.cpp src/common/*.cpp src/dynamics/*.cpp src/math/*.cpp src/scene/*.cpp" 
+# usage: ./build.sh [demo] [bench] [microbench] [replay]
+#   demo       - qu3e_demo, the interactive GLFW/OpenGL demo
+#   bench      - qu3e_bench, the headless benchmark (no GLFW/OpenGL needed)
+#   microbench - qu3e_microbench, narrowphase and solver kernel benchmarks
+#   replay     - qu3e_replay, replays q3Recorder logs and compares step times
+# builds all of them when no target is given
+
+qu3e_sources="src/broadphase/*.cpp src/collision/*.cpp src/common/*.cpp src/debug/*.cpp src/dynamics/*.cpp src/math/*.cpp src/scene/*.cpp"
 demo_srcs="demo/demo.cpp demo/gl.c"
+bench_srcs="demo/bench.cpp"
+microbench_srcs="demo/microbench.cpp"
+replay_srcs="demo/replay.cpp"
 imgui_srcs="imgui/*.cpp imgui/backends/imgui_impl_glfw.cpp imgui/backends/imgui_impl_opengl3.cpp"
-all_srcs="$qu3e_sources $demo_srcs $imgui_srcs"
 
-libs=" -lglfw -lunwind -ldw"
+libs=" -lunwind -ldw"
+gl_libs=" -lglfw"
 include_dirs="-I. -Iimgui"
-flags="-std=c++20  -Wno-format-security"
+flags="-std=c++20  -Wno-format-security -pthread"
 
 cc=g++
 obj_dir=obj-cache
 
-exe=qu3e_demo
+# Q3_RELEASE=1 ./build.sh builds optimized, use it for benchmarking
+if [ "$Q3_RELEASE" = 1 ]; then
+  flags="$flags -O2"
+  obj_dir=$obj_dir-release
+fi
+
+# Q3_SIMD=1 ./build.sh backs q3Vec3/q3Mat3 with SSE (x86) or NEON (arm64)
+if [ "$Q3_SIMD" = 1 ]; then
+  flags="$flags -DQ3_SIMD"
+  obj_dir=$obj_dir-simd
+fi
+
+# Q3_STEP_STATS=1 ./build.sh records per-phase timings into q3Scene::stats
+if [ "$Q3_STEP_STATS" = 1 ]; then
+  flags="$flags -DQ3_STEP_STATS"
+  obj_dir=$obj_dir-stats
+fi
+
+# Q3_TRACE=1 ./build.sh compiles in the Step timeline tracing of q3Trace.h
+if [ "$Q3_TRACE" = 1 ]; then
+  flags="$flags -DQ3_TRACE"
+  obj_dir=$obj_dir-trace
+fi
+
+targets="$@"
+if [ -z "$targets" ]; then
+  targets="demo bench microbench replay"
+fi
 
 mkdir -p $obj_dir
 
-all_objs=""
+# compiles the given sources (when out of date) and sets $objs to their objects
+compile() {
+  objs=""
 
-for src_file in $all_srcs
-do
-  obj_file="$obj_dir/$src_file.o"
-  all_objs="$all_objs $obj_file"
-  mkdir -p $(dirname $obj_file)
+  for src_file in $@
+  do
+    obj_file="$obj_dir/$src_file.o"
+    objs="$objs $obj_file"
+    mkdir -p $(dirname $obj_file)
 
-  file_deps=$($cc -MM $src_file $include_dirs | tr "\\\\\n" " " | cut -d " " -f3-)
+    file_deps=$($cc -MM $src_file $include_dirs $flags | tr "\\\\\n" " " | cut -d " " -f3-)
 
-  should_recompile=false
-  if [ "$src_file" -nt "$obj_file" ]; then
-    should_recompile=true
-  else for dep in $file_deps; do
-    if [ "$dep" -nt "$obj_file" ]; then
+    should_recompile=false
+    if [ "$src_file" -nt "$obj_file" ]; then
       should_recompile=true
+    else for dep in $file_deps; do
+      if [ "$dep" -nt "$obj_file" ]; then
+        should_recompile=true
+      fi
+      done
     fi
-    done
-  fi
 
-  if [ $should_recompile = true ]; then
-    echo "compiling $src_file..."
-    $cc -c $src_file -o $obj_file $libs $include_dirs $flags
-  fi
-done
+    if [ $should_recompile = true ]; then
+      echo "compiling $src_file..."
+      $cc -c $src_file -o $obj_file $include_dirs $flags || exit 1
+    fi
+  done
+}
 
-echo "linking..."
-$cc -fuse-ld=mold -o $exe $all_objs $libs $include_dirs $flags
+compile $qu3e_sources
+qu3e_objs=$objs
 
-echo "done. built executable '$exe'"
+for target in $targets
+do
+  case $target in
+    demo)
+      compile $demo_srcs $imgui_srcs
+      echo "linking qu3e_demo..."
+      $cc -fuse-ld=mold -o qu3e_demo $qu3e_objs $objs $libs $gl_libs $include_dirs $flags || exit 1
+      echo "done. built executable 'qu3e_demo'"
+      ;;
+    bench)
+      compile $bench_srcs
+      echo "linking qu3e_bench..."
+      $cc -o qu3e_bench $qu3e_objs $objs $libs $include_dirs $flags || exit 1
+      echo "done. built executable 'qu3e_bench'"
+      ;;
+    microbench)
+      compile $microbench_srcs
+      echo "linking qu3e_microbench..."
+      $cc -o qu3e_microbench $qu3e_objs $objs $libs $include_dirs $flags || exit 1
+      echo "done. built executable 'qu3e_microbench'"
+      ;;
+    replay)
+      compile $replay_srcs
+      echo "linking qu3e_replay..."
+      $cc -o qu3e_replay $qu3e_objs $objs $libs $include_dirs $flags || exit 1
+      echo "done. built executable 'qu3e_replay'"
+      ;;
+    *)
+      echo "unknown target '$target', expected 'demo', 'bench', 'microbench' or 'replay'"
+      exit 1
+      ;;
+  esac
+done
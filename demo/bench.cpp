@@ -0,0 +1,341 @@
+// Headless benchmark. Runs the demo scenes (and scaled up stacks) for a fixed
+// number of steps without any window or GL context and prints ms/step
+// percentiles, so regressions can be tracked on machines without a GPU.
+//
+// usage: qu3e_bench [--steps N] [--seed N] [--threads N] [--iterations N] [--substeps N]
+//                   [--position-iterations N] [--deterministic] [--trace FILE]
+//                   [--record FILE] [--check-determinism] [scene ...]
+//   scenes: drop_boxes ray_push box_stack box_stack_10k box_stack_50k
+//           box_stack_100k, or "all". Defaults to the three demo scenes.
+//   --threads steps on a q3JobSystem with N worker threads besides the main one
+//   --iterations sets q3Scene::iterations (default 20), per substep with --substeps
+//   --substeps sets q3Scene::substeps, the number of solver substeps per step
+//   --position-iterations sets q3Scene::position_iterations (default 0, Baumgarte)
+//   --deterministic steps in deterministic mode and prints the final state hash,
+//           which must not change with --threads
+//   --trace writes a Chrome/Perfetto timeline of the run (needs -DQ3_TRACE)
+//   --record writes a q3Recorder log of the run for qu3e_replay (one scene only)
+//   --check-determinism steps each scene deterministic without a job system and
+//           on one with --threads workers (default 3), compares the state hash
+//           after every step and exits with 1 on the first mismatch. Prints no
+//           timings; --steps defaults to 3000.
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/q3.h"
+#include "scenes.h"
+
+struct BenchCase {
+    const char* name;
+    Demo* (*create)(q3Scene* scene);
+    bool in_default_set;
+};
+
+static const BenchCase bench_cases[] = {
+    {"drop_boxes", [](q3Scene* s) -> Demo* { return new DropBoxes(s); }, true},
+    {"ray_push", [](q3Scene* s) -> Demo* { return new RayPush(s); }, true},
+    {"box_stack", [](q3Scene* s) -> Demo* { return new BoxStack(s); }, true},
+    {"box_stack_10k", [](q3Scene* s) -> Demo* { return new BoxStack(s, 32, 10, 32); }, false},
+    {"box_stack_50k", [](q3Scene* s) -> Demo* { return new BoxStack(s, 70, 10, 72); }, false},
+    {"box_stack_100k", [](q3Scene* s) -> Demo* { return new BoxStack(s, 100, 10, 100); }, false},
+};
+constexpr usize bench_case_count = sizeof(bench_cases) / sizeof(bench_cases[0]);
+
+#ifdef Q3_STEP_STATS
+// Sums the phase timings of every step, printed as per-step means
+static void AccumulateStats(q3StepStats* sum, const q3StepStats& step) {
+    sum->test_collisions += step.test_collisions;
+    sum->island_build += step.island_build;
+    sum->island_integrate += step.island_integrate;
+    sum->island_presolve += step.island_presolve;
+    sum->island_iterations += step.island_iterations;
+    sum->island_writeback += step.island_writeback;
+    sum->island_positions += step.island_positions;
+    sum->contact_events += step.contact_events;
+    sum->synchronize_proxies += step.synchronize_proxies;
+    sum->find_new_contacts += step.find_new_contacts;
+    sum->islands += step.islands;
+    sum->manifold_points += step.manifold_points;
+}
+
+static void PrintStats(const q3StepStats& sum, u32 steps) {
+    f64 n = f64(steps);
+    printf(
+        "    narrowphase %.3f  island build %.3f  integrate %.3f  presolve %.3f  iterations "
+        "%.3f  writeback %.3f  positions %.3f  events %.3f  sync proxies %.3f  broadphase %.3f "
+        "(mean ms)\n",
+        sum.test_collisions / n, sum.island_build / n, sum.island_integrate / n,
+        sum.island_presolve / n, sum.island_iterations / n, sum.island_writeback / n,
+        sum.island_positions / n, sum.contact_events / n, sum.synchronize_proxies / n,
+        sum.find_new_contacts / n
+    );
+    printf(
+        "    islands %.1f  manifold points %.1f (mean per step)\n", f64(sum.islands) / n,
+        f64(sum.manifold_points) / n
+    );
+}
+#endif
+
+// Nearest rank percentile of an ascending sorted slice
+static f64 Percentile(Slice<f64> sorted, f64 p) {
+    usize rank = usize(p / 100.0 * f64(sorted.len) + 0.5);
+    if (rank > 0) rank -= 1;
+    if (rank >= sorted.len) rank = sorted.len - 1;
+    return sorted[rank];
+}
+
+struct BenchOptions {
+    u32 steps;
+    u32 iterations;
+    u32 substeps;
+    u32 position_iterations;
+    bool deterministic;
+};
+
+static void RunCase(
+    const BenchCase& bench, const BenchOptions& options, u32 seed, q3JobInterface* jobs,
+    FILE* record
+) {
+    using Clock = std::chrono::steady_clock;
+
+    srand(seed);
+
+    q3Scene scene(1.0 / 60.0);
+    scene.jobs = jobs;
+    scene.iterations = options.iterations;
+    scene.substeps = options.substeps;
+    scene.position_iterations = options.position_iterations;
+    scene.deterministic = options.deterministic;
+    q3Recorder recorder;
+    if (record) recorder.Start(&scene, record).unwrap();
+    Demo* demo = bench.create(&scene);
+    defer(delete demo);
+    demo->Init();
+
+    auto samples = ArrayList<f64>::init(scene.allocator);
+    defer(samples.deinit());
+    samples.ensureTotalCapacity(options.steps).unwrap();
+    Q3_STATS(q3StepStats stats_sum = {});
+
+    for (u32 i = 0; i < options.steps; ++i) {
+        auto start = Clock::now();
+        scene.Step();
+        demo->Update();
+        auto end = Clock::now();
+        samples.append(std::chrono::duration<f64, std::milli>(end - start).count()).unwrap();
+        Q3_STATS(AccumulateStats(&stats_sum, scene.stats));
+    }
+
+    usize bodies = scene.bodies.len;
+    usize contacts = scene.contact_manager.contacts.len;
+    if (record) recorder.Stop().unwrap();
+    demo->Shutdown();
+
+    f64 total = 0.0;
+    for (f64 ms : samples.items) total += ms;
+    std::sort(samples.items.ptr, samples.items.ptr + samples.items.len);
+
+    printf(
+        "%-16s %8zu %9zu %7u %9.3f %9.3f %9.3f %9.3f %9.3f\n", bench.name, bodies, contacts,
+        options.steps, total / f64(options.steps), Percentile(samples.items, 50.0),
+        Percentile(samples.items, 90.0), Percentile(samples.items, 99.0),
+        samples.items[samples.items.len - 1]
+    );
+    Q3_STATS(PrintStats(stats_sum, options.steps));
+    if (options.deterministic) {
+        printf("    state hash %016llx\n", (unsigned long long)scene.state_hash);
+    }
+    fflush(stdout);
+}
+
+// Steps bench deterministic and appends the state hash after every step
+static void RunHashes(
+    const BenchCase& bench, const BenchOptions& options, u32 seed, q3JobInterface* jobs,
+    ArrayList<u64>* hashes
+) {
+    srand(seed);
+
+    q3Scene scene(1.0 / 60.0);
+    scene.jobs = jobs;
+    scene.iterations = options.iterations;
+    scene.substeps = options.substeps;
+    scene.position_iterations = options.position_iterations;
+    scene.deterministic = true;
+    Demo* demo = bench.create(&scene);
+    defer(delete demo);
+    demo->Init();
+
+    hashes->ensureTotalCapacity(options.steps).unwrap();
+    for (u32 i = 0; i < options.steps; ++i) {
+        scene.Step();
+        demo->Update();
+        hashes->append(scene.state_hash).unwrap();
+    }
+    demo->Shutdown();
+}
+
+// True when stepping on jobs gives the same state hash as stepping on this
+// thread alone, after every step
+static bool CheckDeterminism(
+    const BenchCase& bench, const BenchOptions& options, u32 seed, q3JobSystem* jobs
+) {
+    auto expected = ArrayList<u64>::init(Allocator());
+    defer(expected.deinit());
+    auto actual = ArrayList<u64>::init(Allocator());
+    defer(actual.deinit());
+    RunHashes(bench, options, seed, nullptr, &expected);
+    RunHashes(bench, options, seed, jobs, &actual);
+
+    for (u32 i = 0; i < options.steps; ++i) {
+        if (expected.items[i] == actual.items[i]) continue;
+        printf(
+            "%-16s MISMATCH at step %u: %016llx without jobs, %016llx with %u worker threads\n",
+            bench.name, i, (unsigned long long)expected.items[i],
+            (unsigned long long)actual.items[i], jobs->WorkerCount() - 1
+        );
+        fflush(stdout);
+        return false;
+    }
+    printf(
+        "%-16s ok, %u steps, final state hash %016llx\n", bench.name, options.steps,
+        (unsigned long long)expected.items[options.steps - 1]
+    );
+    fflush(stdout);
+    return true;
+}
+
+static void PrintUsage() {
+    fprintf(
+        stderr, "usage: qu3e_bench [--steps N] [--seed N] [--threads N] [--iterations N] "
+                "[--substeps N] [--position-iterations N] [--deterministic] [--trace FILE] "
+                "[--record FILE] [--check-determinism] [scene ...]\n"
+                "scenes:"
+    );
+    for (const BenchCase& bench : bench_cases) fprintf(stderr, " %s", bench.name);
+    fprintf(stderr, " all\n");
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options = {
+        .steps = 600,
+        .iterations = 20,
+        .substeps = 1,
+        .position_iterations = 0,
+        .deterministic = false,
+    };
+    u32 seed = 1;
+    i32 threads = -1;
+    const char* trace_path = nullptr;
+    const char* record_path = nullptr;
+    bool check_determinism = false;
+    bool steps_given = false;
+    bool selected[bench_case_count] = {};
+    bool any_selected = false;
+
+    for (i32 i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (!strcmp(arg, "--steps") && i + 1 < argc) {
+            options.steps = u32(atoi(argv[++i]));
+            steps_given = true;
+        } else if (!strcmp(arg, "--seed") && i + 1 < argc) {
+            seed = u32(atoi(argv[++i]));
+        } else if (!strcmp(arg, "--threads") && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (!strcmp(arg, "--iterations") && i + 1 < argc) {
+            options.iterations = u32(atoi(argv[++i]));
+        } else if (!strcmp(arg, "--substeps") && i + 1 < argc) {
+            options.substeps = u32(atoi(argv[++i]));
+        } else if (!strcmp(arg, "--position-iterations") && i + 1 < argc) {
+            options.position_iterations = u32(atoi(argv[++i]));
+        } else if (!strcmp(arg, "--deterministic")) {
+            options.deterministic = true;
+        } else if (!strcmp(arg, "--trace") && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (!strcmp(arg, "--record") && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (!strcmp(arg, "--check-determinism")) {
+            check_determinism = true;
+        } else if (!strcmp(arg, "all")) {
+            for (usize c = 0; c < bench_case_count; ++c) selected[c] = true;
+            any_selected = true;
+        } else {
+            bool found = false;
+            for (usize c = 0; c < bench_case_count; ++c) {
+                if (!strcmp(arg, bench_cases[c].name)) selected[c] = found = true;
+            }
+            if (!found) {
+                PrintUsage();
+                return 1;
+            }
+            any_selected = true;
+        }
+    }
+
+    if (check_determinism && !steps_given) options.steps = 3000;
+    if (options.steps == 0 || options.iterations == 0 || options.substeps == 0) {
+        PrintUsage();
+        return 1;
+    }
+
+    if (!any_selected) {
+        for (usize c = 0; c < bench_case_count; ++c) selected[c] = bench_cases[c].in_default_set;
+    }
+
+    // A log holds one timed scene
+    usize selected_count = 0;
+    for (usize c = 0; c < bench_case_count; ++c) selected_count += selected[c];
+    if (record_path && (selected_count != 1 || check_determinism)) {
+        PrintUsage();
+        return 1;
+    }
+
+    if (check_determinism) {
+        q3JobSystem jobs(threads > 0 ? threads : 3);
+        bool ok = true;
+        for (usize c = 0; c < bench_case_count; ++c) {
+            if (selected[c]) ok = CheckDeterminism(bench_cases[c], options, seed, &jobs) && ok;
+        }
+        return ok ? 0 : 1;
+    }
+
+    FILE* record = nullptr;
+    if (record_path) {
+        record = fopen(record_path, "wb");
+        if (!record) {
+            fprintf(stderr, "could not open %s\n", record_path);
+            return 1;
+        }
+    }
+    defer(if (record) fclose(record));
+
+    printf(
+        "%-16s %8s %9s %7s %9s %9s %9s %9s %9s\n", "scene", "bodies", "contacts", "steps",
+        "mean_ms", "p50_ms", "p90_ms", "p99_ms", "max_ms"
+    );
+    if (trace_path) q3TraceStart();
+
+    // Without --threads everything runs on this thread
+    q3JobSystem* jobs = threads >= 0 ? new q3JobSystem(threads) : nullptr;
+    defer(delete jobs);
+
+    for (usize c = 0; c < bench_case_count; ++c) {
+        if (selected[c]) RunCase(bench_cases[c], options, seed, jobs, record);
+    }
+
+    if (trace_path) {
+        q3TraceStop();
+        FILE* file = fopen(trace_path, "w");
+        if (!file) {
+            fprintf(stderr, "could not open %s\n", trace_path);
+            return 1;
+        }
+        q3TraceWrite(file);
+        fclose(file);
+    }
+
+    return 0;
+}
@@ -1,15 +1,20 @@
-#include "src/math/q3Vec3.h"
 #include <cmath>
+#include <float.h>
 #include <math.h>
+#include <stdio.h>
 #define GLFW_INCLUDE_NONE
+// The engine headers go before imgui, whose <assert.h> would otherwise shadow
+// debug::assert in the inline math code
+#include "../src/q3.h"
+#include "../src/zig_style/debug.cpp"
+
 #include <GLFW/glfw3.h>
 #include "gl.h"
 #include "../imgui/imgui.h"
 #include "../imgui/backends/imgui_impl_glfw.h"
 #include "../imgui/backends/imgui_impl_opengl3.h"
 
-#include "../src/q3.h"
-#include "../src/zig_style/debug.cpp"
+#include "scenes.h"
 
 float dt = 1 / 60.f;
 
@@ -256,195 +261,102 @@ void gl_error_callback(
     debug::print(", id=%u) %s\n", id, msg);
 }
 
-struct Demo {
-    virtual ~Demo() {}
-
-    virtual void Init(){};
-    virtual void Update(){};
-    virtual void Shutdown(){};
-
-    virtual void Render(q3Render* debugDrawer) { (void)debugDrawer; }
-};
-
-struct DropBoxes : public Demo {
-    float acc;
+#ifdef Q3_STEP_STATS
+// Performance panel: rolling graphs of the stats q3Scene::Step records
+constexpr int perf_history_len = 240;
 
-    virtual void Init() {
-        acc = 0;
+struct PerfHistory {
+    float samples[perf_history_len] = {};
+    int offset = 0; // Oldest sample, PlotLines starts drawing here
 
-        // Create the floor
-        q3Body* body = scene.CreateBody({});
-
-        q3BoxDef boxDef;
-        boxDef.m_restitution = 0;
-        q3Transform tx;
-        q3Identity(tx);
-        boxDef.Set(tx, q3Vec3(50.0f, 1.0f, 50.0f));
-        body->SetBox(boxDef);
+    void Push(f64 value) {
+        samples[offset] = float(value);
+        offset = (offset + 1) % perf_history_len;
     }
 
-    virtual void Update() {
-        acc += dt;
-
-        if (acc > 1.0f) {
-            acc = 0;
-
-            q3Body* body = scene.CreateBody({
-                .axis = q3Vec3(q3RandomFloat(-1, 1), q3RandomFloat(-1, 1), q3RandomFloat(-1, 1)),
-                .angle = q3PI * q3RandomFloat(-1, 1),
-                .position = q3Vec3(0, 3, 0),
-                .linearVelocity =
-                    q3Vec3(q3RandomFloat(1, 3), q3RandomFloat(1, 3), q3RandomFloat(1, 3)) *
-                    q3Sign(q3RandomFloat(-1, 1)),
-                .angularVelocity =
-                    q3Vec3(q3RandomFloat(1, 3), q3RandomFloat(1, 3), q3RandomFloat(1, 3)) *
-                    q3Sign(q3RandomFloat(-1, 1)),
-                .bodyType = eDynamicBody,
-            });
-
-            q3Transform tx;
-            q3Identity(tx);
-            q3BoxDef boxDef;
-            boxDef.Set(tx, q3Vec3(1.0f, 1.0f, 1.0f));
-            body->SetBox(boxDef);
-        }
+    void Plot(const char* label, const char* format) const {
+        char overlay[32];
+        float last = samples[(offset + perf_history_len - 1) % perf_history_len];
+        snprintf(overlay, sizeof(overlay), format, last);
+        ImGui::PlotLines(
+            label, samples, perf_history_len, offset, overlay, 0.0f, FLT_MAX, ImVec2(0, 40)
+        );
     }
-
-    virtual void Shutdown() { scene.RemoveAllBodies(); }
 };
 
-class Raycast : public q3QueryCallback {
-public:
-    q3RaycastData data;
-    r32 tfinal;
-    q3Vec3 nfinal;
-    q3Body* impactBody;
-
-    bool ReportShape(q3Box* shape) {
-        if (data.toi < tfinal) {
-            tfinal = data.toi;
-            nfinal = data.normal;
-            impactBody = shape->body;
-        }
-
-        data.toi = tfinal;
-        return true;
-    }
-
-    void Init(const q3Vec3& spot, const q3Vec3& dir) {
-        data.start = spot;
-        data.dir = q3Normalize(dir);
-        data.t = r32(10000.0);
-        tfinal = FLT_MAX;
-        data.toi = data.t;
-        impactBody = NULL;
-    }
+static const struct {
+    const char* name;
+    f64 q3StepStats::*ms;
+} perf_phases[] = {
+    {"Total", &q3StepStats::total},
+    {"Narrowphase", &q3StepStats::test_collisions},
+    {"Island build", &q3StepStats::island_build},
+    {"Integrate", &q3StepStats::island_integrate},
+    {"Presolve", &q3StepStats::island_presolve},
+    {"Iterations", &q3StepStats::island_iterations},
+    {"Writeback", &q3StepStats::island_writeback},
+    {"Positions", &q3StepStats::island_positions},
+    {"Contact events", &q3StepStats::contact_events},
+    {"Sync proxies", &q3StepStats::synchronize_proxies},
+    {"Broadphase", &q3StepStats::find_new_contacts},
 };
 
-struct RayPush : Demo {
-    float acc;
-    Raycast rayCast;
+static const struct {
+    const char* section;
+    const char* name;
+    usize q3StepStats::*count;
+    f64 scale;
+} perf_counters[] = {
+    {"Counts", "Bodies", &q3StepStats::bodies, 1.0},
+    {"Counts", "Contacts", &q3StepStats::contacts, 1.0},
+    {"Counts", "Pairs", &q3StepStats::pairs, 1.0},
+    {"Counts", "Islands", &q3StepStats::islands, 1.0},
+    {"Counts", "Manifold points", &q3StepStats::manifold_points, 1.0},
+    {"Allocator", "Alloc calls", &q3StepStats::alloc_calls, 1.0},
+    {"Allocator", "Free calls", &q3StepStats::free_calls, 1.0},
+    {"Allocator", "Live KiB", &q3StepStats::live_bytes, 1.0 / 1024.0},
+    {"Broadphase churn", "Inserted", &q3StepStats::proxies_inserted, 1.0},
+    {"Broadphase churn", "Removed", &q3StepStats::proxies_removed, 1.0},
+    {"Broadphase churn", "Moved", &q3StepStats::proxies_moved, 1.0},
+};
 
-    void Init() {
-        acc = 0;
+constexpr usize perf_phase_count = sizeof(perf_phases) / sizeof(perf_phases[0]);
+constexpr usize perf_counter_count = sizeof(perf_counters) / sizeof(perf_counters[0]);
 
-        // Create the floor
-        q3Body* body = scene.CreateBody({});
+static PerfHistory phase_history[perf_phase_count];
+static PerfHistory counter_history[perf_counter_count];
 
-        q3BoxDef boxDef;
-        boxDef.m_restitution = 0;
-        q3Transform tx;
-        q3Identity(tx);
-        boxDef.Set(tx, q3Vec3(50.0f, 1.0f, 50.0f));
-        body->SetBox(boxDef);
+static void RecordPerf(const q3StepStats& stats) {
+    for (usize i = 0; i < perf_phase_count; ++i) phase_history[i].Push(stats.*perf_phases[i].ms);
+    for (usize i = 0; i < perf_counter_count; ++i) {
+        counter_history[i].Push(f64(stats.*perf_counters[i].count) * perf_counters[i].scale);
     }
+}
 
-    void Update() {
-        acc += dt;
-
-        if (acc > 1.0f) {
-            acc = 0;
-
-            q3Body* body = scene.CreateBody({
-                .axis = q3Vec3(q3RandomFloat(-1, 1), q3RandomFloat(-1, 1), q3RandomFloat(-1, 1)),
-                .angle = q3PI * q3RandomFloat(-1, 1),
-                .position = q3Vec3(0, 3, 0),
-                .linearVelocity =
-                    q3Vec3(q3RandomFloat(1, 3), q3RandomFloat(1, 3), q3RandomFloat(1, 3)) *
-                    q3Sign(q3RandomFloat(-1, 1)),
-                .angularVelocity =
-                    q3Vec3(q3RandomFloat(1, 3), q3RandomFloat(1, 3), q3RandomFloat(1, 3)) *
-                    q3Sign(q3RandomFloat(-1, 1)),
-                .bodyType = eDynamicBody,
-            });
-
-            q3Transform tx;
-            q3Identity(tx);
-            q3BoxDef boxDef;
-            boxDef.Set(tx, q3Vec3(1.0f, 1.0f, 1.0f));
-            body->SetBox(boxDef);
-        }
-
-        rayCast.Init(q3Vec3(3.0f, 5.0f, 3.0f), q3Vec3(-1.0f, -1.0f, -1.0f));
-        scene.RayCast(&rayCast, rayCast.data);
-
-        if (rayCast.impactBody) {
-            rayCast.impactBody->ApplyForceAtWorldPoint(
-                rayCast.data.dir * 20.0f, rayCast.data.GetImpactPoint()
-            );
+static void DrawPerfPanel() {
+    ImGui::Begin("Performance");
+    if (ImGui::CollapsingHeader("Step phases (ms)", ImGuiTreeNodeFlags_DefaultOpen)) {
+        for (usize i = 0; i < perf_phase_count; ++i) {
+            phase_history[i].Plot(perf_phases[i].name, "%.3f ms");
         }
     }
-
-    void Shutdown() { scene.RemoveAllBodies(); }
-
-    void Render(q3Render* render) {
-        render->SetScale(1.0f, 1.0f, 1.0f);
-        render->SetPenColor(0.2f, 0.5f, 1.0f);
-        render->SetPenPosition(rayCast.data.start.x, rayCast.data.start.y, rayCast.data.start.z);
-        q3Vec3 impact = rayCast.data.GetImpactPoint();
-        render->Line(impact.x, impact.y, impact.z);
-
-        render->SetPenPosition(impact.x, impact.y, impact.z);
-        render->SetPenColor(1.0f, 0.5f, 0.5f);
-        render->SetScale(10.0f, 10.0f, 10.0f);
-        render->Point();
-
-        render->SetPenColor(1.0f, 0.5f, 0.2f);
-        render->SetScale(1.0f, 1.0f, 1.0f);
-        impact += rayCast.nfinal * 2.0f;
-        render->Line(impact.x, impact.y, impact.z);
-    }
-};
-
-struct BoxStack : Demo {
-    virtual void Init() {
-        // Create the floor
-        q3Body* body = scene.CreateBody({});
-
-        q3BoxDef boxDef;
-        boxDef.m_restitution = 0;
-        q3Transform tx;
-        q3Identity(tx);
-        boxDef.Set(tx, q3Vec3(50.0f, 1.0f, 50.0f));
-        body->SetBox(boxDef);
-
-        boxDef.Set(tx, q3Vec3(1.0f, 1.0f, 1.0f));
-
-        for (int32_t i = 0; i < 8; ++i) {
-            for (int32_t j = 0; j < 8; ++j) {
-                for (int32_t k = 0; k < 10; ++k) {
-                    body = scene.CreateBody({
-                        .position = q3Vec3(-16.0f + 1.0f * j, 1.0f * i + 5.0f, -16.0f + 1.0f * k),
-                        .bodyType = eDynamicBody,
-                    });
-                    body->SetBox(boxDef);
-                }
-            }
+    for (usize i = 0; i < perf_counter_count;) {
+        // Counters of one section are contiguous in perf_counters
+        const char* section = perf_counters[i].section;
+        bool open = ImGui::CollapsingHeader(section, ImGuiTreeNodeFlags_DefaultOpen);
+        for (; i < perf_counter_count && perf_counters[i].section == section; ++i) {
+            if (open) counter_history[i].Plot(perf_counters[i].name, "%.0f");
         }
     }
-
-    virtual void Shutdown() { scene.RemoveAllBodies(); }
-};
+    ImGui::End();
+}
+#else
+static void DrawPerfPanel() {
+    ImGui::Begin("Performance");
+    ImGui::TextUnformatted("Build with Q3_STEP_STATS=1 to record step stats");
+    ImGui::End();
+}
+#endif
 
 int main() {
     // setup GLFW window
@@ -483,13 +395,15 @@ int main() {
     renderer.Build();
 
     const char* const demo_choices[] = {"Drop Boxes", "Ray Push", "Box Stack"};
-    Demo* demos[3] = {new DropBoxes(), new RayPush(), new BoxStack()};
+    Demo* demos[3] = {new DropBoxes(&scene), new RayPush(&scene), new BoxStack(&scene)};
     constexpr int demo_count = 3;
     int32_t current_demo = 1;
     bool paused = false;
     bool do_single_step = false;
     bool enable_friction = true;
     int32_t iterations = 10;
+    int32_t substeps = 1;
+    int32_t position_iterations = 0;
 
     demos[current_demo]->Init();
 
@@ -517,18 +431,24 @@ int main() {
             if (paused && ImGui::Button("Single Step")) do_single_step = true;
             ImGui::Checkbox("Friction", &enable_friction);
             ImGui::SliderInt("Iterations", &iterations, 1, 50);
+            ImGui::SliderInt("Substeps", &substeps, 1, 16);
+            ImGui::SliderInt("Position iterations", &position_iterations, 0, 10);
         }
         ImGui::End();
 
         auto active_demo = demos[current_demo];
         scene.enable_friction = enable_friction;
         scene.iterations = iterations;
+        scene.substeps = substeps;
+        scene.position_iterations = position_iterations;
 
         if (!paused || do_single_step) {
             scene.Step();
+            Q3_STATS(RecordPerf(scene.stats));
             active_demo->Update();
             if (do_single_step) do_single_step = false;
         }
+        DrawPerfPanel();
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -0,0 +1,519 @@
+// Micro-benchmarks of the narrowphase and solver kernels. Each kernel runs over
+// a fixed set of synthetic inputs, calibrated so one repetition takes at least
+// --min-ms, and the fastest of --reps repetitions is reported as ns/op and
+// millions of ops per second. Use it to measure kernel-level changes in
+// isolation, qu3e_bench covers whole scenes.
+//
+// usage: qu3e_microbench [--reps N] [--min-ms N] [--seed N] [kernel ...]
+//   kernels: boxtobox_face boxtobox_edge boxtobox_separated clip presolve
+//            solve compute_aabb raycast raycast_packet query_aabb_callback
+//            query_aabb_functor query_aabb_buffer. Defaults to all of them.
+
+#include <chrono>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/q3.h"
+#include "../src/collision/q3Collide.h"
+#include "../src/dynamics/q3Contact.h"
+#include "../src/dynamics/q3ContactSolver.h"
+#include "../src/dynamics/q3Island.h"
+#include "scenes.h"
+
+constexpr usize pose_count = 1024;
+
+// Written by every kernel so the compiler can not drop the work
+static volatile r32 sink;
+
+static u32 reps = 5;
+static f64 min_ms = 20.0;
+
+static q3Vec3 RandomAxis() {
+    q3Vec3 axis(q3RandomFloat(-1, 1), q3RandomFloat(-1, 1), q3RandomFloat(-1, 1));
+    if (q3LengthSq(axis) < r32(1.0e-4)) axis.Set(0, 1, 0);
+    return q3Normalize(axis);
+}
+
+static q3Transform RandomTransform(r32 spread) {
+    q3Transform tx;
+    tx.rotation = q3Quaternion(RandomAxis(), q3PI * q3RandomFloat(-1, 1)).ToMat3();
+    tx.position.Set(
+        q3RandomFloat(-spread, spread), q3RandomFloat(-spread, spread),
+        q3RandomFloat(-spread, spread)
+    );
+    return tx;
+}
+
+// Calls kernel() until one repetition takes min_ms, then reports the fastest
+// of `reps` repetitions. Every call to kernel() performs ops_per_call ops.
+template <typename F>
+static void Measure(const char* name, const char* op, usize ops_per_call, F&& kernel) {
+    using Clock = std::chrono::steady_clock;
+
+    u64 calls = 1;
+    for (;;) {
+        auto start = Clock::now();
+        for (u64 i = 0; i < calls; ++i) kernel();
+        f64 ms = std::chrono::duration<f64, std::milli>(Clock::now() - start).count();
+        if (ms >= min_ms || calls >= (u64(1) << 40)) break;
+        calls *= 2;
+    }
+
+    f64 best_ns = 1.0e300;
+    for (u32 rep = 0; rep < reps; ++rep) {
+        auto start = Clock::now();
+        for (u64 i = 0; i < calls; ++i) kernel();
+        f64 ns = std::chrono::duration<f64, std::nano>(Clock::now() - start).count();
+        if (ns < best_ns) best_ns = ns;
+    }
+
+    f64 ns_per_op = best_ns / (f64(calls) * f64(ops_per_call));
+    printf(
+        "%-20s %-11s %10zu %10.1f %10.2f\n", name, op, ops_per_call, ns_per_op, 1.0e3 / ns_per_op
+    );
+    fflush(stdout);
+}
+
+// Pairs of unit boxes posed so q3BoxtoBox takes one particular path
+struct PosePairs {
+    q3Scene* scene;
+    ArrayList<q3Manifold> manifolds;
+
+    static PosePairs init(q3Scene* scene) {
+        return PosePairs{scene, ArrayList<q3Manifold>::init(scene->allocator)};
+    }
+
+    void deinit() { manifolds.deinit(); }
+
+    q3Box* CreateBox(const q3Vec3& position, const q3Vec3& axis, r32 angle) {
+        q3Body* body = scene->CreateBody({.axis = axis, .angle = angle, .position = position});
+        q3BoxDef boxDef;
+        q3Transform tx;
+        q3Identity(tx);
+        boxDef.Set(tx, q3Vec3(1.0f, 1.0f, 1.0f));
+        body->SetBox(boxDef);
+        return &body->box;
+    }
+
+    // Keeps the pair only if q3BoxtoBox agrees it is touching (or separated)
+    bool Add(q3Box* a, q3Box* b, bool touching) {
+        q3Manifold m = {};
+        m.A = a;
+        m.B = b;
+        q3BoxtoBox(&m, a, b);
+        if ((m.contactCount > 0) != touching) return false;
+        manifolds.append(m).unwrap();
+        return true;
+    }
+
+    void Run() {
+        for (q3Manifold& m : manifolds.items) {
+            q3BoxtoBox(&m, m.A, m.B);
+            sink = sink + m.normal.y;
+        }
+    }
+};
+
+// B resting on the top face of A, yawed, so the face axes win
+static void AddFacePoses(PosePairs* pairs) {
+    while (pairs->manifolds.items.len < pose_count) {
+        q3Box* a = pairs->CreateBox(q3Vec3(0, 0, 0), q3Vec3(0, 1, 0), 0);
+        q3Vec3 position(
+            q3RandomFloat(-0.4f, 0.4f), q3RandomFloat(0.96f, 0.99f), q3RandomFloat(-0.4f, 0.4f)
+        );
+        q3Box* b = pairs->CreateBox(position, q3Vec3(0, 1, 0), q3PI * q3RandomFloat(-1, 1));
+        pairs->Add(a, b, true);
+    }
+}
+
+// A rolled 45 degrees about x and B about z, so their top and bottom edges
+// cross with a shallow penetration and the edge axis wins
+static void AddEdgePoses(PosePairs* pairs) {
+    r32 ridge = r32(0.5) * std::sqrt(r32(2.0));
+    while (pairs->manifolds.items.len < pose_count) {
+        q3Box* a = pairs->CreateBox(
+            q3Vec3(0, 0, 0), q3Vec3(1, 0, 0), q3PI * 0.25f + q3RandomFloat(-0.05f, 0.05f)
+        );
+        q3Vec3 position(
+            q3RandomFloat(-0.2f, 0.2f), 2.0f * ridge - q3RandomFloat(0.01f, 0.04f),
+            q3RandomFloat(-0.2f, 0.2f)
+        );
+        q3Box* b = pairs->CreateBox(
+            position, q3Vec3(0, 0, 1), q3PI * 0.25f + q3RandomFloat(-0.05f, 0.05f)
+        );
+        pairs->Add(a, b, true);
+    }
+}
+
+// Randomly oriented pairs within each other's bounding spheres that still do
+// not touch, so the SAT runs until it finds the separating axis
+static void AddSeparatedPoses(PosePairs* pairs) {
+    while (pairs->manifolds.items.len < pose_count) {
+        q3Box* a = pairs->CreateBox(q3Vec3(0, 0, 0), RandomAxis(), q3PI * q3RandomFloat(-1, 1));
+        q3Box* b = pairs->CreateBox(
+            RandomAxis() * q3RandomFloat(1.0f, 1.7f), RandomAxis(), q3PI * q3RandomFloat(-1, 1)
+        );
+        pairs->Add(a, b, false);
+    }
+}
+
+static void RunBoxtoBox(const char* name, void (*add_poses)(PosePairs*)) {
+    q3Scene scene(1.0 / 60.0);
+    auto pairs = PosePairs::init(&scene);
+    defer(pairs.deinit());
+    add_poses(&pairs);
+
+    Measure(name, "pair", pairs.manifolds.items.len, [&] { pairs.Run(); });
+    scene.RemoveAllBodies();
+}
+
+static void RunBoxtoBoxFace() { RunBoxtoBox("boxtobox_face", AddFacePoses); }
+static void RunBoxtoBoxEdge() { RunBoxtoBox("boxtobox_edge", AddEdgePoses); }
+static void RunBoxtoBoxSeparated() { RunBoxtoBox("boxtobox_separated", AddSeparatedPoses); }
+
+// Clipping inputs of the face poses, set up the way q3BoxtoBox does it with
+// the top face of A as the reference face
+struct ClipInput {
+    q3Vec3 rPos;
+    q3Vec3 e;
+    u8 clipEdges[4];
+    q3Mat3 basis;
+    q3ClipVertex incident[4];
+};
+
+static void RunClip() {
+    q3Scene scene(1.0 / 60.0);
+    auto pairs = PosePairs::init(&scene);
+    defer(pairs.deinit());
+    AddFacePoses(&pairs);
+
+    auto inputs = ArrayList<ClipInput>::init(scene.allocator);
+    defer(inputs.deinit());
+    for (const q3Manifold& m : pairs.manifolds.items) {
+        q3Transform rtx = q3Mul(m.A->body->m_tx, m.A->local);
+        q3Transform itx = q3Mul(m.B->body->m_tx, m.B->local);
+        q3Vec3 n = rtx.rotation.e.y;
+
+        ClipInput input;
+        input.rPos = rtx.position;
+        q3ComputeIncidentFace(itx, m.B->e, n, input.incident);
+        q3ComputeReferenceEdgesAndBasis(m.A->e, rtx, n, 1, input.clipEdges, &input.basis, &input.e);
+        inputs.append(input).unwrap();
+    }
+
+    Measure("clip", "face", inputs.items.len, [&] {
+        for (ClipInput& input : inputs.items) {
+            q3ClipVertex out[8];
+            r32 depths[8];
+            i32 count = q3Clip(
+                input.rPos, input.e, input.clipEdges, input.basis, input.incident, out, depths
+            );
+            sink = sink + (count ? depths[0] : r32(0.0));
+        }
+    });
+    scene.RemoveAllBodies();
+}
+
+// Island of a settled box stack, every touching contact of the scene in it
+struct SolverFixture {
+    q3Scene scene;
+    BoxStack stack;
+    q3Island island;
+    ArrayList<q3VelocityState> initial_velocities;
+
+    SolverFixture() : scene(1.0 / 60.0), stack(&scene) {
+        stack.Init();
+        for (u32 i = 0; i < 120; ++i) scene.Step();
+
+        island = q3Island::init(
+            scene.allocator, scene.dt, scene.gravity, scene.iterations, scene.enable_friction
+        );
+        Q3_STATS(island.stats = &scene.stats);
+        for (q3Body* body : scene.bodies.ptrIter()) island.Add(body);
+        for (q3ContactConstraint* contact : scene.contact_manager.contacts.ptrIter()) {
+            if (contact->manifold.contactCount) island.Add(contact);
+        }
+        for (auto [body, i] : island.bodies.items.iter()) {
+            island.velocities.items[i] = {body->m_angularVelocity, body->m_linearVelocity};
+        }
+        island.Initialize();
+
+        initial_velocities = ArrayList<q3VelocityState>::init(scene.allocator);
+        initial_velocities.appendSlice(island.velocities.items).unwrap();
+    }
+
+    ~SolverFixture() {
+        initial_velocities.deinit();
+        island.deinit();
+        stack.Shutdown();
+    }
+
+    void ResetVelocities() {
+        memcpy(
+            island.velocities.items.ptr, initial_velocities.items.ptr,
+            sizeof(q3VelocityState) * initial_velocities.items.len
+        );
+    }
+};
+
+static void RunPreSolve() {
+    SolverFixture fixture;
+    q3ContactSolver solver;
+    solver.Initialize(&fixture.island);
+
+    // Warm starting accumulates into the velocities, so each call starts over
+    Measure("presolve", "constraint", fixture.island.contacts.items.len, [&] {
+        fixture.ResetVelocities();
+        solver.PreSolve(fixture.scene.dt);
+        sink = sink + fixture.island.velocities.items[1].v.y;
+    });
+}
+
+static void RunSolve() {
+    SolverFixture fixture;
+    q3ContactSolver solver;
+    solver.Initialize(&fixture.island);
+    solver.PreSolve(fixture.scene.dt);
+
+    Measure("solve", "constraint", fixture.island.contacts.items.len, [&] {
+        solver.Solve();
+        sink = sink + fixture.island.velocities.items[1].v.y;
+    });
+}
+
+static void RunComputeAABB() {
+    Allocator allocator;
+    auto transforms = ArrayList<q3Transform>::init(allocator);
+    defer(transforms.deinit());
+    for (usize i = 0; i < pose_count; ++i) transforms.append(RandomTransform(10.0f)).unwrap();
+
+    q3Box box = {};
+    q3Identity(box.local);
+    box.e.Set(0.5f, 1.0f, 1.5f);
+
+    Measure("compute_aabb", "box", transforms.items.len, [&] {
+        for (const q3Transform& tx : transforms.items) {
+            q3AABB aabb;
+            box.ComputeAABB(tx, &aabb);
+            sink = sink + aabb.max.x;
+        }
+    });
+}
+
+// Rays from a sphere around the box aimed near its center, roughly a quarter
+// of them miss
+static void RunRaycast() {
+    Allocator allocator;
+    auto transforms = ArrayList<q3Transform>::init(allocator);
+    defer(transforms.deinit());
+    auto rays = ArrayList<q3RaycastData>::init(allocator);
+    defer(rays.deinit());
+
+    for (usize i = 0; i < pose_count; ++i) {
+        q3Transform tx = RandomTransform(10.0f);
+        q3Vec3 start = tx.position + RandomAxis() * 5.0f;
+        q3Vec3 target = tx.position + RandomAxis() * q3RandomFloat(0.0f, 1.5f);
+
+        q3RaycastData ray;
+        ray.Set(start, q3Normalize(target - start), 10.0f);
+        transforms.append(tx).unwrap();
+        rays.append(ray).unwrap();
+    }
+
+    q3Box box = {};
+    q3Identity(box.local);
+    box.e.Set(0.5f, 0.5f, 0.5f);
+
+    Measure("raycast", "ray", rays.items.len, [&] {
+        for (usize i = 0; i < rays.items.len; ++i) {
+            q3RaycastData* ray = &rays.items[i];
+            if (box.Raycast(transforms.items[i], ray)) sink = sink + ray->toi;
+        }
+    });
+}
+
+// Packets of four rays aimed near the same box, the layout q3Scene::RayCastBatch
+// tests a box with
+static void RunRaycastPacket() {
+    Allocator allocator;
+    auto transforms = ArrayList<q3Transform>::init(allocator);
+    defer(transforms.deinit());
+    auto packets = ArrayList<q3RayPacket>::init(allocator);
+    defer(packets.deinit());
+
+    for (usize i = 0; i < pose_count / 4; ++i) {
+        q3Transform tx = RandomTransform(10.0f);
+        q3RaycastData rays[4];
+        for (q3RaycastData& ray : rays) {
+            q3Vec3 start = tx.position + RandomAxis() * 5.0f;
+            q3Vec3 target = tx.position + RandomAxis() * q3RandomFloat(0.0f, 1.5f);
+            ray.Set(start, q3Normalize(target - start), 10.0f);
+        }
+
+        q3RayPacket packet;
+        packet.Set(rays, 4);
+        transforms.append(tx).unwrap();
+        packets.append(packet).unwrap();
+    }
+
+    q3Box box = {};
+    q3Identity(box.local);
+    box.e.Set(0.5f, 0.5f, 0.5f);
+
+    Measure("raycast_packet", "ray", packets.items.len * 4, [&] {
+        for (usize i = 0; i < packets.items.len; ++i) {
+            q3Float4 toi;
+            q3Float4 normal[3];
+            u32 lanes = box.RaycastPacket(transforms.items[i], packets.items[i], 0xf, &toi, normal);
+            if (lanes) sink = sink + q3SimdGetX(toi);
+        }
+    });
+}
+
+// Scattered boxes queried with explosion sized AABBs, about 60 hits each
+struct QueryFixture {
+    q3Scene scene;
+    ArrayList<q3AABB> queries;
+
+    QueryFixture() : scene(1.0 / 60.0) {
+        for (usize i = 0; i < 4 * pose_count; ++i) {
+            q3Transform tx = RandomTransform(20.0f);
+            q3Body* body = scene.CreateBody({
+                .axis = RandomAxis(),
+                .angle = q3PI * q3RandomFloat(-1, 1),
+                .position = tx.position,
+            });
+            q3BoxDef boxDef;
+            q3Identity(tx);
+            boxDef.Set(tx, q3Vec3(1.0f, 1.0f, 1.0f));
+            body->SetBox(boxDef);
+        }
+
+        queries = ArrayList<q3AABB>::init(scene.allocator);
+        for (usize i = 0; i < pose_count / 4; ++i) {
+            q3Vec3 center = RandomTransform(20.0f).position;
+            q3Vec3 radius(4.0f, 4.0f, 4.0f);
+            queries.append({.min = center - radius, .max = center + radius}).unwrap();
+        }
+    }
+
+    ~QueryFixture() {
+        queries.deinit();
+        scene.RemoveAllBodies();
+    }
+};
+
+struct CountingCallback : q3QueryCallback {
+    usize count = 0;
+
+    bool ReportShape(q3Box* box) override {
+        count += 1;
+        return true;
+    }
+};
+
+static void RunQueryAABBCallback() {
+    QueryFixture fixture;
+    Measure("query_aabb_callback", "query", fixture.queries.items.len, [&] {
+        CountingCallback cb;
+        for (const q3AABB& aabb : fixture.queries.items) fixture.scene.QueryAABB(&cb, aabb);
+        sink = sink + r32(cb.count);
+    });
+}
+
+static void RunQueryAABBFunctor() {
+    QueryFixture fixture;
+    Measure("query_aabb_functor", "query", fixture.queries.items.len, [&] {
+        usize count = 0;
+        for (const q3AABB& aabb : fixture.queries.items) {
+            fixture.scene.QueryAABB(aabb, [&count](q3Box* box) {
+                count += 1;
+                return true;
+            });
+        }
+        sink = sink + r32(count);
+    });
+}
+
+static void RunQueryAABBBuffer() {
+    QueryFixture fixture;
+    q3Box* results[256];
+    Measure("query_aabb_buffer", "query", fixture.queries.items.len, [&] {
+        usize count = 0;
+        for (const q3AABB& aabb : fixture.queries.items) {
+            count += fixture.scene.QueryAABB(aabb, Slice<q3Box*>(results, 256));
+        }
+        sink = sink + r32(count);
+    });
+}
+
+struct MicroBench {
+    const char* name;
+    void (*run)();
+};
+
+static const MicroBench micro_benches[] = {
+    {"boxtobox_face", RunBoxtoBoxFace},
+    {"boxtobox_edge", RunBoxtoBoxEdge},
+    {"boxtobox_separated", RunBoxtoBoxSeparated},
+    {"clip", RunClip},
+    {"presolve", RunPreSolve},
+    {"solve", RunSolve},
+    {"compute_aabb", RunComputeAABB},
+    {"raycast", RunRaycast},
+    {"raycast_packet", RunRaycastPacket},
+    {"query_aabb_callback", RunQueryAABBCallback},
+    {"query_aabb_functor", RunQueryAABBFunctor},
+    {"query_aabb_buffer", RunQueryAABBBuffer},
+};
+constexpr usize micro_bench_count = sizeof(micro_benches) / sizeof(micro_benches[0]);
+
+static void PrintUsage() {
+    fprintf(stderr, "usage: qu3e_microbench [--reps N] [--min-ms N] [--seed N] [kernel ...]\n");
+    fprintf(stderr, "kernels:");
+    for (const MicroBench& bench : micro_benches) fprintf(stderr, " %s", bench.name);
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char** argv) {
+    u32 seed = 1;
+    bool selected[micro_bench_count] = {};
+    bool any_selected = false;
+
+    for (i32 i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (!strcmp(arg, "--reps") && i + 1 < argc) {
+            reps = u32(atoi(argv[++i]));
+        } else if (!strcmp(arg, "--min-ms") && i + 1 < argc) {
+            min_ms = atof(argv[++i]);
+        } else if (!strcmp(arg, "--seed") && i + 1 < argc) {
+            seed = u32(atoi(argv[++i]));
+        } else {
+            bool found = false;
+            for (usize b = 0; b < micro_bench_count; ++b) {
+                if (!strcmp(arg, micro_benches[b].name)) selected[b] = found = true;
+            }
+            if (!found) {
+                PrintUsage();
+                return 1;
+            }
+            any_selected = true;
+        }
+    }
+
+    if (reps == 0) {
+        PrintUsage();
+        return 1;
+    }
+
+    printf("%-20s %-11s %10s %10s %10s\n", "kernel", "op", "inputs", "ns/op", "Mops/s");
+    for (usize b = 0; b < micro_bench_count; ++b) {
+        if (any_selected && !selected[b]) continue;
+        srand(seed);
+        micro_benches[b].run();
+    }
+
+    return 0;
+}
@@ -0,0 +1,193 @@
+// Offline runner for q3Recorder logs. Replays a recorded session headlessly,
+// as fast as possible, and compares the step times of this build with the ones
+// measured while recording, to reproduce spikes of a real workload and to
+// compare engine changes on it.
+//
+// usage: qu3e_replay [--threads N] [--static-world FILE] [--top N] LOG
+//   --threads steps on a q3JobSystem with N worker threads besides the main one
+//   --static-world maps the static world the session used (q3StaticWorld file)
+//   --top prints the N slowest recorded steps next to their replayed time
+//
+// Logs can be written with `qu3e_bench --record LOG scene` or by a game
+// through q3Recorder. Recordings of deterministic scenes carry a state hash per
+// step, which is checked too (it only matches on a build that simulates the
+// same, bit for bit).
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/q3.h"
+
+struct ReplayedStep {
+    q3StepRecord recorded;
+    f64 ms;
+    u64 state_hash;
+};
+
+// Nearest rank percentile of an ascending sorted slice
+static f64 Percentile(Slice<f64> sorted, f64 p) {
+    usize rank = usize(p / 100.0 * f64(sorted.len) + 0.5);
+    if (rank > 0) rank -= 1;
+    if (rank >= sorted.len) rank = sorted.len - 1;
+    return sorted[rank];
+}
+
+static void PrintTimes(const char* name, Slice<f64> sorted) {
+    f64 total = 0.0;
+    for (f64 ms : sorted) total += ms;
+    printf(
+        "%-10s %9.3f %9.3f %9.3f %9.3f %9.3f\n", name, total / f64(sorted.len),
+        Percentile(sorted, 50.0), Percentile(sorted, 90.0), Percentile(sorted, 99.0),
+        sorted[sorted.len - 1]
+    );
+}
+
+static void PrintUsage() {
+    fprintf(stderr, "usage: qu3e_replay [--threads N] [--static-world FILE] [--top N] LOG\n");
+}
+
+int main(int argc, char** argv) {
+    using Clock = std::chrono::steady_clock;
+
+    i32 threads = -1;
+    u32 top = 10;
+    const char* static_world_path = nullptr;
+    const char* log_path = nullptr;
+
+    for (i32 i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (!strcmp(arg, "--threads") && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (!strcmp(arg, "--static-world") && i + 1 < argc) {
+            static_world_path = argv[++i];
+        } else if (!strcmp(arg, "--top") && i + 1 < argc) {
+            top = u32(atoi(argv[++i]));
+        } else if (!log_path && arg[0] != '-') {
+            log_path = arg;
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (!log_path) {
+        PrintUsage();
+        return 1;
+    }
+
+    q3StaticWorld static_world;
+    if (static_world_path && static_world.Map(static_world_path).is_err()) {
+        fprintf(stderr, "could not map %s\n", static_world_path);
+        return 1;
+    }
+    defer(if (static_world_path) static_world.Unmap());
+
+    FILE* file = fopen(log_path, "rb");
+    if (!file) {
+        fprintf(stderr, "could not open %s\n", log_path);
+        return 1;
+    }
+    defer(fclose(file));
+
+    q3JobSystem* jobs = threads >= 0 ? new q3JobSystem(threads) : nullptr;
+    defer(delete jobs);
+
+    q3Scene scene(1.0 / 60.0);
+    scene.jobs = jobs;
+    q3Replay replay(scene.allocator);
+    if (replay.Open(file, static_world_path ? &static_world : nullptr).is_err()) {
+        fprintf(stderr, "%s is not a q3Recorder log\n", log_path);
+        return 1;
+    }
+
+    auto steps = ArrayList<ReplayedStep>::init(scene.allocator);
+    defer(steps.deinit());
+
+    for (;;) {
+        ReplayedStep step = {};
+        ErrOr<bool> next = replay.Next(&scene, &step.recorded);
+        if (next.is_err()) {
+            fprintf(
+                stderr, "bad record after step %zu (%s)\n", steps.items.len,
+                next.err == Error::ParseError ? "does the static world match?" : "truncated log"
+            );
+            break;
+        }
+        if (!next.unwrap()) break;
+
+        auto start = Clock::now();
+        scene.Step();
+        step.ms = std::chrono::duration<f64, std::milli>(Clock::now() - start).count();
+        step.state_hash = scene.deterministic ? scene.state_hash : 0;
+        steps.append(step).unwrap();
+    }
+
+    if (steps.items.len == 0) {
+        fprintf(stderr, "no steps in %s\n", log_path);
+        return 1;
+    }
+
+    printf(
+        "%zu steps, %zu bodies and %zu contacts at the end\n", steps.items.len, scene.bodies.len,
+        scene.contact_manager.contacts.len
+    );
+
+    auto recorded = ArrayList<f64>::init(scene.allocator);
+    defer(recorded.deinit());
+    auto replayed = ArrayList<f64>::init(scene.allocator);
+    defer(replayed.deinit());
+    usize hashed = 0;
+    usize mismatches = 0;
+    u64 first_mismatch = 0;
+    for (const ReplayedStep& step : steps.items) {
+        recorded.append(step.recorded.ms).unwrap();
+        replayed.append(step.ms).unwrap();
+        if (step.recorded.state_hash == 0) continue;
+        hashed += 1;
+        if (step.state_hash != step.recorded.state_hash && mismatches++ == 0) {
+            first_mismatch = step.recorded.step;
+        }
+    }
+    std::sort(recorded.items.ptr, recorded.items.ptr + recorded.items.len);
+    std::sort(replayed.items.ptr, replayed.items.ptr + replayed.items.len);
+
+    printf(
+        "%-10s %9s %9s %9s %9s %9s\n", "", "mean_ms", "p50_ms", "p90_ms", "p99_ms", "max_ms"
+    );
+    PrintTimes("recorded", recorded.items);
+    PrintTimes("replayed", replayed.items);
+
+    if (top > 0) {
+        auto slower = [](const ReplayedStep& a, const ReplayedStep& b) {
+            return a.recorded.ms > b.recorded.ms;
+        };
+        std::sort(steps.items.ptr, steps.items.ptr + steps.items.len, slower);
+        printf(
+            "\nslowest recorded steps\n%8s %8s %9s %12s %12s\n", "step", "bodies", "contacts",
+            "recorded_ms", "replayed_ms"
+        );
+        for (usize i = 0; i < steps.items.len && i < top; ++i) {
+            const ReplayedStep& step = steps.items[i];
+            printf(
+                "%8llu %8u %9u %12.3f %12.3f\n", (unsigned long long)step.recorded.step,
+                step.recorded.body_count, step.recorded.contact_count, step.recorded.ms, step.ms
+            );
+        }
+    }
+
+    if (hashed > 0) {
+        if (mismatches == 0) {
+            printf("\nstate hash matches the recording on all %zu steps\n", hashed);
+        } else {
+            printf(
+                "\nstate hash differs on %zu of %zu steps, first at step %llu\n", mismatches,
+                hashed, (unsigned long long)first_mismatch
+            );
+        }
+    }
+
+    return 0;
+}
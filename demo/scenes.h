@@ -0,0 +1,189 @@
+#pragma once
+
+// Demo scenarios shared by the interactive demo and the headless benchmark.
+// Nothing in here touches OpenGL, scenes only talk to q3Scene and q3Render.
+
+#include <float.h>
+
+#include "../src/q3.h"
+
+struct Demo {
+    q3Scene* scene;
+
+    Demo(q3Scene* scene) : scene(scene) {}
+    virtual ~Demo() {}
+
+    virtual void Init(){};
+    virtual void Update(){};
+    virtual void Shutdown(){};
+
+    virtual void Render(q3Render* debugDrawer) { (void)debugDrawer; }
+};
+
+struct DropBoxes : public Demo {
+    float acc;
+
+    DropBoxes(q3Scene* scene) : Demo(scene) {}
+
+    virtual void Init() {
+        acc = 0;
+
+        // Create the floor
+        q3Body* body = scene->CreateBody({});
+
+        q3BoxDef boxDef;
+        boxDef.m_restitution = 0;
+        q3Transform tx;
+        q3Identity(tx);
+        boxDef.Set(tx, q3Vec3(50.0f, 1.0f, 50.0f));
+        body->SetBox(boxDef);
+    }
+
+    virtual void Update() {
+        acc += scene->dt;
+
+        if (acc > 1.0f) {
+            acc = 0;
+
+            q3Body* body = scene->CreateBody({
+                .axis = q3Vec3(q3RandomFloat(-1, 1), q3RandomFloat(-1, 1), q3RandomFloat(-1, 1)),
+                .angle = q3PI * q3RandomFloat(-1, 1),
+                .position = q3Vec3(0, 3, 0),
+                .linearVelocity =
+                    q3Vec3(q3RandomFloat(1, 3), q3RandomFloat(1, 3), q3RandomFloat(1, 3)) *
+                    q3Sign(q3RandomFloat(-1, 1)),
+                .angularVelocity =
+                    q3Vec3(q3RandomFloat(1, 3), q3RandomFloat(1, 3), q3RandomFloat(1, 3)) *
+                    q3Sign(q3RandomFloat(-1, 1)),
+                .bodyType = eDynamicBody,
+            });
+
+            q3Transform tx;
+            q3Identity(tx);
+            q3BoxDef boxDef;
+            boxDef.Set(tx, q3Vec3(1.0f, 1.0f, 1.0f));
+            body->SetBox(boxDef);
+        }
+    }
+
+    virtual void Shutdown() { scene->RemoveAllBodies(); }
+};
+
+struct RayPush : Demo {
+    float acc;
+    q3RaycastData rayCast;
+
+    RayPush(q3Scene* scene) : Demo(scene) {}
+
+    void Init() {
+        acc = 0;
+
+        // Create the floor
+        q3Body* body = scene->CreateBody({});
+
+        q3BoxDef boxDef;
+        boxDef.m_restitution = 0;
+        q3Transform tx;
+        q3Identity(tx);
+        boxDef.Set(tx, q3Vec3(50.0f, 1.0f, 50.0f));
+        body->SetBox(boxDef);
+    }
+
+    void Update() {
+        acc += scene->dt;
+
+        if (acc > 1.0f) {
+            acc = 0;
+
+            q3Body* body = scene->CreateBody({
+                .axis = q3Vec3(q3RandomFloat(-1, 1), q3RandomFloat(-1, 1), q3RandomFloat(-1, 1)),
+                .angle = q3PI * q3RandomFloat(-1, 1),
+                .position = q3Vec3(0, 3, 0),
+                .linearVelocity =
+                    q3Vec3(q3RandomFloat(1, 3), q3RandomFloat(1, 3), q3RandomFloat(1, 3)) *
+                    q3Sign(q3RandomFloat(-1, 1)),
+                .angularVelocity =
+                    q3Vec3(q3RandomFloat(1, 3), q3RandomFloat(1, 3), q3RandomFloat(1, 3)) *
+                    q3Sign(q3RandomFloat(-1, 1)),
+                .bodyType = eDynamicBody,
+            });
+
+            q3Transform tx;
+            q3Identity(tx);
+            q3BoxDef boxDef;
+            boxDef.Set(tx, q3Vec3(1.0f, 1.0f, 1.0f));
+            body->SetBox(boxDef);
+        }
+
+        rayCast.Set(
+            q3Vec3(3.0f, 5.0f, 3.0f), q3Normalize(q3Vec3(-1.0f, -1.0f, -1.0f)), r32(10000.0)
+        );
+        q3Box* impact = scene->RayCastClosest(rayCast);
+
+        if (impact) {
+            impact->body->ApplyForceAtWorldPoint(rayCast.dir * 20.0f, rayCast.GetImpactPoint());
+        }
+    }
+
+    void Shutdown() { scene->RemoveAllBodies(); }
+
+    void Render(q3Render* render) {
+        render->SetScale(1.0f, 1.0f, 1.0f);
+        render->SetPenColor(0.2f, 0.5f, 1.0f);
+        render->SetPenPosition(rayCast.start.x, rayCast.start.y, rayCast.start.z);
+        q3Vec3 impact = rayCast.GetImpactPoint();
+        render->Line(impact.x, impact.y, impact.z);
+
+        render->SetPenPosition(impact.x, impact.y, impact.z);
+        render->SetPenColor(1.0f, 0.5f, 0.5f);
+        render->SetScale(10.0f, 10.0f, 10.0f);
+        render->Point();
+
+        render->SetPenColor(1.0f, 0.5f, 0.2f);
+        render->SetScale(1.0f, 1.0f, 1.0f);
+        impact += rayCast.normal * 2.0f;
+        render->Line(impact.x, impact.y, impact.z);
+    }
+};
+
+// A width x height x depth block of unit cubes resting on a floor. The
+// default size is the original demo stack, larger ones are used by the
+// benchmark to stress the engine.
+struct BoxStack : Demo {
+    int32_t width;
+    int32_t height;
+    int32_t depth;
+
+    BoxStack(q3Scene* scene, int32_t width = 8, int32_t height = 8, int32_t depth = 10)
+        : Demo(scene), width(width), height(height), depth(depth) {}
+
+    virtual void Init() {
+        // Create the floor, grown if the stack would not fit on it
+        q3Body* body = scene->CreateBody({});
+
+        r32 floorSize = q3Max(50.0f, 2.0f * r32(q3Max(width, depth) - 16 + 4));
+
+        q3BoxDef boxDef;
+        boxDef.m_restitution = 0;
+        q3Transform tx;
+        q3Identity(tx);
+        boxDef.Set(tx, q3Vec3(floorSize, 1.0f, floorSize));
+        body->SetBox(boxDef);
+
+        boxDef.Set(tx, q3Vec3(1.0f, 1.0f, 1.0f));
+
+        for (int32_t i = 0; i < height; ++i) {
+            for (int32_t j = 0; j < width; ++j) {
+                for (int32_t k = 0; k < depth; ++k) {
+                    body = scene->CreateBody({
+                        .position = q3Vec3(-16.0f + 1.0f * j, 1.0f * i + 5.0f, -16.0f + 1.0f * k),
+                        .bodyType = eDynamicBody,
+                    });
+                    body->SetBox(boxDef);
+                }
+            }
+        }
+    }
+
+    virtual void Shutdown() { scene->RemoveAllBodies(); }
+};
@@ -23,9 +23,14 @@ not be misrepresented as being the original software.
 distribution.
 */
 
+#include <algorithm>
+
 #include "q3BroadPhase.h"
 #include "../collision/q3Box.h"
+#include "../common/q3Jobs.h"
 #include "../common/q3Geometry.h"
+#include "../debug/q3Trace.h"
+#include "../dynamics/q3Body.h"
 #include "../dynamics/q3ContactManager.h"
 #include "../math/q3Math.h"
 
@@ -39,12 +44,16 @@ inline q3AABB FatAABB(q3AABB aabb) {
 
 q3BroadPhase::q3BroadPhase(Allocator allocator) {
     pairs = ArrayList<q3ContactPair>::initCapacity(allocator, 64).unwrap();
+    chunk_pairs = ArrayList<ArrayList<q3ContactPair>>::init(allocator);
     boxes = ArrayList<BoxInfo>::init(allocator);
     unused_boxes = ArrayList<usize>::init(allocator);
+    Q3_STATS(proxies_inserted = proxies_removed = proxies_moved = 0);
 }
 
 q3BroadPhase::~q3BroadPhase() {
     pairs.deinit();
+    for (ArrayList<q3ContactPair>& chunk : chunk_pairs.items) chunk.deinit();
+    chunk_pairs.deinit();
     boxes.deinit();
     unused_boxes.deinit();
 }
@@ -59,8 +68,9 @@ void q3BroadPhase::InsertBox(q3Box* box, const q3AABB& aabb) {
     }
 
     debug::print("[broadphase] inserting box id=%d\n", id);
-    boxes.items[id] = {.box = box, .aabb = aabb};
+    boxes.items[id] = {.box = box, .aabb = aabb, .tight_aabb = aabb};
     box->broadPhaseIndex = id;
+    Q3_STATS(proxies_inserted += 1);
 }
 
 BoxInfo q3BroadPhase::GetBoxInfo(i32 id) {
@@ -69,27 +79,86 @@ BoxInfo q3BroadPhase::GetBoxInfo(i32 id) {
 
 void q3BroadPhase::RemoveBox(const q3Box* box) {
     i32 id = box->broadPhaseIndex;
-    boxes.items[id] = undefined;
+    // a null box marks the slot as free, so pair generation and queries skip it
+    boxes.items[id] = {.box = nullptr, .aabb = undefined, .tight_aabb = undefined};
     unused_boxes.append(intCast<usize>(id)).unwrap();
+    Q3_STATS(proxies_removed += 1);
 }
 
-void q3BroadPhase::UpdatePairs(q3ContactManager* manager) {
-    pairs.shrinkRetainingCapacity(0);
+void q3BroadPhase::UpdatePairs(q3ContactManager* manager, q3JobInterface* jobs) {
+    // Boxes tested against the whole list per chunk
+    const u32 k_grain = 32;
+    u32 count = intCast<u32>(boxes.items.len);
+    usize chunk_count = (count + k_grain - 1) / k_grain;
+
+    while (chunk_pairs.items.len < chunk_count) {
+        chunk_pairs.append(ArrayList<q3ContactPair>::init(pairs.allocator)).unwrap();
+    }
 
-    for (auto [test_box, test_idx] : boxes.items.iter()) {
-        for (auto [box, box_idx] : boxes.items.iter()) {
-            if (q3AABBtoAABB(test_box.aabb, box.aabb)) {
-                if (box_idx == test_idx) continue; // Cannot collide with self
-                i32 iA = math::min(box_idx, test_idx);
-                i32 iB = math::max(box_idx, test_idx);
-                pairs.append({.A = iA, .B = iB}).unwrap();
+    q3ParallelFor(jobs, count, k_grain, [this](u32 begin, u32 end, u32 worker) {
+        Q3_TRACE_ZONE("UpdatePairs", "boxes", i64(end - begin));
+        ArrayList<q3ContactPair>* out = &chunk_pairs.items[begin / k_grain];
+        out->shrinkRetainingCapacity(0);
+
+        for (u32 test_idx = begin; test_idx < end; ++test_idx) {
+            const BoxInfo& test_box = boxes.items[test_idx];
+            if (test_box.box == nullptr) continue;
+            for (auto [box, box_idx] : boxes.items.iter()) {
+                if (box.box == nullptr) continue;
+                if (q3AABBtoAABB(test_box.aabb, box.aabb)) {
+                    if (box_idx == test_idx) continue; // Cannot collide with self
+                    // Filtered pairs are dropped here, before any contact is created
+                    if (!q3ShouldCollide(test_box.box, box.box)) continue;
+                    i32 iA = math::min(i32(box_idx), i32(test_idx));
+                    i32 iB = math::max(i32(box_idx), i32(test_idx));
+                    out->append({.A = iA, .B = iB}).unwrap();
+                }
             }
         }
+    });
+
+    // Concatenated in chunk order, the same order a single loop produces
+    pairs.shrinkRetainingCapacity(0);
+    for (usize i = 0; i < chunk_count; ++i) {
+        Slice<q3ContactPair> chunk = chunk_pairs.items[i].items;
+        // appendSlice can not take an empty slice
+        if (chunk.len > 0) pairs.appendSlice(chunk).unwrap();
     }
 }
 
+void q3BroadPhase::SortPairs() {
+    for (q3ContactPair& pair : pairs.items) {
+        if (boxes.items[pair.A].box->body->id > boxes.items[pair.B].box->body->id) {
+            i32 tmp = pair.A;
+            pair.A = pair.B;
+            pair.B = tmp;
+        }
+    }
+
+    auto key = [this](const q3ContactPair& pair) {
+        u64 A = boxes.items[pair.A].box->body->id;
+        u64 B = boxes.items[pair.B].box->body->id;
+        return (A << 32) | B;
+    };
+    std::sort(
+        pairs.items.ptr, pairs.items.ptr + pairs.items.len,
+        [&key](const q3ContactPair& a, const q3ContactPair& b) { return key(a) < key(b); }
+    );
+
+    usize count = 0;
+    for (usize i = 0; i < pairs.items.len; ++i) {
+        if (count > 0 && key(pairs.items[count - 1]) == key(pairs.items[i])) continue;
+        pairs.items[count++] = pairs.items[i];
+    }
+    pairs.shrinkRetainingCapacity(count);
+}
+
 void q3BroadPhase::Update(i32 id, const q3AABB& aabb) {
-    if (!boxes.items[id].aabb.Contains(aabb)) { boxes.items[id].aabb = FatAABB(aabb); }
+    boxes.items[id].tight_aabb = aabb;
+    if (!boxes.items[id].aabb.Contains(aabb)) {
+        boxes.items[id].aabb = FatAABB(aabb);
+        Q3_STATS(proxies_moved += 1);
+    }
 }
 
 bool q3BroadPhase::TestOverlap(i32 A, i32 B) {
@@ -28,6 +28,7 @@ distribution.
 #include "../common/q3Types.h"
 #include "../math/q3Vec3.h"
 #include "../common/q3Geometry.h"
+#include "../debug/q3StepStats.h"
 
 struct q3ContactPair {
     i32 A;
@@ -36,13 +37,20 @@ struct q3ContactPair {
 
 struct BoxInfo {
     q3Box* box;
-    q3AABB aabb;
+    q3AABB aabb;       // Fattened, only refit once the box moves out of it
+    q3AABB tight_aabb; // Exact AABB of the box as of its last Update
 };
 
 struct q3BroadPhase {
     ArrayList<q3ContactPair> pairs;
+    // Pairs found by each chunk of a parallel UpdatePairs, kept between steps
+    ArrayList<ArrayList<q3ContactPair>> chunk_pairs;
     ArrayList<BoxInfo> boxes;
     ArrayList<usize> unused_boxes;
+    // Proxy churn since the last q3Scene::Step, which copies and clears them
+    Q3_STATS(usize proxies_inserted;)
+    Q3_STATS(usize proxies_removed;)
+    Q3_STATS(usize proxies_moved;)
 
     q3BroadPhase(Allocator allocator);
     ~q3BroadPhase();
@@ -51,47 +59,76 @@ struct q3BroadPhase {
     void RemoveBox(const q3Box* shape);
     BoxInfo GetBoxInfo(i32 id);
     // Generates the contact list. All previous contacts are returned to the
-    // allocator before generation occurs.
-    void UpdatePairs(q3ContactManager* manager);
+    // allocator before generation occurs. Runs on jobs when not null, the
+    // pairs are in the same order either way.
+    void UpdatePairs(q3ContactManager* manager, q3JobInterface* jobs);
+    // Sorts the pairs by the ids of their bodies (lower id first) and drops
+    // duplicates. Unlike the proxy indices, body ids do not depend on which
+    // proxy slots were free when the boxes were inserted.
+    void SortPairs();
     void Update(i32 id, const q3AABB& aabb);
     bool TestOverlap(i32 A, i32 B);
 
     template <typename T>
     inline void Query(T* cb, const q3AABB& aabb) {
         for (auto [node, idx] : boxes.items.iter()) {
+            if (node.box == nullptr) continue;
             if (q3AABBtoAABB(aabb, node.aabb)) {
                 if (!cb->TreeCallBack(idx)) return;
             }
         }
     }
 
+    // Calls fn(box) for every box whose tight AABB overlaps aabb, until fn
+    // returns false. For exact overlap queries, which would otherwise test the
+    // fat AABB and then recompute the box AABB from its transform.
+    template <typename F>
+    void QueryTight(const q3AABB& aabb, F& fn) const {
+        for (const BoxInfo& node : boxes.items) {
+            if (node.box == nullptr) continue;
+            if (q3AABBtoAABB(aabb, node.tight_aabb) && !fn(node.box)) return;
+        }
+    }
+
+    // Calls cb->TreeCallBack(id) for every proxy the segment [0, rayCast.t]
+    // overlaps. The callback may shrink rayCast.t (e.g. to the closest hit so
+    // far) and the remaining proxies are then tested against the shorter ray.
     template <typename T>
     void Query(T* cb, q3RaycastData& rayCast) {
-        const r32 k_epsilon = r32(1.0e-6);
+        Query(cb, rayCast, q3Vec3(r32(0.0), r32(0.0), r32(0.0)));
+    }
+
+    // Swept AABB version of the ray query: the proxies overlapped by an AABB
+    // with half extents `extent` centered on the ray, anywhere along [0, t].
+    // Each proxy is grown by `extent` and tested against the bare segment.
+    template <typename T>
+    void Query(T* cb, q3RaycastData& rayCast, const q3Vec3& extent) {
         q3Vec3 p0 = rayCast.start;
-        q3Vec3 p1 = p0 + rayCast.dir * rayCast.t;
+        r32 t = rayCast.t;
+        q3Vec3 p1 = p0 + rayCast.dir * t;
 
         for (auto [node, idx] : boxes.items.iter()) {
-            q3Vec3 e = node.aabb.max - node.aabb.min;
-            q3Vec3 d = p1 - p0;
-            q3Vec3 m = p0 + p1 - node.aabb.min - node.aabb.max;
-
-            r32 adx = q3Abs(d.x);
-            r32 ady = q3Abs(d.y);
-            r32 adz = q3Abs(d.z);
-            if (q3Abs(m.x) > e.x + adx) continue;
-            if (q3Abs(m.y) > e.y + ady) continue;
-            if (q3Abs(m.z) > e.z + adz) continue;
-
-            adx += k_epsilon;
-            ady += k_epsilon;
-            adz += k_epsilon;
-
-            if (q3Abs(m.y * d.z - m.z * d.y) > e.y * adz + e.z * ady) continue;
-            if (q3Abs(m.z * d.x - m.x * d.z) > e.x * adz + e.z * adx) continue;
-            if (q3Abs(m.x * d.y - m.y * d.x) > e.x * ady + e.y * adx) continue;
+            if (node.box == nullptr) continue;
+            if (rayCast.t != t) {
+                t = rayCast.t;
+                p1 = p0 + rayCast.dir * t;
+            }
+            q3AABB grown = {.min = node.aabb.min - extent, .max = node.aabb.max + extent};
+            if (!q3SegmentAABB(p0, p1, grown)) continue;
 
             if (!cb->TreeCallBack(idx)) return;
         }
     }
+
+    // Packet raycast: calls cb->TreeCallBack(id, lanes) for every proxy hit by
+    // at least one ray of the packet, lanes being the bit mask of those rays.
+    // The callback may shrink packet.t to cull the remaining proxies.
+    template <typename T>
+    void Query(T* cb, q3RayPacket& packet) {
+        for (auto [node, idx] : boxes.items.iter()) {
+            if (node.box == nullptr) continue;
+            u32 lanes = q3RayPacketAABB(packet, node.aabb);
+            if (lanes && !cb->TreeCallBack(idx, lanes)) return;
+        }
+    }
 };
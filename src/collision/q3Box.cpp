@@ -24,10 +24,18 @@ distribution.
 */
 
 #include "q3Box.h"
+#include "../common/q3Geometry.h"
 #include "../math/q3Vec3.h"
 
 bool q3Box::TestPoint(const q3Transform& tx, const q3Vec3& p) const {
-    q3Transform world = q3Mul(tx, local);
+    return q3TestPointOBB(q3Mul(tx, local), e, p);
+}
+
+bool q3Box::Raycast(const q3Transform& tx, q3RaycastData* raycast) const {
+    return q3RaycastOBB(q3Mul(tx, local), e, raycast);
+}
+
+bool q3TestPointOBB(const q3Transform& world, const q3Vec3& e, const q3Vec3& p) {
     q3Vec3 p0 = q3MulT(world, p);
 
     for (int i = 0; i < 3; ++i) {
@@ -39,8 +47,7 @@ bool q3Box::TestPoint(const q3Transform& tx, const q3Vec3& p) const {
     return true;
 }
 
-bool q3Box::Raycast(const q3Transform& tx, q3RaycastData* raycast) const {
-    q3Transform world = q3Mul(tx, local);
+bool q3RaycastOBB(const q3Transform& world, const q3Vec3& e, q3RaycastData* raycast) {
     q3Vec3 d = q3MulT(world.rotation, raycast->dir);
     q3Vec3 p = q3MulT(world, raycast->start);
     const r32 epsilon = r32(1.0e-8);
@@ -50,7 +57,8 @@ bool q3Box::Raycast(const q3Transform& tx, q3RaycastData* raycast) const {
     // t = (e[ i ] - p.[ i ]) / d[ i ]
     r32 t0;
     r32 t1;
-    q3Vec3 n0;
+    // Stays zero when the ray starts inside the box
+    q3Vec3 n0(0, 0, 0);
 
     for (int i = 0; i < 3; ++i) {
         // Check for ray parallel to and outside of AABB
@@ -84,6 +92,153 @@ bool q3Box::Raycast(const q3Transform& tx, q3RaycastData* raycast) const {
     return true;
 }
 
+// Narrows [*tfirst, *tlast] to the part of the sweep during which the boxes
+// overlap along axis L. p is the distance between the box centers along L, q
+// its rate of change along the sweep and r the sum of both projected radii (all
+// scaled by |L|). Returns false once the interval is empty.
+static inline bool q3SweepAxis(
+    const q3Vec3& L, r32 p, r32 q, r32 r, r32* tfirst, r32* tlast, q3Vec3* n
+) {
+    // Not moving along L, so the boxes either always or never overlap on it
+    if (q3Abs(q) < r32(1.0e-8)) return q3Abs(p) <= r;
+
+    r32 t0 = (-r - p) / q;
+    r32 t1 = (r - p) / q;
+    if (t0 > t1) std::swap(t0, t1);
+
+    if (t0 > *tfirst) {
+        *tfirst = t0;
+        // The swept box approaches from the side opposite to its motion
+        *n = q > r32(0.0) ? -L : L;
+    }
+
+    *tlast = q3Min(*tlast, t1);
+
+    return *tfirst <= *tlast;
+}
+
+bool q3BoxCastOBB(const q3Transform& world, const q3Vec3& e, q3BoxCastData* cast) {
+    // Work in the frame of the target box. The columns of R are the axes of the
+    // swept box, c its center and d the sweep direction.
+    q3Mat3 R = q3MulT(world.rotation, cast->tx.rotation);
+    q3Vec3 c = q3MulT(world, cast->tx.position);
+    q3Vec3 d = q3MulT(world.rotation, cast->dir);
+    const q3Vec3& eA = cast->e;
+
+    // Same tolerance as q3BoxtoBox against near parallel edges
+    const r32 k_tol = r32(1.0e-6);
+    q3Mat3 absR;
+    for (i32 i = 0; i < 3; ++i) {
+        for (i32 j = 0; j < 3; ++j) absR[i][j] = q3Abs(R[i][j]) + k_tol;
+    }
+
+    r32 tfirst = r32(0.0);
+    r32 tlast = cast->t;
+    // Stays zero when the cast starts overlapping the box
+    q3Vec3 n(0, 0, 0);
+
+    // Face axes of the target box
+    for (i32 i = 0; i < 3; ++i) {
+        q3Vec3 L(0, 0, 0);
+        L[i] = r32(1.0);
+        r32 rA = absR[0][i] * eA.x + absR[1][i] * eA.y + absR[2][i] * eA.z;
+        if (!q3SweepAxis(L, c[i], d[i], e[i] + rA, &tfirst, &tlast, &n)) return false;
+    }
+
+    // Face axes of the swept box
+    for (i32 i = 0; i < 3; ++i) {
+        r32 rB = q3Dot(absR[i], e);
+        if (!q3SweepAxis(R[i], q3Dot(R[i], c), q3Dot(R[i], d), eA[i] + rB, &tfirst, &tlast, &n))
+            return false;
+    }
+
+    // Edge axes, skipping the degenerate ones of parallel edges
+    for (i32 i = 0; i < 3; ++i) {
+        q3Vec3 axis(0, 0, 0);
+        axis[i] = r32(1.0);
+
+        for (i32 j = 0; j < 3; ++j) {
+            q3Vec3 L = q3Cross(axis, R[j]);
+            if (q3LengthSq(L) < k_tol) continue;
+
+            r32 rA = q3Abs(q3Dot(L, R[0])) * eA.x + q3Abs(q3Dot(L, R[1])) * eA.y +
+                     q3Abs(q3Dot(L, R[2])) * eA.z;
+            r32 rB = q3Dot(q3Abs(L), e);
+            if (!q3SweepAxis(L, q3Dot(L, c), q3Dot(L, d), rA + rB, &tfirst, &tlast, &n))
+                return false;
+        }
+    }
+
+    if (tfirst > r32(0.0)) n = q3Normalize(n);
+    cast->normal = q3Mul(world.rotation, n);
+    cast->toi = tfirst;
+
+    return true;
+}
+
+u32 q3Box::RaycastPacket(
+    const q3Transform& tx, const q3RayPacket& packet, u32 lanes, q3Float4* toi, q3Float4* normal
+) const {
+    // Same slab test as Raycast, on all four lanes at once
+    q3Transform world = q3Mul(tx, local);
+    const q3Mat3& r = world.rotation;
+    const q3Float4 zero = q3SimdZero();
+    const q3Float4 one = q3SimdSplat(r32(1.0));
+    const q3Float4 epsilon = q3SimdSplat(r32(1.0e-8));
+
+    q3Float4 start[3];
+    for (i32 i = 0; i < 3; ++i) {
+        start[i] = q3SimdSub(packet.start[i], q3SimdSplat(world.position[i]));
+    }
+
+    q3Float4 tmin = zero;
+    q3Float4 tmax = packet.t;
+    q3Float4 n[3] = {zero, zero, zero};
+
+    for (i32 i = 0; i < 3; ++i) {
+        // Ray in box space, rows of the transposed rotation are its columns
+        const q3Vec3& axis = r[i];
+        q3Float4 p = q3SimdMulAdd(
+            start[0], q3SimdSplat(axis.x),
+            q3SimdMulAdd(start[1], q3SimdSplat(axis.y), q3SimdMul(start[2], q3SimdSplat(axis.z)))
+        );
+        q3Float4 d = q3SimdMulAdd(
+            packet.dir[0], q3SimdSplat(axis.x),
+            q3SimdMulAdd(
+                packet.dir[1], q3SimdSplat(axis.y), q3SimdMul(packet.dir[2], q3SimdSplat(axis.z))
+            )
+        );
+
+        // A ray parallel to the slab gets a huge 1 / d, so it misses when
+        // outside of the slab and is not clipped by it otherwise
+        q3Float4 negative = q3SimdLess(d, zero);
+        q3Float4 s = q3SimdSelect(negative, one, q3SimdNeg(one));
+        d = q3SimdSelect(q3SimdLess(q3SimdAbs(d), epsilon), d, q3SimdMul(s, epsilon));
+        q3Float4 d0 = q3SimdDiv(one, d);
+        q3Float4 ei = q3SimdMul(q3SimdSplat(e[i]), s);
+
+        q3Float4 t0 = q3SimdMul(q3SimdNeg(q3SimdAdd(ei, p)), d0);
+        q3Float4 t1 = q3SimdMul(q3SimdSub(ei, p), d0);
+
+        // Entering through this slab replaces the normal found so far
+        q3Float4 enter = q3SimdLess(tmin, t0);
+        for (i32 j = 0; j < i; ++j) n[j] = q3SimdSelect(enter, n[j], zero);
+        n[i] = q3SimdSelect(enter, zero, q3SimdNeg(s));
+        tmin = q3SimdSelect(enter, tmin, t0);
+        tmax = q3SimdMin(tmax, t1);
+    }
+
+    *toi = tmin;
+    for (i32 i = 0; i < 3; ++i) {
+        normal[i] = q3SimdMulAdd(
+            n[0], q3SimdSplat(r.e.x[i]),
+            q3SimdMulAdd(n[1], q3SimdSplat(r.e.y[i]), q3SimdMul(n[2], q3SimdSplat(r.e.z[i])))
+        );
+    }
+
+    return q3SimdMoveMask(q3SimdLessEqual(tmin, tmax)) & lanes;
+}
+
 void q3Box::ComputeAABB(const q3Transform& tx, q3AABB* aabb) const {
     q3Transform world = q3Mul(tx, local);
 
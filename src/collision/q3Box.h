@@ -35,6 +35,34 @@ struct q3MassData {
     r32 mass;
 };
 
+// An oriented box swept along a direction, see q3Scene::BoxCast
+struct q3BoxCastData {
+    q3Transform tx; // World transform of the box at the start of the sweep
+    q3Vec3 e;       // Half extents of the box
+    q3Vec3 dir;     // Direction of the sweep (normalized)
+    r32 t;          // Length of the sweep
+    u32 maskBits;   // Only boxes with a category bit in this mask are hit
+
+    r32 toi;       // Solved time of impact
+    q3Vec3 normal; // Surface normal of the box that was hit, facing the swept box
+
+    inline void Set(
+        const q3Transform& startTx, const q3Vec3& halfExtents, const q3Vec3& direction,
+        r32 endPointTime
+    ) {
+        tx = startTx;
+        e = halfExtents;
+        dir = direction;
+        t = endPointTime;
+        maskBits = 0xFFFFFFFF;
+    }
+
+    // World transform of the swept box at toi
+    inline const q3Transform GetImpactTransform() const {
+        return q3Transform{.position = tx.position + dir * toi, .rotation = tx.rotation};
+    }
+};
+
 struct q3Box {
     q3Transform local;
     q3Vec3 e; // extent, as in the extent of each OBB axis
@@ -46,12 +74,33 @@ struct q3Box {
     i32 broadPhaseIndex;
     mutable bool sensor;
 
+    // Collision filtering, see q3BoxDef for details
+    u32 categoryBits;
+    u32 maskBits;
+    i32 groupIndex;
+
     bool TestPoint(const q3Transform& tx, const q3Vec3& p) const;
     bool Raycast(const q3Transform& tx, q3RaycastData* raycast) const;
+    // Raycast of the rays of a packet selected by the `lanes` bit mask. Returns
+    // the lanes that hit before their packet t, with the time of impact and
+    // world space normal (x, y, z) of every lane in toi and normal.
+    u32 RaycastPacket(
+        const q3Transform& tx, const q3RayPacket& packet, u32 lanes, q3Float4* toi,
+        q3Float4* normal
+    ) const;
     void ComputeAABB(const q3Transform& tx, q3AABB* aabb) const;
     void ComputeMass(q3MassData* md) const;
 };
 
+// Point and ray tests of an oriented box given by its world transform and
+// half extents, shared by q3Box and the scene snapshots
+bool q3TestPointOBB(const q3Transform& world, const q3Vec3& e, const q3Vec3& p);
+bool q3RaycastOBB(const q3Transform& world, const q3Vec3& e, q3RaycastData* raycast);
+// Swept separating axis test of the cast box against an oriented box. Hits
+// before cast->t set toi and normal; a cast starting in overlap hits at toi 0
+// with a zero normal.
+bool q3BoxCastOBB(const q3Transform& world, const q3Vec3& e, q3BoxCastData* cast);
+
 struct q3BoxDef {
     q3Transform m_tx;
     q3Vec3 m_e;
@@ -61,12 +110,24 @@ struct q3BoxDef {
     r32 m_density;
     bool m_sensor;
 
+    // Collision filtering. A box belongs to the categories in `m_categoryBits`
+    // and only collides with boxes whose category is set in `m_maskBits`
+    // (and vice versa). Boxes that share the same non-zero `m_groupIndex`
+    // always collide if the index is positive and never collide if it is
+    // negative, regardless of their category and mask bits.
+    u32 m_categoryBits;
+    u32 m_maskBits;
+    i32 m_groupIndex;
+
     q3BoxDef() {
         // Common default values
         m_friction = r32(0.4);
         m_restitution = r32(0.2);
         m_density = r32(1.0);
         m_sensor = false;
+        m_categoryBits = 0x00000001;
+        m_maskBits = 0xFFFFFFFF;
+        m_groupIndex = 0;
     }
 
     void Set(const q3Transform& tx, const q3Vec3& extents) {
@@ -74,3 +135,22 @@ struct q3BoxDef {
         m_e = extents * r32(0.5);
     }
 };
+
+// The collision filter rule over the filter data of two shapes: a shared
+// non-zero group always (positive) or never (negative) collides, otherwise
+// each category has to be in the other's mask
+inline bool q3ShouldCollide(
+    u32 categoryA, u32 maskA, i32 groupA, u32 categoryB, u32 maskB, i32 groupB
+) {
+    if (groupA == groupB && groupA != 0) return groupA > 0;
+    return (maskA & categoryB) != 0 && (categoryA & maskB) != 0;
+}
+
+// Returns false if the filter data of either box rejects the pair. This is
+// checked by the broadphase before a pair is ever reported, so filtered pairs
+// never reach the narrowphase.
+inline bool q3ShouldCollide(const q3Box* a, const q3Box* b) {
+    return q3ShouldCollide(
+        a->categoryBits, a->maskBits, a->groupIndex, b->categoryBits, b->maskBits, b->groupIndex
+    );
+}
@@ -56,13 +56,6 @@ inline bool q3TrackEdgeAxis(
     return false;
 }
 
-struct q3ClipVertex {
-    q3Vec3 v;
-    q3FeaturePair f;
-
-    q3ClipVertex() { f.key = ~0; }
-};
-
 void q3ComputeReferenceEdgesAndBasis(
     const q3Vec3& eR, const q3Transform& rtx, q3Vec3 n, i32 axis, u8* out, q3Mat3* basis, q3Vec3* e
 ) {
@@ -386,9 +379,9 @@ void q3BoxtoBox(q3Manifold* m, q3Box* a, q3Box* b) {
     q3Mat3 C = b_frame_in_a;
     q3Mat3 absC;
     bool parallel = false;
-    for (usize i = 0; i < 3 * 3; i++) {
-        absC.cels[i] = q3Abs(C.cels[i]);
-        if (C.cels[i] + 1e-6 >= 1) parallel = true;
+    for (u32 i = 0; i < 3; i++) {
+        absC[i] = q3Abs(C[i]);
+        if (q3MaxPerElem(C[i]) + 1e-6 >= 1) parallel = true;
     }
 
     // Vector from center A to center B in A's space
@@ -402,9 +395,9 @@ void q3BoxtoBox(q3Manifold* m, q3Box* a, q3Box* b) {
     i32 aAxis = ~0;
     i32 bAxis = ~0;
     i32 eAxis = ~0;
-    q3Vec3 nA;
-    q3Vec3 nB;
-    q3Vec3 nE;
+    q3Vec3 nA(r32(0.0), r32(0.0), r32(0.0));
+    q3Vec3 nB(r32(0.0), r32(0.0), r32(0.0));
+    q3Vec3 nE(r32(0.0), r32(0.0), r32(0.0));
 
     // Face axis checks
 
@@ -594,3 +587,80 @@ void q3BoxtoBox(q3Manifold* m, q3Box* a, q3Box* b) {
         c->position = (CA + CB) * r32(0.5);
     }
 }
+
+bool q3BoxOverlap(const q3Box* a, const q3Box* b) {
+    q3Transform atx = q3Mul(a->body->m_tx, a->local);
+    q3Transform btx = q3Mul(b->body->m_tx, b->local);
+    q3Vec3 eA = a->e;
+    q3Vec3 eB = b->e;
+
+    // B's frame in A's space. The epsilon keeps the edge axes from reporting
+    // a false separation when two edges are (nearly) parallel and their cross
+    // product degenerates to zero.
+    q3Mat3 C = q3Transpose(atx.rotation) * btx.rotation;
+    q3Mat3 absC;
+    const q3Vec3 eps(r32(1.0e-6), r32(1.0e-6), r32(1.0e-6));
+    for (u32 i = 0; i < 3; i++) absC[i] = q3Abs(C[i]) + eps;
+
+    // Vector from center A to center B in A's space
+    q3Vec3 t = q3MulT(atx.rotation, btx.position - atx.position);
+
+    // Face axes of A and B
+    if (q3Abs(t.x) > eA.x + q3Dot(absC.col(0), eB)) return false;
+    if (q3Abs(t.y) > eA.y + q3Dot(absC.col(1), eB)) return false;
+    if (q3Abs(t.z) > eA.z + q3Dot(absC.col(2), eB)) return false;
+    if (q3Abs(q3Dot(t, C.e.x)) > eB.x + q3Dot(absC.e.x, eA)) return false;
+    if (q3Abs(q3Dot(t, C.e.y)) > eB.y + q3Dot(absC.e.y, eA)) return false;
+    if (q3Abs(q3Dot(t, C.e.z)) > eB.z + q3Dot(absC.e.z, eA)) return false;
+
+    // Edge axes, same order as in q3BoxtoBox
+    r32 rA;
+    r32 rB;
+
+    // Cross( a.x, b.x )
+    rA = eA.y * absC[0][2] + eA.z * absC[0][1];
+    rB = eB.y * absC[2][0] + eB.z * absC[1][0];
+    if (q3Abs(t.z * C[0][1] - t.y * C[0][2]) > rA + rB) return false;
+
+    // Cross( a.x, b.y )
+    rA = eA.y * absC[1][2] + eA.z * absC[1][1];
+    rB = eB.x * absC[2][0] + eB.z * absC[0][0];
+    if (q3Abs(t.z * C[1][1] - t.y * C[1][2]) > rA + rB) return false;
+
+    // Cross( a.x, b.z )
+    rA = eA.y * absC[2][2] + eA.z * absC[2][1];
+    rB = eB.x * absC[1][0] + eB.y * absC[0][0];
+    if (q3Abs(t.z * C[2][1] - t.y * C[2][2]) > rA + rB) return false;
+
+    // Cross( a.y, b.x )
+    rA = eA.x * absC[0][2] + eA.z * absC[0][0];
+    rB = eB.y * absC[2][1] + eB.z * absC[1][1];
+    if (q3Abs(t.x * C[0][2] - t.z * C[0][0]) > rA + rB) return false;
+
+    // Cross( a.y, b.y )
+    rA = eA.x * absC[1][2] + eA.z * absC[1][0];
+    rB = eB.x * absC[2][1] + eB.z * absC[0][1];
+    if (q3Abs(t.x * C[1][2] - t.z * C[1][0]) > rA + rB) return false;
+
+    // Cross( a.y, b.z )
+    rA = eA.x * absC[2][2] + eA.z * absC[2][0];
+    rB = eB.x * absC[1][1] + eB.y * absC[0][1];
+    if (q3Abs(t.x * C[2][2] - t.z * C[2][0]) > rA + rB) return false;
+
+    // Cross( a.z, b.x )
+    rA = eA.x * absC[0][1] + eA.y * absC[0][0];
+    rB = eB.y * absC[2][2] + eB.z * absC[1][2];
+    if (q3Abs(t.y * C[0][0] - t.x * C[0][1]) > rA + rB) return false;
+
+    // Cross( a.z, b.y )
+    rA = eA.x * absC[1][1] + eA.y * absC[1][0];
+    rB = eB.x * absC[2][2] + eB.z * absC[0][2];
+    if (q3Abs(t.y * C[1][0] - t.x * C[1][1]) > rA + rB) return false;
+
+    // Cross( a.z, b.z )
+    rA = eA.x * absC[2][1] + eA.y * absC[2][0];
+    rB = eB.x * absC[1][2] + eB.y * absC[0][2];
+    if (q3Abs(t.y * C[2][0] - t.x * C[2][1]) > rA + rB) return false;
+
+    return true;
+}
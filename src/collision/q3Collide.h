@@ -26,5 +26,47 @@ distribution.
 #pragma once
 
 #include "../common/q3Types.h"
+#include "../math/q3Mat3.h"
+#include "../math/q3Vec3.h"
+
+union q3FeaturePair {
+    struct {
+        u8 inR;
+        u8 outR;
+        u8 inI;
+        u8 outI;
+    };
+
+    i32 key;
+};
+
+struct q3ClipVertex {
+    q3Vec3 v;
+    q3FeaturePair f;
+
+    q3ClipVertex() { f.key = ~0; }
+};
 
 void q3BoxtoBox(q3Manifold* m, q3Box* a, q3Box* b);
+
+// Boolean OBB vs OBB separating axis test. Unlike q3BoxtoBox no reference face
+// is picked and nothing is clipped, so this is much cheaper when only the
+// overlap itself is needed (sensors).
+bool q3BoxOverlap(const q3Box* a, const q3Box* b);
+
+// Building blocks of q3BoxtoBox's face contact path, exposed so they can be
+// benchmarked on their own (see demo/microbench.cpp).
+
+// Picks the side planes of the reference face of a box with half extents eR
+// and builds a basis with the face normal as z.
+void q3ComputeReferenceEdgesAndBasis(
+    const q3Vec3& eR, const q3Transform& rtx, q3Vec3 n, i32 axis, u8* out, q3Mat3* basis, q3Vec3* e
+);
+// The four world space vertices of the face of a box most anti-parallel to n
+void q3ComputeIncidentFace(const q3Transform& itx, const q3Vec3& e, q3Vec3 n, q3ClipVertex* out);
+// Clips the incident face against the reference face side planes, keeping the
+// (up to 8) vertices behind the reference face. Returns the vertex count.
+i32 q3Clip(
+    const q3Vec3& rPos, const q3Vec3& e, u8* clipEdges, const q3Mat3& basis, q3ClipVertex* incident,
+    q3ClipVertex* outVerts, r32* outDepths
+);
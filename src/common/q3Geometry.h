@@ -96,6 +96,91 @@ struct q3RaycastData {
     inline const q3Vec3 GetImpactPoint() const { return q3Vec3(start + dir * toi); }
 };
 
+// Separating axis test of the segment p0 p1 against an AABB
+inline bool q3SegmentAABB(const q3Vec3& p0, const q3Vec3& p1, const q3AABB& aabb) {
+    const r32 k_epsilon = r32(1.0e-6);
+    q3Vec3 e = aabb.max - aabb.min;
+    q3Vec3 d = p1 - p0;
+    q3Vec3 m = p0 + p1 - aabb.min - aabb.max;
+
+    r32 adx = q3Abs(d.x);
+    r32 ady = q3Abs(d.y);
+    r32 adz = q3Abs(d.z);
+    if (q3Abs(m.x) > e.x + adx) return false;
+    if (q3Abs(m.y) > e.y + ady) return false;
+    if (q3Abs(m.z) > e.z + adz) return false;
+
+    adx += k_epsilon;
+    ady += k_epsilon;
+    adz += k_epsilon;
+
+    if (q3Abs(m.y * d.z - m.z * d.y) > e.y * adz + e.z * ady) return false;
+    if (q3Abs(m.z * d.x - m.x * d.z) > e.x * adz + e.z * adx) return false;
+    if (q3Abs(m.x * d.y - m.y * d.x) > e.x * ady + e.y * adx) return false;
+
+    return true;
+}
+
+// Closest hit of one ray of q3Scene::RayCastBatch
+struct q3RayHit {
+    q3Box* box;    // Null when the ray hit nothing
+    r32 toi;       // Time of impact along the ray (the ray's t when nothing was hit)
+    q3Vec3 normal; // World space surface normal, zero when the ray starts inside the box
+};
+
+// Four rays in structure of arrays layout so they can be traced together, one
+// ray per SIMD lane. Lanes past the end of a batch have t = -1 and never hit.
+struct q3RayPacket {
+    q3Float4 start[3];
+    q3Float4 dir[3];
+    q3Float4 invDir[3]; // 1 / dir, near zero components clamped to keep it finite
+    q3Float4 t;         // Ray length, shrunk to the closest hit found so far
+
+    void Set(const q3RaycastData* rays, i32 count) {
+        r32 lanes[10][4];
+
+        for (i32 i = 0; i < 4; ++i) {
+            const q3RaycastData& ray = rays[i < count ? i : 0];
+            for (i32 axis = 0; axis < 3; ++axis) {
+                r32 d = ray.dir[axis];
+                if (q3Abs(d) < r32(1.0e-8)) d = d < r32(0.0) ? -r32(1.0e-8) : r32(1.0e-8);
+
+                lanes[axis][i] = ray.start[axis];
+                lanes[3 + axis][i] = ray.dir[axis];
+                lanes[6 + axis][i] = r32(1.0) / d;
+            }
+            lanes[9][i] = i < count ? ray.t : -r32(1.0);
+        }
+
+        for (i32 axis = 0; axis < 3; ++axis) {
+            start[axis] = q3SimdLoad(lanes[axis]);
+            dir[axis] = q3SimdLoad(lanes[3 + axis]);
+            invDir[axis] = q3SimdLoad(lanes[6 + axis]);
+        }
+        t = q3SimdLoad(lanes[9]);
+    }
+};
+
+// Slab test of the four segments [0, t] of the packet against an AABB.
+// Returns the lanes that overlap it as a bit mask.
+inline u32 q3RayPacketAABB(const q3RayPacket& packet, const q3AABB& aabb) {
+    q3Float4 tmin = q3SimdZero();
+    q3Float4 tmax = packet.t;
+
+    for (i32 axis = 0; axis < 3; ++axis) {
+        q3Float4 t0 = q3SimdMul(
+            q3SimdSub(q3SimdSplat(aabb.min[axis]), packet.start[axis]), packet.invDir[axis]
+        );
+        q3Float4 t1 = q3SimdMul(
+            q3SimdSub(q3SimdSplat(aabb.max[axis]), packet.start[axis]), packet.invDir[axis]
+        );
+        tmin = q3SimdMax(tmin, q3SimdMin(t0, t1));
+        tmax = q3SimdMin(tmax, q3SimdMax(t0, t1));
+    }
+
+    return q3SimdMoveMask(q3SimdLessEqual(tmin, tmax));
+}
+
 inline void q3ComputeBasis(const q3Vec3& a, q3Vec3* __restrict b, q3Vec3* __restrict c) {
     if (q3Abs(a.x) >= r32(0.57735027)) {
         b->Set(a.y, -a.x, r32(0.0));
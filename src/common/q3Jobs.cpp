@@ -0,0 +1,230 @@
+/**
+@file	q3Jobs.cpp
+
+        This software is provided 'as-is', without any express or implied
+        warranty. In no event will the authors be held liable for any damages
+        arising from the use of this software.
+
+        Permission is granted to anyone to use this software for any purpose,
+        including commercial applications, and to alter it and redistribute it
+        freely, subject to the following restrictions:
+          1. The origin of this software must not be misrepresented; you must
+not claim that you wrote the original software. If you use this software in a
+product, an acknowledgment in the product documentation would be appreciated but
+is not required.
+          2. Altered source versions must be plainly marked as such, and must
+not be misrepresented as being the original software.
+          3. This notice may not be removed or altered from any source
+distribution.
+*/
+
+
+#include "q3Jobs.h"
+#include "../debug/q3Trace.h"
+
+static_assert(
+    (Q3_JOB_QUEUE_SIZE & (Q3_JOB_QUEUE_SIZE - 1)) == 0, "Q3_JOB_QUEUE_SIZE must be a power of two"
+);
+
+// The job system whose worker thread this is, and the worker index in it
+static thread_local const q3JobSystem* worker_system = nullptr;
+static thread_local u32 worker_index = 0;
+
+q3Task::q3Task(q3TaskFn fn, void* ctx) : fn(fn), ctx(ctx), pending(1), done(false) {
+    dependent_count = 0;
+}
+
+void q3Task::Reset(q3TaskFn fn, void* ctx) {
+    this->fn = fn;
+    this->ctx = ctx;
+    pending.store(1, std::memory_order_relaxed);
+    done.store(false, std::memory_order_relaxed);
+    dependent_count = 0;
+}
+
+bool q3JobQueue::Push(q3Task* task) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (tail - head == Q3_JOB_QUEUE_SIZE) return false;
+    tasks[tail & (Q3_JOB_QUEUE_SIZE - 1)] = task;
+    tail += 1;
+    return true;
+}
+
+q3Task* q3JobQueue::Pop() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (tail == head) return nullptr;
+    tail -= 1;
+    return tasks[tail & (Q3_JOB_QUEUE_SIZE - 1)];
+}
+
+q3Task* q3JobQueue::Steal() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (tail == head) return nullptr;
+    q3Task* task = tasks[head & (Q3_JOB_QUEUE_SIZE - 1)];
+    head += 1;
+    return task;
+}
+
+q3JobSystem::q3JobSystem(i32 threads) : queued(0), quit(false) {
+    if (threads < 0) threads = i32(std::thread::hardware_concurrency()) - 1;
+    if (threads < 0) threads = 0;
+    if (threads > Q3_MAX_WORKERS - 1) threads = Q3_MAX_WORKERS - 1;
+
+    thread_count = u32(threads);
+    queues = new q3JobQueue[thread_count + 1];
+    this->threads = new std::thread[thread_count];
+    for (u32 i = 0; i < thread_count; ++i) {
+        this->threads[i] = std::thread(&q3JobSystem::WorkerMain, this, i + 1);
+    }
+}
+
+q3JobSystem::~q3JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        quit.store(true);
+    }
+    wake.notify_all();
+
+    for (u32 i = 0; i < thread_count; ++i) threads[i].join();
+    delete[] threads;
+    delete[] queues;
+}
+
+u32 q3JobSystem::WorkerCount() const {
+    return thread_count + 1;
+}
+
+u32 q3JobSystem::CurrentWorker() const {
+    return worker_system == this ? worker_index : 0;
+}
+
+void q3JobSystem::AddDependency(q3Task* task, q3Task* dependency) {
+    debug::assert(dependency->dependent_count < Q3_TASK_MAX_DEPENDENTS);
+    dependency->dependents[dependency->dependent_count++] = task;
+    task->pending.fetch_add(1, std::memory_order_relaxed);
+}
+
+void q3JobSystem::Submit(q3Task* task) {
+    if (task->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) Push(task, CurrentWorker());
+}
+
+void q3JobSystem::Push(q3Task* task, u32 worker) {
+    // A full queue means the tasks are tiny compared to the queue size, so
+    // running this one right away is as good as queueing it
+    if (!queues[worker].Push(task)) {
+        Execute(task, worker);
+        return;
+    }
+
+    queued.fetch_add(1, std::memory_order_release);
+    if (thread_count > 0) {
+        // Taking the lock orders this against a worker about to sleep, so the
+        // notification can not be lost
+        { std::lock_guard<std::mutex> lock(sleep_mutex); }
+        wake.notify_one();
+    }
+}
+
+q3Task* q3JobSystem::FindTask(u32 worker) {
+    q3Task* task = queues[worker].Pop();
+
+    // Steal the oldest task of another worker, those tend to be the largest
+    for (u32 i = 1; task == nullptr && i <= thread_count; ++i) {
+        task = queues[(worker + i) % (thread_count + 1)].Steal();
+    }
+
+    if (task) queued.fetch_sub(1, std::memory_order_relaxed);
+    return task;
+}
+
+void q3JobSystem::Execute(q3Task* task, u32 worker) {
+    task->fn(task->ctx, worker);
+
+    // The dependents have to be read before `done` is set: the owner of the
+    // task may free it as soon as it sees it finished
+    for (u32 i = 0; i < task->dependent_count; ++i) {
+        q3Task* dependent = task->dependents[i];
+        if (dependent->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) Push(dependent, worker);
+    }
+    task->done.store(true, std::memory_order_release);
+}
+
+void q3JobSystem::Wait(q3Task* task) {
+    u32 worker = CurrentWorker();
+    while (!task->done.load(std::memory_order_acquire)) {
+        q3Task* other = FindTask(worker);
+        if (other) {
+            Execute(other, worker);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void q3JobSystem::WorkerMain(u32 worker) {
+    worker_system = this;
+    worker_index = worker;
+
+    while (true) {
+        q3Task* task = FindTask(worker);
+        if (task) {
+            Execute(task, worker);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        wake.wait(lock, [this] {
+            return quit.load() || queued.load(std::memory_order_acquire) > 0;
+        });
+        if (quit.load()) return;
+    }
+}
+
+// Shared by the helper tasks of one ParallelFor, which take chunks until none
+// are left. The calling thread takes chunks too, so a loop finishes even if
+// no worker is free to help.
+struct q3ParallelRange {
+    q3RangeFn fn;
+    void* ctx;
+    u32 count;
+    u32 grain;
+    u32 chunks;
+    std::atomic<u32> next;
+
+    static void Run(void* ctx, u32 worker) {
+        q3ParallelRange* range = (q3ParallelRange*)ctx;
+        Q3_TRACE_ZONE("ParallelFor");
+
+        u32 chunk = range->next.fetch_add(1, std::memory_order_relaxed);
+        for (; chunk < range->chunks; chunk = range->next.fetch_add(1, std::memory_order_relaxed)) {
+            u32 begin = chunk * range->grain;
+            u32 end = begin + range->grain < range->count ? begin + range->grain : range->count;
+            range->fn(range->ctx, begin, end, worker);
+        }
+    }
+};
+
+void q3JobSystem::ParallelFor(u32 count, u32 grain, q3RangeFn fn, void* ctx) {
+    debug::assert(grain > 0);
+    q3ParallelRange range;
+    range.fn = fn;
+    range.ctx = ctx;
+    range.count = count;
+    range.grain = grain;
+    range.chunks = (count + grain - 1) / grain;
+    range.next.store(0, std::memory_order_relaxed);
+
+    u32 helper_count = range.chunks < WorkerCount() ? range.chunks : WorkerCount();
+    helper_count = helper_count > 0 ? helper_count - 1 : 0;
+
+    q3Task helpers[Q3_MAX_WORKERS];
+    for (u32 i = 0; i < helper_count; ++i) {
+        helpers[i].Reset(q3ParallelRange::Run, &range);
+        Submit(&helpers[i]);
+    }
+
+    q3ParallelRange::Run(&range, CurrentWorker());
+
+    // Helpers that start late find no chunk left and return right away
+    for (u32 i = 0; i < helper_count; ++i) Wait(&helpers[i]);
+}
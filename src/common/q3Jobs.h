@@ -0,0 +1,172 @@
+/**
+@file	q3Jobs.h
+
+        This software is provided 'as-is', without any express or implied
+        warranty. In no event will the authors be held liable for any damages
+        arising from the use of this software.
+
+        Permission is granted to anyone to use this software for any purpose,
+        including commercial applications, and to alter it and redistribute it
+        freely, subject to the following restrictions:
+          1. The origin of this software must not be misrepresented; you must
+not claim that you wrote the original software. If you use this software in a
+product, an acknowledgment in the product documentation would be appreciated but
+is not required.
+          2. Altered source versions must be plainly marked as such, and must
+not be misrepresented as being the original software.
+          3. This notice may not be removed or altered from any source
+distribution.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+#include "q3Types.h"
+
+// Multithreading of q3Scene::Step. The scene runs its parallel loops through
+// a q3JobInterface: either the engine's own q3JobSystem thread pool or an
+// implementation on top of the game's job scheduler.
+//
+//     q3JobSystem jobs(3); // Three worker threads besides the calling one
+//     scene.jobs = &jobs;
+//     scene.Step(); // Broadphase, narrowphase and integration run in parallel
+//
+// Without jobs (the default) everything runs on the thread calling Step().
+
+// Processes the indices [begin, end) of a parallel loop. `worker` is the
+// index of the running thread, below q3JobInterface::WorkerCount(), so it can
+// index per-thread scratch memory. A thread blocked in a nested ParallelFor or
+// q3JobSystem::Wait runs other chunks (also of an outer loop) under the same
+// index, so per-worker scratch must not be held across a nested ParallelFor.
+typedef void (*q3RangeFn)(void* ctx, u32 begin, u32 end, u32 worker);
+
+struct q3JobInterface {
+    virtual ~q3JobInterface() {}
+
+    // Number of threads that may run ranges at once, the caller included
+    virtual u32 WorkerCount() const = 0;
+    // Index of the calling thread, below WorkerCount(). 0 for the thread that
+    // calls Step() and any other thread that is not a worker.
+    virtual u32 CurrentWorker() const = 0;
+
+    // Calls fn on every chunk [i * grain, min((i + 1) * grain, count)) and returns
+    // once all of them ran. Chunks may run in any order and on any thread,
+    // including the calling one, but must have exactly these bounds: the engine
+    // stores results per chunk to keep them in the same order as a serial loop.
+    virtual void ParallelFor(u32 count, u32 grain, q3RangeFn fn, void* ctx) = 0;
+};
+
+// Runs fn(begin, end, worker) over [0, count) in chunks of grain indices on
+// jobs, or on the calling thread (as its current worker, 0 without jobs) when
+// jobs is null or there is only one chunk.
+template <typename F>
+inline void q3ParallelFor(q3JobInterface* jobs, u32 count, u32 grain, F&& fn) {
+    if (jobs == nullptr || count <= grain) {
+        u32 worker = jobs ? jobs->CurrentWorker() : 0;
+        for (u32 begin = 0; begin < count; begin += grain) {
+            fn(begin, begin + grain < count ? begin + grain : count, worker);
+        }
+        return;
+    }
+
+    using Fn = std::remove_reference_t<F>;
+    auto range = [](void* ctx, u32 begin, u32 end, u32 worker) {
+        (*(Fn*)ctx)(begin, end, worker);
+    };
+    jobs->ParallelFor(count, grain, range, (void*)&fn);
+}
+
+#ifndef Q3_MAX_WORKERS
+#define Q3_MAX_WORKERS 64 // Worker threads of a q3JobSystem, the calling thread included
+#endif
+
+#ifndef Q3_JOB_QUEUE_SIZE
+#define Q3_JOB_QUEUE_SIZE 1024 // Tasks per worker deque, must be a power of two
+#endif
+
+#ifndef Q3_TASK_MAX_DEPENDENTS
+#define Q3_TASK_MAX_DEPENDENTS 8
+#endif
+
+typedef void (*q3TaskFn)(void* ctx, u32 worker);
+
+// Unit of work of a q3JobSystem. Tasks are owned by the caller and have to
+// outlive the Wait() on them, the job system never allocates or frees one.
+struct q3Task {
+    q3TaskFn fn;
+    void* ctx;
+    // Unfinished dependencies, plus one until the task is submitted
+    std::atomic<u32> pending;
+    std::atomic<bool> done;
+    q3Task* dependents[Q3_TASK_MAX_DEPENDENTS];
+    u32 dependent_count;
+
+    q3Task(q3TaskFn fn = nullptr, void* ctx = nullptr);
+
+    // Prepares a finished (or never submitted) task to be submitted again
+    void Reset(q3TaskFn fn, void* ctx);
+};
+
+// Double ended task queue of one worker. The owner pushes and pops the newest
+// tasks, idle workers steal the oldest ones from the other end. Not lock-free:
+// every push, pop and steal takes the queue's mutex.
+struct alignas(64) q3JobQueue {
+    std::mutex mutex;
+    q3Task* tasks[Q3_JOB_QUEUE_SIZE];
+    u32 head; // Oldest task, where thieves take from
+    u32 tail; // One past the newest task, owned by the worker
+
+    q3JobQueue() : head(0), tail(0) {}
+
+    bool Push(q3Task* task);
+    q3Task* Pop();
+    q3Task* Steal();
+};
+
+// Work-stealing thread pool over mutex guarded per-worker deques. Worker 0 is
+// the thread that owns the job system (the one calling Step(), or the step
+// thread while a q3Scene::StepAsync() runs); workers 1 to WorkerCount() - 1
+// are threads started by the constructor that sleep while there is no work.
+// Threads waiting on a task run other tasks in the meantime, or yield when
+// there are none, so tasks and parallel loops may be nested, with the
+// per-worker scratch caveat of q3RangeFn. Only one thread that is not a worker
+// may use the job system at a time.
+struct q3JobSystem : q3JobInterface {
+    q3JobQueue* queues; // One per worker
+    std::thread* threads;
+    u32 thread_count;
+
+    std::atomic<u32> queued; // Tasks in any queue, idle workers sleep while zero
+    std::atomic<bool> quit;
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+
+    // Starts `threads` worker threads, one less than the hardware threads when
+    // negative. Zero runs every task on the calling thread.
+    explicit q3JobSystem(i32 threads = -1);
+    ~q3JobSystem();
+
+    // `task` does not start before `dependency` finished. Must be called before
+    // either task is submitted.
+    void AddDependency(q3Task* task, q3Task* dependency);
+    // Queues the task to run once its dependencies finished
+    void Submit(q3Task* task);
+    // Runs other tasks until `task` finished
+    void Wait(q3Task* task);
+
+    u32 WorkerCount() const override;
+    u32 CurrentWorker() const override;
+    void ParallelFor(u32 count, u32 grain, q3RangeFn fn, void* ctx) override;
+
+    // helpers
+    void Push(q3Task* task, u32 worker);
+    q3Task* FindTask(u32 worker);
+    void Execute(q3Task* task, u32 worker);
+    void WorkerMain(u32 worker);
+};
@@ -35,3 +35,6 @@ distribution.
 #define Q3_BAUMGARTE r32(0.2)
 
 #define Q3_PENETRATION_SLOP r32(0.05)
+
+// Largest push out of one contact point per position iteration
+#define Q3_MAX_LINEAR_CORRECTION r32(0.2)
@@ -41,8 +41,11 @@ typedef unsigned int u32;
 // forward declare all the types here because this is a mess
 struct q3AABB;
 struct q3Body;
+struct q3BodyDelta;
+struct q3BodyCommand;
 struct q3BodyDef;
 struct q3Box;
+struct q3BoxCastData;
 struct q3BoxDef;
 struct q3BroadPhase;
 struct q3ClipVertex;
@@ -57,14 +60,23 @@ struct q3ContactSolver;
 struct q3ContactState;
 struct q3HalfSpace;
 struct q3Island;
+struct q3JobInterface;
 struct q3Manifold;
 struct q3MassData;
 struct q3Mat3;
 struct q3Quaternion;
 struct q3QueryCallback;
 struct q3RaycastData;
+struct q3RayPacket;
+struct q3Recorder;
 struct q3Render;
+struct q3RollbackState;
 struct q3Scene;
+struct q3SceneSnapshots;
+struct q3SceneState;
+struct q3SnapshotProxy;
+struct q3SnapshotView;
+struct q3StaticWorld;
 struct q3Transform;
 struct q3Vec3;
 struct q3VelocityState;
@@ -0,0 +1,88 @@
+/**
+@file	q3StepStats.h
+
+        This software is provided 'as-is', without any express or implied
+        warranty. In no event will the authors be held liable for any damages
+        arising from the use of this software.
+
+        Permission is granted to anyone to use this software for any purpose,
+        including commercial applications, and to alter it and redistribute it
+        freely, subject to the following restrictions:
+          1. The origin of this software must not be misrepresented; you must
+not claim that you wrote the original software. If you use this software in a
+product, an acknowledgment in the product documentation would be appreciated but
+is not required.
+          2. Altered source versions must be plainly marked as such, and must
+not be misrepresented as being the original software.
+          3. This notice may not be removed or altered from any source
+distribution.
+*/
+
+#pragma once
+
+#include "../common/q3Types.h"
+
+// Per-phase timings and counters of the last q3Scene::Step. Only collected
+// when compiled with -DQ3_STEP_STATS, otherwise q3Scene has no stats member
+// and every Q3_STATS(...) statement expands to nothing.
+#ifdef Q3_STEP_STATS
+
+#include <chrono>
+
+#define Q3_STATS(...) __VA_ARGS__
+
+struct q3StepStats {
+    // Wall time in milliseconds, except for the solve phases (integrate to
+    // positions) which are summed over the islands: with jobs those run in
+    // parallel, so the sums are thread time and can exceed the step.
+    f64 total;
+    f64 test_collisions;     // Narrowphase, removes stale contacts
+    f64 island_build;        // DFS over the contact graph
+    f64 island_integrate;    // Gravity, forces and damping
+    f64 island_presolve;     // Contact solver setup and warm starting
+    f64 island_iterations;   // Velocity iterations
+    f64 island_writeback;    // Copy back velocities, integrate positions
+    f64 island_positions;    // Position iterations
+    f64 contact_events;      // ReportContactEvents
+    f64 synchronize_proxies; // Refit broadphase AABBs
+    f64 find_new_contacts;   // Broadphase pair generation and AddContact
+
+    // Counters
+    usize bodies;
+    usize contacts;        // Contact constraints after TestCollisions
+    usize pairs;           // Overlapping broadphase pairs
+    usize new_contacts;    // Contacts created by FindNewContacts
+    usize islands;
+    usize island_contacts; // Touching contacts handed to the solver
+    usize manifold_points;
+
+    // Broadphase proxy churn since the previous Step (bodies created or
+    // removed in between are included). Moved proxies outgrew their fat AABB.
+    usize proxies_inserted;
+    usize proxies_removed;
+    usize proxies_moved;
+
+    // Allocator calls made during this Step and the bytes live afterwards,
+    // counted over all allocators in the process (see AllocatorStats)
+    usize alloc_calls;
+    usize free_calls;
+    usize live_bytes;
+};
+
+struct q3StatsTimer {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // Milliseconds since construction or the previous Lap()
+    f64 Lap() {
+        auto now = std::chrono::steady_clock::now();
+        f64 ms = std::chrono::duration<f64, std::milli>(now - start).count();
+        start = now;
+        return ms;
+    }
+};
+
+#else
+
+#define Q3_STATS(...)
+
+#endif // Q3_STEP_STATS
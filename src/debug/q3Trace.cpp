@@ -0,0 +1,126 @@
+/**
+@file	q3Trace.cpp
+
+        This software is provided 'as-is', without any express or implied
+        warranty. In no event will the authors be held liable for any damages
+        arising from the use of this software.
+
+        Permission is granted to anyone to use this software for any purpose,
+        including commercial applications, and to alter it and redistribute it
+        freely, subject to the following restrictions:
+          1. The origin of this software must not be misrepresented; you must
+not claim that you wrote the original software. If you use this software in a
+product, an acknowledgment in the product documentation would be appreciated but
+is not required.
+          2. Altered source versions must be plainly marked as such, and must
+not be misrepresented as being the original software.
+          3. This notice may not be removed or altered from any source
+distribution.
+*/
+
+#include "q3Trace.h"
+
+#ifdef Q3_TRACE
+
+#include <chrono>
+
+static_assert(
+    (Q3_TRACE_BUFFER_SIZE & (Q3_TRACE_BUFFER_SIZE - 1)) == 0,
+    "Q3_TRACE_BUFFER_SIZE must be a power of two"
+);
+
+static std::atomic<bool> trace_enabled(false);
+static std::atomic<u64> trace_start_ns(0);
+static std::atomic<u32> trace_thread_count(0);
+// Lock-free list of every thread's buffer, only ever pushed to
+static std::atomic<q3TraceBuffer*> trace_buffers(nullptr);
+static thread_local q3TraceBuffer* thread_buffer = nullptr;
+
+u64 q3TraceNow() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return u64(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+}
+
+static q3TraceBuffer* q3TraceThreadBuffer() {
+    if (thread_buffer) return thread_buffer;
+
+    // Buffers are never freed, so the events of threads that already exited
+    // can still be written out
+    Allocator allocator;
+    q3TraceBuffer* buffer = allocator.create<q3TraceBuffer>().unwrap();
+    buffer->events = allocator.alloc<q3TraceEvent>(Q3_TRACE_BUFFER_SIZE).unwrap().ptr;
+    buffer->head = 0;
+    buffer->thread_id = trace_thread_count.fetch_add(1, std::memory_order_relaxed);
+
+    buffer->next = trace_buffers.load(std::memory_order_relaxed);
+    while (!trace_buffers.compare_exchange_weak(
+        buffer->next, buffer, std::memory_order_release, std::memory_order_relaxed
+    )) {
+    }
+
+    thread_buffer = buffer;
+    return buffer;
+}
+
+void q3TraceRecord(const q3TraceEvent& event) {
+    q3TraceBuffer* buffer = q3TraceThreadBuffer();
+    std::atomic_ref<u64> published(buffer->head);
+    u64 head = published.load(std::memory_order_relaxed);
+    buffer->events[head & (Q3_TRACE_BUFFER_SIZE - 1)] = event;
+    published.store(head + 1, std::memory_order_release);
+}
+
+void q3TraceStart() {
+    trace_start_ns.store(q3TraceNow(), std::memory_order_relaxed);
+    trace_enabled.store(true, std::memory_order_release);
+}
+
+void q3TraceStop() {
+    trace_enabled.store(false, std::memory_order_release);
+}
+
+bool q3TraceEnabled() {
+    return trace_enabled.load(std::memory_order_relaxed);
+}
+
+void q3TraceWrite(FILE* file) {
+    u64 start = trace_start_ns.load(std::memory_order_relaxed);
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"qu3e\"}}");
+
+    q3TraceBuffer* buffer = trace_buffers.load(std::memory_order_acquire);
+    for (; buffer; buffer = buffer->next) {
+        fprintf(
+            file,
+            ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":"
+            "\"thread %u\"}}",
+            buffer->thread_id, buffer->thread_id
+        );
+
+        u64 head = std::atomic_ref<u64>(buffer->head).load(std::memory_order_acquire);
+        u64 count = head < Q3_TRACE_BUFFER_SIZE ? head : Q3_TRACE_BUFFER_SIZE;
+
+        for (u64 i = head - count; i < head; ++i) {
+            const q3TraceEvent& event = buffer->events[i & (Q3_TRACE_BUFFER_SIZE - 1)];
+            if (event.start_ns < start) continue;
+
+            // Chrome expects microseconds
+            fprintf(
+                file,
+                ",\n{\"name\":\"%s\",\"cat\":\"qu3e\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                "\"ts\":%.3f,\"dur\":%.3f",
+                event.name, buffer->thread_id, f64(event.start_ns - start) / 1000.0,
+                f64(event.duration_ns) / 1000.0
+            );
+            if (event.arg_name) {
+                fprintf(file, ",\"args\":{\"%s\":%lld}", event.arg_name, (long long)event.arg_value);
+            }
+            fprintf(file, "}");
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+}
+
+#endif // Q3_TRACE
@@ -0,0 +1,120 @@
+/**
+@file	q3Trace.h
+
+        This software is provided 'as-is', without any express or implied
+        warranty. In no event will the authors be held liable for any damages
+        arising from the use of this software.
+
+        Permission is granted to anyone to use this software for any purpose,
+        including commercial applications, and to alter it and redistribute it
+        freely, subject to the following restrictions:
+          1. The origin of this software must not be misrepresented; you must
+not claim that you wrote the original software. If you use this software in a
+product, an acknowledgment in the product documentation would be appreciated but
+is not required.
+          2. Altered source versions must be plainly marked as such, and must
+not be misrepresented as being the original software.
+          3. This notice may not be removed or altered from any source
+distribution.
+*/
+
+#pragma once
+
+#include <stdio.h>
+
+#include "../common/q3Types.h"
+
+// Timeline tracing of q3Scene::Step, compiled in with -DQ3_TRACE.
+//
+// Every thread records its zones into its own fixed size ring buffer, so
+// recording never takes a lock and never allocates after the first zone on a
+// thread. Once the buffer wraps the oldest events are overwritten.
+//
+//     q3TraceStart();
+//     for (...) scene.Step();
+//     q3TraceStop();
+//     q3TraceWrite(file); // Chrome trace_event JSON, open in ui.perfetto.dev
+//
+// Without Q3_TRACE the zones expand to nothing and the functions are no-ops.
+
+#ifdef Q3_TRACE
+
+#include <atomic>
+
+#ifndef Q3_TRACE_BUFFER_SIZE
+#define Q3_TRACE_BUFFER_SIZE (1 << 16) // Events per thread, must be a power of two
+#endif
+
+struct q3TraceEvent {
+    const char* name; // Must be a string literal (or otherwise outlive the trace)
+    const char* arg_name;
+    i64 arg_value;
+    u64 start_ns;
+    u64 duration_ns;
+};
+
+// Single producer ring buffer owned by one thread. The owner publishes events
+// by bumping `head` with release semantics, readers acquire it. `head` is only
+// accessed through std::atomic_ref, so the buffer is plain data and can come
+// from Allocator::create.
+struct q3TraceBuffer {
+    q3TraceEvent* events;
+    u64 head;
+    u32 thread_id;
+    q3TraceBuffer* next; // Intrusive list of all buffers, see q3TraceWrite
+};
+
+u64 q3TraceNow();
+void q3TraceRecord(const q3TraceEvent& event);
+
+// Starts recording. Events recorded before the last q3TraceStart() are not
+// written out.
+void q3TraceStart();
+void q3TraceStop();
+bool q3TraceEnabled();
+
+// Writes every thread's recorded events as Chrome trace_event JSON. Call it
+// while no thread is recording (e.g. between steps), otherwise the oldest
+// events of a busy thread may be overwritten while being written.
+void q3TraceWrite(FILE* file);
+
+struct q3TraceZone {
+    q3TraceEvent event;
+    bool active;
+
+    q3TraceZone(const char* name, const char* arg_name = nullptr, i64 arg_value = 0) {
+        active = q3TraceEnabled();
+        if (!active) return;
+        event = {
+            .name = name,
+            .arg_name = arg_name,
+            .arg_value = arg_value,
+            .start_ns = q3TraceNow(),
+            .duration_ns = 0,
+        };
+    }
+
+    ~q3TraceZone() {
+        if (!active) return;
+        event.duration_ns = q3TraceNow() - event.start_ns;
+        q3TraceRecord(event);
+    }
+};
+
+#define Q3_TRACE_CONCAT_(a, b) a##b
+#define Q3_TRACE_CONCAT(a, b) Q3_TRACE_CONCAT_(a, b)
+
+// Records the enclosing scope as a zone, with an optional integer argument:
+// Q3_TRACE_ZONE("Solve") or Q3_TRACE_ZONE("Island", "bodies", count)
+#define Q3_TRACE_ZONE(...) q3TraceZone Q3_TRACE_CONCAT(q3_trace_zone_, __LINE__)(__VA_ARGS__)
+
+#else
+
+#define Q3_TRACE_ZONE(...)
+
+inline void q3TraceStart() {}
+inline void q3TraceStop() {}
+inline bool q3TraceEnabled() { return false; }
+inline void q3TraceWrite(FILE* file) { fprintf(file, "{\"traceEvents\":[]}\n"); }
+
+#endif // Q3_TRACE
@@ -29,6 +29,15 @@ distribution.
 #include "../dynamics/q3Contact.h"
 #include "../broadphase/q3BroadPhase.h"
 
+// Adds a call to the recording of the scene, if any
+static void q3RecordCommand(
+    q3Body* body, q3BodyCommand::Type type, const q3Vec3& a, const q3Vec3& b = q3Vec3(0, 0, 0),
+    r32 angle = r32(0.0)
+) {
+    q3Recorder* recorder = body->m_scene->recorder;
+    if (recorder) recorder->Command({.type = type, .body = body, .a = a, .b = b, .angle = angle});
+}
+
 q3Body::q3Body(const q3BodyDef& def, q3Scene* scene) {
     m_linearVelocity = def.linearVelocity;
     m_angularVelocity = def.angularVelocity;
@@ -61,6 +70,7 @@ q3Body::q3Body(const q3BodyDef& def, q3Scene* scene) {
 }
 
 const q3Box* q3Body::SetBox(const q3BoxDef& def) {
+    if (m_scene->recorder) m_scene->recorder->SetBox(this, def);
     q3AABB aabb;
     box.local = def.m_tx;
     box.e = def.m_e;
@@ -70,6 +80,9 @@ const q3Box* q3Body::SetBox(const q3BoxDef& def) {
     box.restitution = def.m_restitution;
     box.density = def.m_density;
     box.sensor = def.m_sensor;
+    box.categoryBits = def.m_categoryBits;
+    box.maskBits = def.m_maskBits;
+    box.groupIndex = def.m_groupIndex;
 
     CalculateMassData();
 
@@ -80,13 +93,13 @@ const q3Box* q3Body::SetBox(const q3BoxDef& def) {
 }
 
 void q3Body::RemoveBox() {
+    if (m_scene->recorder) m_scene->recorder->RemoveBox(this);
     // Remove all contacts associated with this shape
     // note: the `RemoveContact` frees a q3ContactConstraint which hold the
-    // edge pointed to in that iteration, so we can't use a normal for loop
-    q3ContactEdge* edge = contact_edge_list;
-    while (edge) {
-        q3ContactConstraint* contact = edge->constraint;
-        m_scene->contact_manager.RemoveContact(contact);
+    // edge pointed to in that iteration and unlinks it from our list, so we
+    // re-read the list head instead of following the freed edge
+    while (contact_edge_list) {
+        m_scene->contact_manager.RemoveContact(contact_edge_list->constraint);
     }
 
     m_scene->contact_manager.m_broadphase.RemoveBox(&box);
@@ -95,29 +108,35 @@ void q3Body::RemoveBox() {
 }
 
 void q3Body::RemoveAllBoxes() {
+    if (m_scene->recorder) m_scene->recorder->RemoveAllBoxes(this);
     m_scene->contact_manager.m_broadphase.RemoveBox(&box);
     m_scene->contact_manager.RemoveContactsFromBody(this);
 }
 
 void q3Body::ApplyLinearForce(const q3Vec3& force) {
+    q3RecordCommand(this, q3BodyCommand::eApplyLinearForce, force);
     m_force += force * m_mass;
 }
 
 void q3Body::ApplyForceAtWorldPoint(const q3Vec3& force, const q3Vec3& point) {
+    q3RecordCommand(this, q3BodyCommand::eApplyForceAtWorldPoint, force, point);
     m_force += force * m_mass;
     m_torque += q3Cross(point - m_worldCenter, force);
 }
 
 void q3Body::ApplyLinearImpulse(const q3Vec3& impulse) {
+    q3RecordCommand(this, q3BodyCommand::eApplyLinearImpulse, impulse);
     m_linearVelocity += impulse * m_invMass;
 }
 
 void q3Body::ApplyLinearImpulseAtWorldPoint(const q3Vec3& impulse, const q3Vec3& point) {
+    q3RecordCommand(this, q3BodyCommand::eApplyLinearImpulseAtWorldPoint, impulse, point);
     m_linearVelocity += impulse * m_invMass;
     m_angularVelocity += m_invInertiaWorld * q3Cross(point - m_worldCenter, impulse);
 }
 
 void q3Body::ApplyTorque(const q3Vec3& torque) {
+    q3RecordCommand(this, q3BodyCommand::eApplyTorque, torque);
     m_torque += torque;
 }
 
@@ -146,12 +165,14 @@ const q3Vec3 q3Body::GetVelocityAtWorldPoint(const q3Vec3& p) const {
 void q3Body::SetLinearVelocity(const q3Vec3& v) {
     // Velocity of static bodies cannot be adjusted
     debug::assert(!flags.Static);
+    q3RecordCommand(this, q3BodyCommand::eSetLinearVelocity, v);
     m_linearVelocity = v;
 }
 
 void q3Body::SetAngularVelocity(const q3Vec3 v) {
     // Velocity of static bodies cannot be adjusted
     debug::assert(!flags.Static);
+    q3RecordCommand(this, q3BodyCommand::eSetAngularVelocity, v);
     m_angularVelocity = v;
 }
 
@@ -165,11 +186,13 @@ bool q3Body::CanCollide(const q3Body* other) const {
 }
 
 void q3Body::SetTransform(const q3Vec3& position) {
+    q3RecordCommand(this, q3BodyCommand::eSetPosition, position);
     m_worldCenter = position;
     SynchronizeProxies();
 }
 
 void q3Body::SetTransform(const q3Vec3& position, const q3Vec3& axis, r32 angle) {
+    q3RecordCommand(this, q3BodyCommand::eSetTransform, position, axis, angle);
     m_worldCenter = position;
     m_q.Set(axis, angle);
     m_tx.rotation = m_q.ToMat3();
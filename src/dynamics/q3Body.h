@@ -80,6 +80,9 @@ struct q3Body {
     Flags flags;
 
     q3Box box;
+    // Unique within the scene, in creation order. Orders the contact pairs of
+    // a deterministic scene and is part of q3Scene::StateHash()
+    u32 id;
     q3Scene* m_scene;
     q3Body* m_next;
     q3Body* m_prev;
@@ -33,17 +33,6 @@ distribution.
 r32 q3MixRestitution(const q3Box* A, const q3Box* B);
 r32 q3MixFriction(const q3Box* A, const q3Box* B);
 
-union q3FeaturePair {
-    struct {
-        u8 inR;
-        u8 outR;
-        u8 inI;
-        u8 outI;
-    };
-
-    i32 key;
-};
-
 struct q3Contact {
     q3Vec3 position;       // World coordinate of contact
     r32 penetration;       // Depth of penetration from collision
@@ -74,6 +63,30 @@ struct q3Manifold {
 
 struct q3ContactConstraint; // what a mess
 
+enum q3EventType { eBeginEvent, ePersistEvent, eEndEvent };
+
+// Reported when a sensor box starts or stops overlapping another box. Events
+// are appended to a buffer during q3Scene::Step, see q3Scene::SensorEvents.
+struct q3SensorEvent {
+    q3EventType type;
+    q3Box* sensor;
+    q3Box* other;
+};
+
+// Reported when two solid boxes start touching, keep touching or stop touching.
+// Events are appended to a buffer during q3Scene::Step after the solver ran, so
+// the impulses are the ones applied during that step. See q3Scene::ContactEvents.
+struct q3ContactEvent {
+    q3EventType type;
+    q3Box* A;
+    q3Box* B;
+    q3Vec3 normal;     // From A to B
+    q3Vec3 point;      // Average of the manifold's contact points
+    r32 normalImpulse; // Sum of the accumulated normal impulses
+    r32 penetration;   // Deepest penetration of the manifold
+    i32 contactCount;  // Zero for end events
+};
+
 struct q3ContactEdge {
     q3Body* other;
     q3ContactConstraint* constraint;
@@ -102,12 +115,7 @@ struct q3ContactConstraint {
     void SolveCollision() {
         manifold.contactCount = 0;
         q3BoxtoBox(&manifold, A, B);
-        if (manifold.contactCount > 0) {
-            if (flags.Colliding) flags.WasColliding = true;
-            flags.Colliding = true;
-        } else {
-            flags.WasColliding = flags.Colliding;
-            flags.Colliding = false;
-        }
+        flags.WasColliding = flags.Colliding;
+        flags.Colliding = manifold.contactCount > 0;
     }
 };
@@ -23,9 +23,14 @@ not be misrepresented as being the original software.
 distribution.
 */
 
+#include <algorithm>
+
 #include "../collision/q3Box.h"
+#include "../common/q3Jobs.h"
 #include "../debug/q3Render.h"
+#include "../debug/q3Trace.h"
 #include "../scene/q3Scene.h"
+#include "../scene/q3StaticWorld.h"
 #include "../math/q3Math.h"
 #include "q3Body.h"
 #include "q3Contact.h"
@@ -33,7 +38,28 @@ distribution.
 
 q3ContactManager::q3ContactManager(Allocator allocator) :
     contacts(LinkedList<q3ContactConstraint>::init(allocator)),
-    m_broadphase(allocator) {}
+    m_broadphase(allocator),
+    sensor_events(ArrayList<q3SensorEvent>::init(allocator)),
+    contact_events(ArrayList<q3ContactEvent>::init(allocator)),
+    narrowphase(ArrayList<q3ContactConstraint*>::init(allocator)),
+    static_world(nullptr),
+    static_body(nullptr),
+    static_proxies(ArrayList<q3Box*>::init(allocator)),
+    static_chunk_pairs(ArrayList<ArrayList<q3ContactPair>>::init(allocator)),
+    static_pairs(ArrayList<q3ContactPair>::init(allocator)) {}
+
+q3ContactManager::~q3ContactManager() {
+    sensor_events.deinit();
+    contact_events.deinit();
+    narrowphase.deinit();
+    for (q3Box* proxy : static_proxies.items) {
+        if (proxy) contacts.allocator.destroy(proxy);
+    }
+    static_proxies.deinit();
+    for (ArrayList<q3ContactPair>& chunk : static_chunk_pairs.items) chunk.deinit();
+    static_chunk_pairs.deinit();
+    static_pairs.deinit();
+}
 
 void q3ContactManager::AddContact(q3Box* A, q3Box* B) {
     q3Body* bodyA = A->body;
@@ -74,12 +100,123 @@ void q3ContactManager::AddContact(q3Box* A, q3Box* B) {
     bodyB->linkEdgeIntoList(&contact->edgeB);
 }
 
-void q3ContactManager::FindNewContacts() {
-    m_broadphase.UpdatePairs(this);
-    // queue manifolds for solving
-    for (auto pair : m_broadphase.pairs.items) {
-        AddContact(m_broadphase.GetBoxInfo(pair.A).box, m_broadphase.GetBoxInfo(pair.B).box);
+void q3ContactManager::FindNewContacts(q3JobInterface* jobs, bool deterministic) {
+    Q3_TRACE_ZONE("FindNewContacts");
+    m_broadphase.UpdatePairs(this, jobs);
+    if (deterministic) {
+        m_broadphase.SortPairs();
+        // Contacts are prepended, so walking backwards leaves them sorted
+        Slice<q3ContactPair> pairs = m_broadphase.pairs.items;
+        for (usize i = pairs.len; i > 0; --i) {
+            q3ContactPair pair = pairs[i - 1];
+            AddContact(m_broadphase.GetBoxInfo(pair.A).box, m_broadphase.GetBoxInfo(pair.B).box);
+        }
+    } else {
+        // queue manifolds for solving
+        for (auto pair : m_broadphase.pairs.items) {
+            AddContact(m_broadphase.GetBoxInfo(pair.A).box, m_broadphase.GetBoxInfo(pair.B).box);
+        }
+    }
+    FindStaticContacts(jobs, deterministic);
+}
+
+void q3ContactManager::FindStaticContacts(q3JobInterface* jobs, bool deterministic) {
+    if (static_world == nullptr) return;
+    Q3_TRACE_ZONE("FindStaticContacts");
+
+    const u32 k_grain = 32;
+    u32 count = intCast<u32>(m_broadphase.boxes.items.len);
+    usize chunk_count = (count + k_grain - 1) / k_grain;
+    while (static_chunk_pairs.items.len < chunk_count) {
+        static_chunk_pairs.append(ArrayList<q3ContactPair>::init(static_pairs.allocator)).unwrap();
+    }
+
+    q3ParallelFor(jobs, count, k_grain, [this](u32 begin, u32 end, u32 worker) {
+        ArrayList<q3ContactPair>* out = &static_chunk_pairs.items[begin / k_grain];
+        out->shrinkRetainingCapacity(0);
+
+        for (u32 i = begin; i < end; ++i) {
+            const BoxInfo& info = m_broadphase.boxes.items[i];
+            // Only dynamic bodies collide with static ones
+            if (info.box == nullptr || !info.box->body->flags.Dynamic) continue;
+            static_world->QueryAABB(info.aabb, [this, &info, out, i](u32 index) {
+                if (q3ShouldCollide(info.box, static_world->boxes[index])) {
+                    out->append({.A = i32(i), .B = i32(index)}).unwrap();
+                }
+                return true;
+            });
+        }
+    });
+
+    static_pairs.shrinkRetainingCapacity(0);
+    for (usize i = 0; i < chunk_count; ++i) {
+        Slice<q3ContactPair> chunk = static_chunk_pairs.items[i].items;
+        if (chunk.len > 0) static_pairs.appendSlice(chunk).unwrap();
+    }
+
+    if (deterministic) {
+        // Body id, then static box index, like q3BroadPhase::SortPairs
+        auto key = [this](const q3ContactPair& pair) {
+            u64 id = m_broadphase.boxes.items[pair.A].box->body->id;
+            return (id << 32) | u64(pair.B);
+        };
+        std::sort(
+            static_pairs.items.ptr, static_pairs.items.ptr + static_pairs.items.len,
+            [&key](const q3ContactPair& a, const q3ContactPair& b) { return key(a) < key(b); }
+        );
+        for (usize i = static_pairs.items.len; i > 0; --i) {
+            q3ContactPair pair = static_pairs.items[i - 1];
+            AddContact(m_broadphase.GetBoxInfo(pair.A).box, StaticProxy(u32(pair.B)));
+        }
+        return;
+    }
+
+    for (q3ContactPair pair : static_pairs.items) {
+        AddContact(m_broadphase.GetBoxInfo(pair.A).box, StaticProxy(u32(pair.B)));
+    }
+}
+
+void q3ContactManager::SetStaticWorld(const q3StaticWorld* world, q3Body* body) {
+    RemoveContactsFromBody(body);
+    for (q3Box* proxy : static_proxies.items) {
+        if (proxy) contacts.allocator.destroy(proxy);
     }
+
+    static_world = world;
+    static_body = body;
+    static_proxies.resize(world ? world->box_count : 0).unwrap();
+    for (q3Box*& proxy : static_proxies.items) proxy = nullptr;
+}
+
+q3Box* q3ContactManager::StaticProxy(u32 index) {
+    q3Box* proxy = static_proxies.items[index];
+    if (proxy) return proxy;
+
+    const q3StaticBox& box = static_world->boxes[index];
+    proxy = contacts.allocator.create<q3Box>().unwrap();
+    proxy->local = box.GetTransform();
+    proxy->e = box.GetExtent();
+    proxy->body = static_body;
+    proxy->friction = box.friction;
+    proxy->restitution = box.restitution;
+    proxy->density = r32(0.0);
+    proxy->broadPhaseIndex = -1 - i32(index);
+    proxy->sensor = box.sensor;
+    proxy->categoryBits = box.categoryBits;
+    proxy->maskBits = box.maskBits;
+    proxy->groupIndex = box.groupIndex;
+    static_proxies.items[index] = proxy;
+    return proxy;
+}
+
+bool q3ContactManager::TestOverlap(const q3Box* A, const q3Box* B) {
+    // Static proxies are always B, see FindStaticContacts
+    debug::assert(A->broadPhaseIndex >= 0);
+    if (B->broadPhaseIndex < 0) {
+        const q3StaticBox& box = static_world->boxes[-1 - B->broadPhaseIndex];
+        return q3AABBtoAABB(m_broadphase.GetBoxInfo(A->broadPhaseIndex).aabb, box.GetAABB());
+    }
+    return m_broadphase.TestOverlap(A->broadPhaseIndex, B->broadPhaseIndex);
 }
 
 void q3ContactManager::RemoveContact(q3ContactConstraint* contact) {
@@ -103,11 +240,93 @@ void q3ContactManager::RemoveContactsFromBody(q3Body* body) {
     }
 }
 
+void q3ContactManager::RemoveAllContacts() {
+    for (q3ContactConstraint* contact : contacts.ptrIter()) {
+        contact->bodyA->contact_edge_list = nullptr;
+        contact->bodyB->contact_edge_list = nullptr;
+    }
+
+    Allocator allocator = contacts.allocator;
+    contacts.deinit();
+    contacts = LinkedList<q3ContactConstraint>::init(allocator);
+}
+
 void q3ContactManager::RemoveFromBroadphase(q3Body* body) {
     m_broadphase.RemoveBox(&body->box);
 }
 
-void q3ContactManager::TestCollisions(void) {
+void q3ContactManager::PushSensorEvent(q3EventType type, const q3ContactConstraint* constraint) {
+    bool a_is_sensor = constraint->A->sensor;
+    sensor_events
+        .append({
+            .type = type,
+            .sensor = a_is_sensor ? constraint->A : constraint->B,
+            .other = a_is_sensor ? constraint->B : constraint->A,
+        })
+        .unwrap();
+}
+
+void q3ContactManager::TestSensor(q3ContactConstraint* constraint) {
+    constraint->manifold.contactCount = 0;
+    constraint->flags.WasColliding = constraint->flags.Colliding;
+    constraint->flags.Colliding = q3BoxOverlap(constraint->A, constraint->B);
+
+    if (constraint->flags.Colliding && !constraint->flags.WasColliding) {
+        PushSensorEvent(eBeginEvent, constraint);
+    } else if (!constraint->flags.Colliding && constraint->flags.WasColliding) {
+        PushSensorEvent(eEndEvent, constraint);
+    }
+}
+
+void q3ContactManager::PushContactEvent(q3EventType type, const q3ContactConstraint* constraint) {
+    const q3Manifold* m = &constraint->manifold;
+    q3ContactEvent event = {
+        .type = type,
+        .A = constraint->A,
+        .B = constraint->B,
+        .normal = m->normal,
+        .point = q3Vec3(r32(0.0), r32(0.0), r32(0.0)),
+        .normalImpulse = r32(0.0),
+        .penetration = r32(0.0),
+        .contactCount = type == eEndEvent ? 0 : m->contactCount,
+    };
+
+    for (i32 i = 0; i < event.contactCount; ++i) {
+        const q3Contact* c = m->contacts + i;
+        event.point += c->position;
+        event.normalImpulse += c->normalImpulse;
+        event.penetration = q3Min(event.penetration, c->penetration);
+    }
+    if (event.contactCount > 0) event.point /= r32(event.contactCount);
+
+    contact_events.append(event).unwrap();
+}
+
+void q3ContactManager::ReportContactEvents(bool report_persist) {
+    Q3_TRACE_ZONE("ReportContactEvents");
+    for (q3ContactConstraint* constraint : contacts.ptrIter()) {
+        if (constraint->manifold.sensor) continue;
+
+        bool colliding = constraint->flags.Colliding;
+        bool was_colliding = constraint->flags.WasColliding;
+        if (colliding && !was_colliding) {
+            PushContactEvent(eBeginEvent, constraint);
+        } else if (colliding && was_colliding) {
+            if (report_persist) PushContactEvent(ePersistEvent, constraint);
+        } else if (!colliding && was_colliding) {
+            PushContactEvent(eEndEvent, constraint);
+        }
+    }
+}
+
+void q3ContactManager::TestCollisions(q3JobInterface* jobs) {
+    Q3_TRACE_ZONE("TestCollisions", "contacts", i64(contacts.len));
+    sensor_events.shrinkRetainingCapacity(0);
+    contact_events.shrinkRetainingCapacity(0);
+    narrowphase.shrinkRetainingCapacity(0);
+
+    // Contacts are removed and events pushed serially, the manifolds of the
+    // remaining solid contacts are updated afterwards
     auto opt_node = contacts.head;
     while (opt_node.is_not_null()) {
         auto opt_next = opt_node.unwrap()->next;
@@ -120,43 +339,69 @@ void q3ContactManager::TestCollisions(void) {
 
         constraint->flags.Island = false;
 
-        if (!bodyA->CanCollide(bodyB)) {
+        // Filter data may have been changed since the contact was created
+        if (!bodyA->CanCollide(bodyB) || !q3ShouldCollide(A, B)) {
+            if (constraint->flags.Colliding) {
+                if (constraint->manifold.sensor) PushSensorEvent(eEndEvent, constraint);
+                else PushContactEvent(eEndEvent, constraint);
+            }
             RemoveContact(constraint);
             opt_node = opt_next;
             continue;
         }
 
         // Check if contact should persist
-        if (!m_broadphase.TestOverlap(A->broadPhaseIndex, B->broadPhaseIndex)) {
+        if (!TestOverlap(A, B)) {
+            if (constraint->flags.Colliding) {
+                if (constraint->manifold.sensor) PushSensorEvent(eEndEvent, constraint);
+                else PushContactEvent(eEndEvent, constraint);
+            }
             RemoveContact(constraint);
             opt_node = opt_next;
             continue;
         }
-        q3Manifold* manifold = &constraint->manifold;
-        q3Manifold oldManifold = constraint->manifold;
-        q3Vec3 ot0 = oldManifold.tangentVectors[0];
-        q3Vec3 ot1 = oldManifold.tangentVectors[1];
-        constraint->SolveCollision();
-        q3ComputeBasis(manifold->normal, manifold->tangentVectors, manifold->tangentVectors + 1);
-
-        for (i32 i = 0; i < manifold->contactCount; ++i) {
-            q3Contact* c = manifold->contacts + i;
-            c->tangentImpulse[0] = c->tangentImpulse[1] = c->normalImpulse = r32(0.0);
-
-            for (i32 j = 0; j < oldManifold.contactCount; ++j) {
-                q3Contact* oc = oldManifold.contacts + j;
-                if (c->fp.key == oc->fp.key) {
-                    c->normalImpulse = oc->normalImpulse;
-
-                    // Attempt to re-project old friction solutions
-                    q3Vec3 friction = ot0 * oc->tangentImpulse[0] + ot1 * oc->tangentImpulse[1];
-                    c->tangentImpulse[0] = q3Dot(friction, manifold->tangentVectors[0]);
-                    c->tangentImpulse[1] = q3Dot(friction, manifold->tangentVectors[1]);
-                    break;
-                }
-            }
+
+        if (constraint->manifold.sensor) {
+            TestSensor(constraint);
+            opt_node = opt_next;
+            continue;
         }
 
+        narrowphase.append(constraint).unwrap();
         opt_node = opt_next;
     }
+
+    const u32 k_grain = 64;
+    u32 count = intCast<u32>(narrowphase.items.len);
+    q3ParallelFor(jobs, count, k_grain, [this](u32 begin, u32 end, u32 worker) {
+        Q3_TRACE_ZONE("UpdateManifolds", "contacts", i64(end - begin));
+        for (u32 i = begin; i < end; ++i) UpdateManifold(narrowphase.items[i]);
+    });
+}
+
+void q3ContactManager::UpdateManifold(q3ContactConstraint* constraint) {
+    q3Manifold* manifold = &constraint->manifold;
+    q3Manifold oldManifold = constraint->manifold;
+    q3Vec3 ot0 = oldManifold.tangentVectors[0];
+    q3Vec3 ot1 = oldManifold.tangentVectors[1];
+    constraint->SolveCollision();
+    q3ComputeBasis(manifold->normal, manifold->tangentVectors, manifold->tangentVectors + 1);
+
+    for (i32 i = 0; i < manifold->contactCount; ++i) {
+        q3Contact* c = manifold->contacts + i;
+        c->tangentImpulse[0] = c->tangentImpulse[1] = c->normalImpulse = r32(0.0);
+
+        for (i32 j = 0; j < oldManifold.contactCount; ++j) {
+            q3Contact* oc = oldManifold.contacts + j;
+            if (c->fp.key == oc->fp.key) {
+                c->normalImpulse = oc->normalImpulse;
+
+                // Attempt to re-project old friction solutions
+                q3Vec3 friction = ot0 * oc->tangentImpulse[0] + ot1 * oc->tangentImpulse[1];
+                c->tangentImpulse[0] = q3Dot(friction, manifold->tangentVectors[0]);
+                c->tangentImpulse[1] = q3Dot(friction, manifold->tangentVectors[1]);
+                break;
+            }
+        }
+    }
 }
@@ -31,26 +31,80 @@ distribution.
 
 struct q3ContactManager {
     q3ContactManager(Allocator allocator);
+    ~q3ContactManager();
 
     // Add a new contact constraint for a pair of objects
     // unless the contact constraint already exists
     void AddContact(q3Box* A, q3Box* B);
 
     // Has broadphase find all contacts and call AddContact on the
-    // ContactManager for each pair found
-    void FindNewContacts(void);
+    // ContactManager for each pair found. When deterministic the pairs are
+    // sorted by body id first and new contacts end up in that order at the
+    // head of `contacts`, independent of the broadphase proxy layout.
+    void FindNewContacts(q3JobInterface* jobs, bool deterministic);
+
+    // Queries the static world BVH with the fat AABB of every dynamic box
+    // and adds the contacts, in parallel on jobs when not null. Called by
+    // FindNewContacts, static pairs are ordered the same way.
+    void FindStaticContacts(q3JobInterface* jobs, bool deterministic);
+
+    // Drops every contact with the current static world and switches to
+    // world (null detaches it). body stands in for all static world boxes.
+    void SetStaticWorld(const q3StaticWorld* world, q3Body* body);
+
+    // The q3Box of static world box `index`, created on first use
+    q3Box* StaticProxy(u32 index);
+
+    // Fat AABB overlap of the boxes of a contact, also for static proxies
+    bool TestOverlap(const q3Box* A, const q3Box* B);
 
     // Remove a specific contact
     void RemoveContact(q3ContactConstraint* contact);
 
     // Remove all contacts from a body
     void RemoveContactsFromBody(q3Body* body);
+
+    // Drops every contact in a single pass, without unlinking each one from
+    // its bodies' edge lists. Used when the whole scene is torn down.
+    void RemoveAllContacts(void);
     void RemoveFromBroadphase(q3Body* body);
 
     // Remove contacts without broadphase overlap
-    // Solves contact manifolds
-    void TestCollisions(void);
+    // Solves contact manifolds, in parallel on jobs when not null
+    void TestCollisions(q3JobInterface* jobs);
+
+    // Recomputes the manifold of a solid contact and carries over the
+    // impulses of matching contact points for warm starting. Only touches the
+    // constraint, so contacts can be updated in parallel.
+    void UpdateManifold(q3ContactConstraint* constraint);
+
+    // Sensor contacts only need a boolean overlap test, they never produce a
+    // manifold. Begin/end transitions are appended to `sensor_events`.
+    void TestSensor(q3ContactConstraint* constraint);
+    void PushSensorEvent(q3EventType type, const q3ContactConstraint* constraint);
+
+    // Appends begin/end (and optionally persist) events for all solid contacts
+    // to `contact_events`. Called once per step after the islands were solved.
+    void ReportContactEvents(bool report_persist);
+    void PushContactEvent(q3EventType type, const q3ContactConstraint* constraint);
 
     LinkedList<q3ContactConstraint> contacts;
     q3BroadPhase m_broadphase;
+    // Cleared at the start of every TestCollisions call
+    ArrayList<q3SensorEvent> sensor_events;
+    ArrayList<q3ContactEvent> contact_events;
+    // Solid contacts whose manifold TestCollisions updates, kept between steps
+    ArrayList<q3ContactConstraint*> narrowphase;
+
+    const q3StaticWorld* static_world;
+    // Static body of every static world box, owned by the scene and never in
+    // q3Scene::bodies
+    q3Body* static_body;
+    // Boxes of the static world boxes touched so far, null for the others.
+    // They are not in the broadphase: broadPhaseIndex is -1 - static index.
+    ArrayList<q3Box*> static_proxies;
+    // Pairs of broadphase index (A) and static box index (B), per chunk of
+    // the parallel query and then concatenated, kept between steps
+    ArrayList<ArrayList<q3ContactPair>> static_chunk_pairs;
+    ArrayList<q3ContactPair> static_pairs;
 };
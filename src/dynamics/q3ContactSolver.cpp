@@ -25,6 +25,7 @@ distribution.
 
 #include "../common/q3Geometry.h"
 #include "../common/q3Settings.h"
+#include "../debug/q3Trace.h"
 #include "q3Body.h"
 #include "q3Contact.h"
 #include "q3ContactSolver.h"
@@ -35,6 +36,7 @@ void q3ContactSolver::Initialize(q3Island* island) {
     m_contactCount = island->contacts.items.len;
     m_contacts = island->contact_states.items.ptr;
     m_velocities = m_island->velocities.items.ptr;
+    m_deltas = m_island->deltas.items.ptr;
     m_enableFriction = island->enable_friction;
 }
 
@@ -53,7 +55,28 @@ void q3ContactSolver::ShutDown(void) {
     }
 }
 
+// Precalculate JM^-1JT for contact and friction constraints
+static void q3ComputeMasses(const q3ContactConstraintState* cs, q3ContactState* c) {
+    q3Vec3 raCn = q3Cross(c->ra, cs->normal);
+    q3Vec3 rbCn = q3Cross(c->rb, cs->normal);
+    r32 nm = cs->mA + cs->mB;
+    r32 tm[2];
+    tm[0] = nm;
+    tm[1] = nm;
+
+    nm += q3Dot(raCn, cs->iA * raCn) + q3Dot(rbCn, cs->iB * rbCn);
+    c->normalMass = q3Invert(nm);
+
+    for (i32 i = 0; i < 2; ++i) {
+        q3Vec3 raCt = q3Cross(cs->tangentVectors[i], c->ra);
+        q3Vec3 rbCt = q3Cross(cs->tangentVectors[i], c->rb);
+        tm[i] += q3Dot(raCt, cs->iA * raCt) + q3Dot(rbCt, cs->iB * rbCt);
+        c->tangentMass[i] = q3Invert(tm[i]);
+    }
+}
+
 void q3ContactSolver::PreSolve(r32 dt) {
+    Q3_TRACE_ZONE("PreSolve");
     for (i32 i = 0; i < m_contactCount; ++i) {
         q3ContactConstraintState* cs = m_contacts + i;
 
@@ -64,29 +87,16 @@ void q3ContactSolver::PreSolve(r32 dt) {
 
         for (i32 j = 0; j < cs->contactCount; ++j) {
             q3ContactState* c = cs->contacts + j;
-
-            // Precalculate JM^-1JT for contact and friction constraints
-            q3Vec3 raCn = q3Cross(c->ra, cs->normal);
-            q3Vec3 rbCn = q3Cross(c->rb, cs->normal);
-            r32 nm = cs->mA + cs->mB;
-            r32 tm[2];
-            tm[0] = nm;
-            tm[1] = nm;
-
-            nm += q3Dot(raCn, cs->iA * raCn) + q3Dot(rbCn, cs->iB * rbCn);
-            c->normalMass = q3Invert(nm);
-
-            for (i32 i = 0; i < 2; ++i) {
-                q3Vec3 raCt = q3Cross(cs->tangentVectors[i], c->ra);
-                q3Vec3 rbCt = q3Cross(cs->tangentVectors[i], c->rb);
-                tm[i] += q3Dot(raCt, cs->iA * raCt) + q3Dot(rbCt, cs->iB * rbCt);
-                c->tangentMass[i] = q3Invert(tm[i]);
+            q3ComputeMasses(cs, c);
+
+            // Precalculate bias factor, unless the position iterations push out
+            if (m_island->position_iterations) {
+                c->bias = r32(0.0);
+            } else {
+                c->bias = -Q3_BAUMGARTE * (r32(1.0) / dt) *
+                          q3Min(r32(0.0), c->penetration + Q3_PENETRATION_SLOP);
             }
 
-            // Precalculate bias factor
-            c->bias = -Q3_BAUMGARTE * (r32(1.0) / dt) *
-                      q3Min(r32(0.0), c->penetration + Q3_PENETRATION_SLOP);
-
             // Warm start contact
             q3Vec3 P = cs->normal * c->normalImpulse;
 
@@ -183,3 +193,189 @@ void q3ContactSolver::Solve() {
         m_velocities[cs->indexB].w = wB;
     }
 }
+
+// Moves a body by a position correction and updates its delta to match
+static void q3ApplyCorrection(
+    q3Body* body, q3BodyDelta* delta, const q3Vec3& linear, const q3Vec3& angular
+) {
+    body->m_worldCenter += linear;
+    delta->dp += linear;
+    body->m_q.Integrate(angular, r32(1.0));
+    delta->dR = body->m_q.ToMat3() * q3Transpose(body->m_tx.rotation);
+}
+
+// Nonlinear Gauss-Seidel on the contact separations (as in Box2D's position
+// solver): the separation of every point is updated from the motion of its
+// bodies since the narrowphase and a fraction of the remaining penetration
+// is removed by moving the bodies, without touching their velocities.
+bool q3ContactSolver::SolvePositions() {
+    r32 minSeparation = r32(0.0);
+
+    for (i32 i = 0; i < m_contactCount; ++i) {
+        q3ContactConstraintState* cs = m_contacts + i;
+        q3Body* bodyA = m_island->bodies.items[cs->indexA];
+        q3Body* bodyB = m_island->bodies.items[cs->indexB];
+        q3BodyDelta* dA = m_deltas + cs->indexA;
+        q3BodyDelta* dB = m_deltas + cs->indexB;
+
+        for (i32 j = 0; j < cs->contactCount; ++j) {
+            q3ContactState* c = cs->contacts + j;
+
+            q3Vec3 ra = dA->dR * c->ra;
+            q3Vec3 rb = dB->dR * c->rb;
+            q3Vec3 d = dB->dp - dA->dp + (rb - c->rb) - (ra - c->ra);
+            r32 separation = c->penetration + q3Dot(d, cs->normal);
+            minSeparation = q3Min(minSeparation, separation);
+
+            // The normal mass of the velocity solve, close enough for the
+            // small rotations of one step
+            r32 C = q3Clamp(
+                -Q3_MAX_LINEAR_CORRECTION, r32(0.0),
+                Q3_BAUMGARTE * (separation + Q3_PENETRATION_SLOP)
+            );
+            if (C == r32(0.0)) continue;
+            q3Vec3 P = cs->normal * (-c->normalMass * C);
+
+            if (bodyA->flags.Dynamic) {
+                q3ApplyCorrection(bodyA, dA, -P * cs->mA, -(cs->iA * q3Cross(ra, P)));
+            }
+            if (bodyB->flags.Dynamic) {
+                q3ApplyCorrection(bodyB, dB, P * cs->mB, cs->iB * q3Cross(rb, P));
+            }
+        }
+    }
+
+    return minSeparation >= r32(-3.0) * Q3_PENETRATION_SLOP;
+}
+
+void q3ContactSolver::PrepareSubsteps() {
+    Q3_TRACE_ZONE("PrepareSubsteps");
+    for (i32 i = 0; i < m_contactCount; ++i) {
+        q3ContactConstraintState* cs = m_contacts + i;
+
+        q3Vec3 vA = m_velocities[cs->indexA].v;
+        q3Vec3 wA = m_velocities[cs->indexA].w;
+        q3Vec3 vB = m_velocities[cs->indexB].v;
+        q3Vec3 wB = m_velocities[cs->indexB].w;
+
+        for (i32 j = 0; j < cs->contactCount; ++j) {
+            q3ContactState* c = cs->contacts + j;
+            q3ComputeMasses(cs, c);
+
+            // Restitution bias from the approach velocity, the position bias
+            // is computed by every iteration from the current separation
+            r32 dv = q3Dot(vB + q3Cross(wB, c->rb) - vA - q3Cross(wA, c->ra), cs->normal);
+            c->bias = dv < -r32(1.0) ? -(cs->restitution) * dv : r32(0.0);
+        }
+    }
+}
+
+void q3ContactSolver::WarmStart() {
+    for (i32 i = 0; i < m_contactCount; ++i) {
+        q3ContactConstraintState* cs = m_contacts + i;
+
+        q3Vec3 vA = m_velocities[cs->indexA].v;
+        q3Vec3 wA = m_velocities[cs->indexA].w;
+        q3Vec3 vB = m_velocities[cs->indexB].v;
+        q3Vec3 wB = m_velocities[cs->indexB].w;
+
+        for (i32 j = 0; j < cs->contactCount; ++j) {
+            q3ContactState* c = cs->contacts + j;
+            q3Vec3 P = cs->normal * c->normalImpulse;
+
+            if (m_enableFriction) {
+                P += cs->tangentVectors[0] * c->tangentImpulse[0];
+                P += cs->tangentVectors[1] * c->tangentImpulse[1];
+            }
+
+            vA -= P * cs->mA;
+            wA -= cs->iA * q3Cross(c->ra, P);
+
+            vB += P * cs->mB;
+            wB += cs->iB * q3Cross(c->rb, P);
+        }
+
+        m_velocities[cs->indexA].v = vA;
+        m_velocities[cs->indexA].w = wA;
+        m_velocities[cs->indexB].v = vB;
+        m_velocities[cs->indexB].w = wB;
+    }
+}
+
+void q3ContactSolver::SolveSubstep(r32 h, bool use_bias) {
+    r32 inv_h = r32(1.0) / h;
+
+    for (i32 i = 0; i < m_contactCount; ++i) {
+        q3ContactConstraintState* cs = m_contacts + i;
+        const q3BodyDelta* dA = m_deltas + cs->indexA;
+        const q3BodyDelta* dB = m_deltas + cs->indexB;
+        q3Vec3 dp = dB->dp - dA->dp;
+
+        q3Vec3 vA = m_velocities[cs->indexA].v;
+        q3Vec3 wA = m_velocities[cs->indexA].w;
+        q3Vec3 vB = m_velocities[cs->indexB].v;
+        q3Vec3 wB = m_velocities[cs->indexB].w;
+
+        for (i32 j = 0; j < cs->contactCount; ++j) {
+            q3ContactState* c = cs->contacts + j;
+
+            // Normal
+            {
+                // Separation of the contact points moved with their bodies
+                q3Vec3 d = dp + (dB->dR * c->rb - c->rb) - (dA->dR * c->ra - c->ra);
+                r32 separation = c->penetration + q3Dot(d, cs->normal);
+
+                // Apart: let the bodies close the gap within this substep.
+                // Overlapping: push out, unless relaxing.
+                r32 bias = c->bias;
+                if (separation > r32(0.0)) {
+                    bias -= separation * inv_h;
+                } else if (use_bias) {
+                    r32 penetration = q3Min(r32(0.0), separation + Q3_PENETRATION_SLOP);
+                    bias -= Q3_BAUMGARTE * inv_h * penetration;
+                }
+
+                q3Vec3 dv = vB + q3Cross(wB, c->rb) - vA - q3Cross(wA, c->ra);
+                r32 vn = q3Dot(dv, cs->normal);
+                r32 lambda = c->normalMass * (-vn + bias);
+
+                r32 tempPN = c->normalImpulse;
+                c->normalImpulse = q3Max(tempPN + lambda, r32(0.0));
+                lambda = c->normalImpulse - tempPN;
+
+                q3Vec3 impulse = cs->normal * lambda;
+                vA -= impulse * cs->mA;
+                wA -= cs->iA * q3Cross(c->ra, impulse);
+
+                vB += impulse * cs->mB;
+                wB += cs->iB * q3Cross(c->rb, impulse);
+            }
+
+            // Friction, bounded by the normal impulse just solved
+            q3Vec3 dv = vB + q3Cross(wB, c->rb) - vA - q3Cross(wA, c->ra);
+
+            if (m_enableFriction) {
+                for (i32 i = 0; i < 2; ++i) {
+                    r32 lambda = -q3Dot(dv, cs->tangentVectors[i]) * c->tangentMass[i];
+                    r32 maxLambda = cs->friction * c->normalImpulse;
+
+                    r32 oldPT = c->tangentImpulse[i];
+                    c->tangentImpulse[i] = q3Clamp(-maxLambda, maxLambda, oldPT + lambda);
+                    lambda = c->tangentImpulse[i] - oldPT;
+
+                    q3Vec3 impulse = cs->tangentVectors[i] * lambda;
+                    vA -= impulse * cs->mA;
+                    wA -= cs->iA * q3Cross(c->ra, impulse);
+
+                    vB += impulse * cs->mB;
+                    wB += cs->iB * q3Cross(c->rb, impulse);
+                }
+            }
+        }
+
+        m_velocities[cs->indexA].v = vA;
+        m_velocities[cs->indexA].w = wA;
+        m_velocities[cs->indexB].v = vB;
+        m_velocities[cs->indexB].w = wB;
+    }
+}
@@ -35,7 +35,8 @@ struct q3ContactState {
     r32 penetration;       // Depth of penetration from collision
     r32 normalImpulse;     // Accumulated normal impulse
     r32 tangentImpulse[2]; // Accumulated friction impulse
-    r32 bias;              // Restitution + baumgarte
+    r32 bias;              // Restitution + baumgarte, only restitution when sub-stepping or with
+                           // position iterations
     r32 normalMass;        // Normal constraint mass
     r32 tangentMass[2];    // Tangent constraint mass
 };
@@ -63,11 +64,23 @@ struct q3ContactSolver {
 
     void PreSolve(r32 dt);
     void Solve(void);
+    // One position iteration (split impulse), after the positions are
+    // integrated. Returns true once no contact penetrates beyond the slop.
+    bool SolvePositions();
+
+    // Sub-stepping (see q3Island::SolveSubsteps): the masses and restitution
+    // are prepared once, the warm start is applied at the start of every
+    // substep and the position bias comes from the separation updated by the
+    // motion of the bodies since the start of the step
+    void PrepareSubsteps();
+    void WarmStart();
+    void SolveSubstep(r32 h, bool use_bias);
 
     q3Island* m_island;
     q3ContactConstraintState* m_contacts;
     i32 m_contactCount;
     q3VelocityState* m_velocities;
+    q3BodyDelta* m_deltas; // Sub-stepping and position iterations only
 
     bool m_enableFriction;
 };
@@ -24,71 +24,216 @@ distribution.
 */
 
 #include "../broadphase/q3BroadPhase.h"
+#include "../common/q3Jobs.h"
 #include "../common/q3Settings.h"
+#include "../debug/q3Trace.h"
 #include "q3Body.h"
 #include "q3Contact.h"
 #include "q3ContactSolver.h"
 #include "q3Island.h"
 
 void q3Island::Solve() {
+    if (substeps > 1) {
+        SolveSubsteps();
+        return;
+    }
+
+    Q3_TRACE_ZONE("SolveIsland", "bodies", i64(bodies.items.len));
+    Q3_STATS(q3StatsTimer timer);
+
+    // Bodies per chunk of the parallel loops
+    const u32 k_grain = 256;
+    u32 body_count = intCast<u32>(bodies.items.len);
+
     // Apply gravity
     // Integrate velocities and create state buffers, calculate world inertia
-    for (auto [body, i] : bodies.items.iter()) {
-        q3VelocityState* v = &velocities.items[i];
-
-        if (body->flags.Dynamic) {
-            body->ApplyLinearForce(gravity * body->m_gravityScale);
-
-            // Calculate world space inertia tensor
-            q3Mat3 r = body->m_tx.rotation;
-            body->m_invInertiaWorld = r * body->m_invInertiaModel * q3Transpose(r);
-
-            // Integrate velocity
-            body->m_linearVelocity += (body->m_force * body->m_invMass) * dt;
-            body->m_angularVelocity += (body->m_invInertiaWorld * body->m_torque) * dt;
-
-            // From Box2D!
-            // Apply damping.
-            // ODE: dv/dt + c * v = 0
-            // Solution: v(t) = v0 * exp(-c * t)
-            // Time step: v(t + dt) = v0 * exp(-c * (t + dt)) = v0 * exp(-c * t)
-            // * exp(-c * dt) = v * exp(-c * dt) v2 = exp(-c * dt) * v1 Pade
-            // approximation: v2 = v1 * 1 / (1 + c * dt)
-            body->m_linearVelocity *= r32(1.0) / (r32(1.0) + dt * body->m_linearDamping);
-            body->m_angularVelocity *= r32(1.0) / (r32(1.0) + dt * body->m_angularDamping);
-        }
+    q3ParallelFor(jobs, body_count, k_grain, [this](u32 begin, u32 end, u32 worker) {
+        for (u32 i = begin; i < end; ++i) IntegrateVelocity(i, dt);
+    });
+    Q3_STATS(stats.island_integrate += timer.Lap());
 
-        v->v = body->m_linearVelocity;
-        v->w = body->m_angularVelocity;
-    }
+    // The position iterations follow the motion of the bodies from here
+    if (position_iterations) ResetDeltas();
 
     // Create contact solver, pass in state buffers, create buffers for contacts
     // Initialize velocity constraint for normal + friction and warm start
     q3ContactSolver contactSolver;
     contactSolver.Initialize(this);
     contactSolver.PreSolve(dt);
+    Q3_STATS(stats.island_presolve += timer.Lap());
 
     // Solve contacts
-    for (i32 i = 0; i < iterations; ++i) contactSolver.Solve();
+    {
+        Q3_TRACE_ZONE("Iterations", "contacts", i64(contacts.items.len));
+        for (usize i = 0; i < iterations; ++i) contactSolver.Solve();
+    }
+    Q3_STATS(stats.island_iterations += timer.Lap());
 
     contactSolver.ShutDown();
 
     // Copy back state buffers
     // Integrate positions
-    for (auto [body, i] : bodies.items.iter()) {
-        q3VelocityState* v = &velocities.items[i];
+    q3ParallelFor(jobs, body_count, k_grain, [this](u32 begin, u32 end, u32 worker) {
+        for (u32 i = begin; i < end; ++i) IntegratePosition(i, dt);
+    });
+    Q3_STATS(stats.island_writeback += timer.Lap());
+
+    if (position_iterations == 0) return;
+
+    // Push penetrating bodies apart by moving them
+    {
+        Q3_TRACE_ZONE("PositionIterations", "contacts", i64(contacts.items.len));
+        for (usize i = 0; i < position_iterations; ++i) {
+            if (contactSolver.SolvePositions()) break;
+        }
+    }
+
+    q3ParallelFor(jobs, body_count, k_grain, [this](u32 begin, u32 end, u32 worker) {
+        for (u32 i = begin; i < end; ++i) {
+            q3Body* body = bodies.items[i];
+            if (!body->flags.Static) body->m_tx.rotation = body->m_q.ToMat3();
+        }
+    });
+    Q3_STATS(stats.island_positions += timer.Lap());
+}
+
+// Sub-stepping (TGS style): every substep integrates the velocities, warm
+// starts, runs the velocity iterations with position bias, integrates the
+// positions and then relaxes the bias out of the velocities with one more
+// iteration. The contact points of the narrowphase are reused by all
+// substeps, their separations follow the relative motion of the bodies.
+void q3Island::SolveSubsteps() {
+    Q3_TRACE_ZONE("SolveIsland", "bodies", i64(bodies.items.len));
+    Q3_STATS(q3StatsTimer timer);
 
-        if (body->flags.Static) continue;
+    const u32 k_grain = 256;
+    u32 body_count = intCast<u32>(bodies.items.len);
+    r32 h = dt / r32(substeps);
 
-        body->m_linearVelocity = v->v;
-        body->m_angularVelocity = v->w;
+    ResetDeltas();
+    q3ContactSolver contactSolver;
+    contactSolver.Initialize(this);
 
-        // Integrate position
-        body->m_worldCenter += body->m_linearVelocity * dt;
-        body->m_q.Integrate(body->m_angularVelocity, dt);
-        body->m_q = q3Normalize(body->m_q);
-        body->m_tx.rotation = body->m_q.ToMat3();
+    for (usize substep = 0; substep < substeps; ++substep) {
+        q3ParallelFor(jobs, body_count, k_grain, [this, h](u32 begin, u32 end, u32 worker) {
+            for (u32 i = begin; i < end; ++i) IntegrateVelocity(i, h);
+        });
+        Q3_STATS(stats.island_integrate += timer.Lap());
+
+        if (substep == 0) contactSolver.PrepareSubsteps();
+        contactSolver.WarmStart();
+        Q3_STATS(stats.island_presolve += timer.Lap());
+
+        {
+            Q3_TRACE_ZONE("Iterations", "contacts", i64(contacts.items.len));
+            for (usize i = 0; i < iterations; ++i) contactSolver.SolveSubstep(h, true);
+        }
+        Q3_STATS(stats.island_iterations += timer.Lap());
+
+        bool last = substep + 1 == substeps;
+        q3ParallelFor(jobs, body_count, k_grain, [this, h, last](u32 begin, u32 end, u32 worker) {
+            for (u32 i = begin; i < end; ++i) IntegrateSubstep(i, h, last);
+        });
+        Q3_STATS(stats.island_writeback += timer.Lap());
+
+        contactSolver.SolveSubstep(h, false);
+        Q3_STATS(stats.island_iterations += timer.Lap());
+
+        // The next substep integrates the relaxed velocities
+        q3ParallelFor(jobs, body_count, k_grain, [this](u32 begin, u32 end, u32 worker) {
+            for (u32 i = begin; i < end; ++i) {
+                q3Body* body = bodies.items[i];
+                if (body->flags.Static) continue;
+                body->m_linearVelocity = velocities.items[i].v;
+                body->m_angularVelocity = velocities.items[i].w;
+            }
+        });
+        Q3_STATS(stats.island_writeback += timer.Lap());
     }
+
+    contactSolver.ShutDown();
+}
+
+void q3Island::ResetDeltas() {
+    deltas.resize(bodies.items.len).unwrap();
+    for (q3BodyDelta& delta : deltas.items) {
+        q3Identity(delta.dp);
+        q3Identity(delta.dR);
+    }
+}
+
+void q3Island::IntegrateVelocity(u32 i, r32 h) {
+    q3Body* body = bodies.items[i];
+    q3VelocityState* v = &velocities.items[i];
+
+    if (body->flags.Dynamic) {
+        // Not added to m_force, which is applied again by every substep
+        q3Vec3 force = body->m_force + gravity * body->m_gravityScale * body->m_mass;
+
+        // Calculate world space inertia tensor
+        q3Mat3 r = body->m_tx.rotation;
+        body->m_invInertiaWorld = r * body->m_invInertiaModel * q3Transpose(r);
+
+        // Integrate velocity
+        body->m_linearVelocity += (force * body->m_invMass) * h;
+        body->m_angularVelocity += (body->m_invInertiaWorld * body->m_torque) * h;
+
+        // From Box2D!
+        // Apply damping.
+        // ODE: dv/dt + c * v = 0
+        // Solution: v(t) = v0 * exp(-c * t)
+        // Time step: v(t + dt) = v0 * exp(-c * (t + dt)) = v0 * exp(-c * t)
+        // * exp(-c * dt) = v * exp(-c * dt) v2 = exp(-c * dt) * v1 Pade
+        // approximation: v2 = v1 * 1 / (1 + c * dt)
+        body->m_linearVelocity *= r32(1.0) / (r32(1.0) + h * body->m_linearDamping);
+        body->m_angularVelocity *= r32(1.0) / (r32(1.0) + h * body->m_angularDamping);
+    }
+
+    v->v = body->m_linearVelocity;
+    v->w = body->m_angularVelocity;
+}
+
+void q3Island::IntegratePosition(u32 i, r32 h) {
+    q3Body* body = bodies.items[i];
+    q3VelocityState* v = &velocities.items[i];
+
+    if (body->flags.Static) return;
+
+    body->m_linearVelocity = v->v;
+    body->m_angularVelocity = v->w;
+
+    // Integrate position
+    body->m_worldCenter += body->m_linearVelocity * h;
+    body->m_q.Integrate(body->m_angularVelocity, h);
+    body->m_q = q3Normalize(body->m_q);
+
+    if (position_iterations) {
+        q3BodyDelta* delta = &deltas.items[i];
+        delta->dp = body->m_linearVelocity * h;
+        delta->dR = body->m_q.ToMat3() * q3Transpose(body->m_tx.rotation);
+        return;
+    }
+
+    body->m_tx.rotation = body->m_q.ToMat3();
+}
+
+void q3Island::IntegrateSubstep(u32 i, r32 h, bool last) {
+    q3Body* body = bodies.items[i];
+    q3VelocityState* v = &velocities.items[i];
+    q3BodyDelta* delta = &deltas.items[i];
+
+    if (body->flags.Static) return;
+
+    q3Vec3 dp = v->v * h;
+    body->m_worldCenter += dp;
+    delta->dp += dp;
+    body->m_q.Integrate(v->w, h);
+    body->m_q = q3Normalize(body->m_q);
+
+    // The relax iteration after the last substep still needs the delta
+    q3Mat3 rotation = body->m_q.ToMat3();
+    delta->dR = rotation * q3Transpose(body->m_tx.rotation);
+    if (last) body->m_tx.rotation = rotation;
 }
 
 void q3Island::Add(q3Body* body) {
@@ -103,6 +248,8 @@ void q3Island::Add(q3ContactConstraint* contact) {
 }
 
 void q3Island::Initialize() {
+    Q3_STATS(q3StatsTimer timer);
+
     for (auto [cc, i] : contacts.items.iter()) {
         q3ContactConstraintState* c = &contact_states.items[i];
         c->centerA = cc->bodyA->m_worldCenter;
@@ -130,5 +277,10 @@ void q3Island::Initialize() {
             s->tangentImpulse[0] = cp->tangentImpulse[0];
             s->tangentImpulse[1] = cp->tangentImpulse[1];
         }
+        Q3_STATS(stats.manifold_points += c->contactCount);
     }
+
+    // Copying the contact state is part of the solver setup
+    Q3_STATS(stats.island_contacts += contacts.items.len);
+    Q3_STATS(stats.island_presolve += timer.Lap());
 }
@@ -30,6 +30,7 @@ distribution.
 #include "../dynamics/q3Body.h"
 #include "../dynamics/q3ContactManager.h"
 #include "../dynamics/q3ContactSolver.h"
+#include "../debug/q3StepStats.h"
 #include "../math/q3Math.h"
 
 struct q3VelocityState {
@@ -37,15 +38,33 @@ struct q3VelocityState {
     q3Vec3 v;
 };
 
+// Motion of a body since the start of a sub-stepped step or since the
+// narrowphase for the position iterations, from which the solver updates the
+// contact separations without running the narrowphase again
+struct q3BodyDelta {
+    q3Vec3 dp;   // Displacement of the center of mass
+    q3Mat3 dR;   // Rotation, the current one times the transposed initial one
+};
+
 struct q3Island {
     ArrayList<q3Body*> bodies;
     ArrayList<q3VelocityState> velocities;
     ArrayList<q3ContactConstraint*> contacts;
     ArrayList<q3ContactConstraintState> contact_states;
+    ArrayList<q3BodyDelta> deltas; // Sub-stepping and position iterations only
     f32 dt;
     q3Vec3 gravity;
     usize iterations;
+    // More than one splits Solve into this many substeps, see q3Scene::substeps
+    usize substeps;
+    // Position iterations after integrating, see q3Scene::position_iterations
+    usize position_iterations;
     bool enable_friction;
+    // Runs the per-body loops in parallel when not null, set by q3Scene::Step
+    q3JobInterface* jobs;
+    // Solve phases of this island, summed into q3Scene::stats by Step. Per
+    // island since the islands of a step are solved in parallel.
+    Q3_STATS(q3StepStats stats;)
 
     static q3Island init(
         Allocator allocator, f32 dt, q3Vec3 gravity, usize iterations, bool enable_friction
@@ -55,10 +74,14 @@ struct q3Island {
             .velocities = ArrayList<q3VelocityState>::init(allocator),
             .contacts = ArrayList<q3ContactConstraint*>::init(allocator),
             .contact_states = ArrayList<q3ContactConstraintState>::init(allocator),
+            .deltas = ArrayList<q3BodyDelta>::init(allocator),
             .dt = dt,
             .gravity = gravity,
             .iterations = iterations,
+            .substeps = 1,
+            .position_iterations = 0,
             .enable_friction = enable_friction,
+            .jobs = nullptr,
         };
     }
 
@@ -67,9 +90,23 @@ struct q3Island {
         this->velocities.deinit();
         this->contacts.deinit();
         this->contact_states.deinit();
+        this->deltas.deinit();
     }
 
     void Solve();
+    // helper for `Solve`, the sub-stepping mode
+    void SolveSubsteps();
+    // Zero motion for every body, before integrating the positions
+    void ResetDeltas();
+    // Gravity, forces and damping of body i over h, copied into its velocity state
+    void IntegrateVelocity(u32 i, r32 h);
+    // Copies back the solved velocity of body i and integrates its position over h.
+    // With position iterations the motion goes into its delta and m_tx.rotation is
+    // left at the start of the step until the position iterations are done.
+    void IntegratePosition(u32 i, r32 h);
+    // Integrates the position of body i over a substep h and updates its delta.
+    // Leaves m_tx.rotation at the start of the step until the last substep.
+    void IntegrateSubstep(u32 i, r32 h, bool last);
     void Add(q3Body* body);
     void Add(q3ContactConstraint* contact);
     void Initialize();
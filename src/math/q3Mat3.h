@@ -30,6 +30,121 @@ distribution.
 #include "../common/q3Types.h"
 #include "q3Vec3.h"
 
+#ifdef Q3_SIMD_ENABLED
+
+// Three SIMD rows (q3Vec3 is 16 byte aligned in this mode). The hot operators
+// are defined inline so they can be fused into the solver and narrowphase.
+struct q3Mat3 {
+    struct {
+        q3Vec3 x;
+        q3Vec3 y;
+        q3Vec3 z;
+    } e;
+
+    q3Mat3() {}
+
+    q3Mat3(r32 a, r32 b, r32 c, r32 d, r32 e, r32 f, r32 g, r32 h, r32 i) {
+        this->e.x = q3Vec3(a, b, c);
+        this->e.y = q3Vec3(d, e, f);
+        this->e.z = q3Vec3(g, h, i);
+    }
+
+    q3Mat3(const q3Vec3& _x, const q3Vec3& _y, const q3Vec3& _z) {
+        e.x = _x;
+        e.y = _y;
+        e.z = _z;
+    }
+
+    void Set(r32 a, r32 b, r32 c, r32 d, r32 e, r32 f, r32 g, r32 h, r32 i) {
+        this->e.x.Set(a, b, c);
+        this->e.y.Set(d, e, f);
+        this->e.z.Set(g, h, i);
+    }
+
+    void Set(const q3Vec3& axis, r32 angle);
+
+    void SetRows(const q3Vec3& x, const q3Vec3& y, const q3Vec3& z) {
+        e.x = x;
+        e.y = y;
+        e.z = z;
+    }
+
+    q3Mat3& operator*=(const q3Mat3& rhs) {
+        *this = *this * rhs;
+        return *this;
+    }
+
+    q3Mat3& operator*=(r32 f) {
+        e.x *= f;
+        e.y *= f;
+        e.z *= f;
+        return *this;
+    }
+
+    q3Mat3& operator+=(const q3Mat3& rhs) {
+        e.x += rhs.e.x;
+        e.y += rhs.e.y;
+        e.z += rhs.e.z;
+        return *this;
+    }
+
+    q3Mat3& operator-=(const q3Mat3& rhs) {
+        e.x -= rhs.e.x;
+        e.y -= rhs.e.y;
+        e.z -= rhs.e.z;
+        return *this;
+    }
+
+    q3Vec3& operator[](u32 index) {
+        switch (index) {
+            case 0: return e.x;
+            case 1: return e.y;
+            case 2: return e.z;
+            default: debug::assert(false); return e.x;
+        }
+    }
+
+    const q3Vec3& operator[](u32 index) const {
+        switch (index) {
+            case 0: return e.x;
+            case 1: return e.y;
+            case 2: return e.z;
+            default: debug::assert(false); return e.x;
+        }
+    }
+
+    q3Vec3 col(u32 i) {
+        if (i == 0) return q3Vec3(e.x.x, e.y.x, e.z.x);
+        if (i == 1) return q3Vec3(e.x.y, e.y.y, e.z.y);
+        if (i == 2) return q3Vec3(e.x.z, e.y.z, e.z.z);
+        unreachable();
+    }
+
+    const q3Vec3 operator*(const q3Vec3& rhs) const {
+        q3Float4 r = q3SimdMul(e.x.m, q3SimdSplatX(rhs.m));
+        r = q3SimdMulAdd(e.y.m, q3SimdSplatY(rhs.m), r);
+        r = q3SimdMulAdd(e.z.m, q3SimdSplatZ(rhs.m), r);
+        return q3Vec3(r);
+    }
+
+    const q3Mat3 operator*(const q3Mat3& rhs) const {
+        return q3Mat3((*this * rhs.e.x), (*this * rhs.e.y), (*this * rhs.e.z));
+    }
+
+    const q3Mat3 operator*(r32 f) const { return q3Mat3(e.x * f, e.y * f, e.z * f); }
+
+    const q3Mat3 operator+(const q3Mat3& rhs) const {
+        return q3Mat3(e.x + rhs.e.x, e.y + rhs.e.y, e.z + rhs.e.z);
+    }
+
+    const q3Mat3 operator-(const q3Mat3& rhs) const {
+        return q3Mat3(e.x - rhs.e.x, e.y - rhs.e.y, e.z - rhs.e.z);
+    }
+};
+
+#else
+
+// Defined inline and constexpr, see q3Vec3.
 struct q3Mat3 {
     union {
         struct {
@@ -41,22 +156,70 @@ struct q3Mat3 {
         f32 cels[9];
     };
 
-    q3Mat3();
-    q3Mat3(r32 a, r32 b, r32 c, r32 d, r32 e, r32 f, r32 g, r32 h, r32 i);
-    q3Mat3(const q3Vec3& _x, const q3Vec3& _y, const q3Vec3& _z);
+    constexpr q3Mat3() {}
+
+    constexpr q3Mat3(r32 a, r32 b, r32 c, r32 d, r32 e, r32 f, r32 g, r32 h, r32 i)
+        : e{q3Vec3(a, b, c), q3Vec3(d, e, f), q3Vec3(g, h, i)} {}
+
+    constexpr q3Mat3(const q3Vec3& _x, const q3Vec3& _y, const q3Vec3& _z) : e{_x, _y, _z} {}
+
+    constexpr void Set(r32 a, r32 b, r32 c, r32 d, r32 e, r32 f, r32 g, r32 h, r32 i) {
+        this->e.x.Set(a, b, c);
+        this->e.y.Set(d, e, f);
+        this->e.z.Set(g, h, i);
+    }
 
-    void Set(r32 a, r32 b, r32 c, r32 d, r32 e, r32 f, r32 g, r32 h, r32 i);
     void Set(const q3Vec3& axis, r32 angle);
-    void SetRows(const q3Vec3& x, const q3Vec3& y, const q3Vec3& z);
 
-    q3Mat3& operator=(const q3Mat3& rhs);
-    q3Mat3& operator*=(const q3Mat3& rhs);
-    q3Mat3& operator*=(r32 f);
-    q3Mat3& operator+=(const q3Mat3& rhs);
-    q3Mat3& operator-=(const q3Mat3& rhs);
+    constexpr void SetRows(const q3Vec3& x, const q3Vec3& y, const q3Vec3& z) {
+        e.x = x;
+        e.y = y;
+        e.z = z;
+    }
+
+    constexpr q3Mat3& operator*=(const q3Mat3& rhs) {
+        *this = *this * rhs;
+        return *this;
+    }
 
-    q3Vec3& operator[](u32 index);
-    const q3Vec3& operator[](u32 index) const;
+    constexpr q3Mat3& operator*=(r32 f) {
+        e.x *= f;
+        e.y *= f;
+        e.z *= f;
+        return *this;
+    }
+
+    constexpr q3Mat3& operator+=(const q3Mat3& rhs) {
+        e.x += rhs.e.x;
+        e.y += rhs.e.y;
+        e.z += rhs.e.z;
+        return *this;
+    }
+
+    constexpr q3Mat3& operator-=(const q3Mat3& rhs) {
+        e.x -= rhs.e.x;
+        e.y -= rhs.e.y;
+        e.z -= rhs.e.z;
+        return *this;
+    }
+
+    q3Vec3& operator[](u32 index) {
+        switch (index) {
+            case 0: return e.x;
+            case 1: return e.y;
+            case 2: return e.z;
+            default: debug::assert(false); return e.x;
+        }
+    }
+
+    const q3Vec3& operator[](u32 index) const {
+        switch (index) {
+            case 0: return e.x;
+            case 1: return e.y;
+            case 2: return e.z;
+            default: debug::assert(false); return e.x;
+        }
+    }
 
     q3Vec3 col(u32 i) {
         if (i == 0) return q3Vec3(e.x.x, e.y.x, e.z.x);
@@ -65,46 +228,72 @@ struct q3Mat3 {
         unreachable();
     }
 
-    const q3Vec3 operator*(const q3Vec3& rhs) const;
-    const q3Mat3 operator*(const q3Mat3& rhs) const;
-    const q3Mat3 operator*(r32 f) const;
-    const q3Mat3 operator+(const q3Mat3& rhs) const;
-    const q3Mat3 operator-(const q3Mat3& rhs) const;
+    constexpr const q3Vec3 operator*(const q3Vec3& rhs) const {
+        return q3Vec3(
+            e.x.x * rhs.x + e.y.x * rhs.y + e.z.x * rhs.z,
+            e.x.y * rhs.x + e.y.y * rhs.y + e.z.y * rhs.z,
+            e.x.z * rhs.x + e.y.z * rhs.y + e.z.z * rhs.z
+        );
+    }
+
+    constexpr const q3Mat3 operator*(const q3Mat3& rhs) const {
+        return q3Mat3((*this * rhs.e.x), (*this * rhs.e.y), (*this * rhs.e.z));
+    }
+
+    constexpr const q3Mat3 operator*(r32 f) const { return q3Mat3(e.x * f, e.y * f, e.z * f); }
+
+    constexpr const q3Mat3 operator+(const q3Mat3& rhs) const {
+        return q3Mat3(e.x + rhs.e.x, e.y + rhs.e.y, e.z + rhs.e.z);
+    }
+
+    constexpr const q3Mat3 operator-(const q3Mat3& rhs) const {
+        return q3Mat3(e.x - rhs.e.x, e.y - rhs.e.y, e.z - rhs.e.z);
+    }
 };
 
-inline void q3Identity(q3Mat3& m) {
+#endif // Q3_SIMD_ENABLED
+
+Q3_MATH_CONSTEXPR void q3Identity(q3Mat3& m) {
     m.Set(r32(1.0), r32(0.0), r32(0.0), r32(0.0), r32(1.0), r32(0.0), r32(0.0), r32(0.0), r32(1.0));
 }
 
-inline const q3Mat3 q3Rotate(const q3Vec3& x, const q3Vec3& y, const q3Vec3& z) {
+Q3_MATH_CONSTEXPR const q3Mat3 q3Rotate(const q3Vec3& x, const q3Vec3& y, const q3Vec3& z) {
     return q3Mat3(x, y, z);
 }
 
-inline const q3Mat3 q3Transpose(const q3Mat3& m) {
+Q3_MATH_CONSTEXPR const q3Mat3 q3Transpose(const q3Mat3& m) {
+#ifdef Q3_SIMD_ENABLED
+    q3Float4 x = m.e.x.m;
+    q3Float4 y = m.e.y.m;
+    q3Float4 z = m.e.z.m;
+    q3SimdTranspose3(x, y, z);
+    return q3Mat3(q3Vec3(x), q3Vec3(y), q3Vec3(z));
+#else
     return q3Mat3(
         m.e.x.x, m.e.y.x, m.e.z.x,
         m.e.x.y, m.e.y.y, m.e.z.y,
         m.e.x.z, m.e.y.z, m.e.z.z
     );
+#endif
 }
 
-inline void q3Zero(q3Mat3& m) {
-    memset(&m, 0, sizeof(r32) * 9);
+Q3_MATH_CONSTEXPR void q3Zero(q3Mat3& m) {
+    m.Set(r32(0.0), r32(0.0), r32(0.0), r32(0.0), r32(0.0), r32(0.0), r32(0.0), r32(0.0), r32(0.0));
 }
 
-inline const q3Mat3 q3Diagonal(r32 a) {
+Q3_MATH_CONSTEXPR const q3Mat3 q3Diagonal(r32 a) {
     return q3Mat3(
         r32(a), r32(0.0), r32(0.0), r32(0.0), r32(a), r32(0.0), r32(0.0), r32(0.0), r32(a)
     );
 }
 
-inline const q3Mat3 q3Diagonal(r32 a, r32 b, r32 c) {
+Q3_MATH_CONSTEXPR const q3Mat3 q3Diagonal(r32 a, r32 b, r32 c) {
     return q3Mat3(
         r32(a), r32(0.0), r32(0.0), r32(0.0), r32(b), r32(0.0), r32(0.0), r32(0.0), r32(c)
     );
 }
 
-inline const q3Mat3 q3OuterProduct(const q3Vec3& u, const q3Vec3& v) {
+Q3_MATH_CONSTEXPR const q3Mat3 q3OuterProduct(const q3Vec3& u, const q3Vec3& v) {
     q3Vec3 a = v * u.x;
     q3Vec3 b = v * u.y;
     q3Vec3 c = v * u.z;
@@ -144,7 +333,7 @@ inline const q3Mat3 q3Covariance(q3Vec3* points, u32 numPoints) {
     );
 };
 
-inline const q3Mat3 q3Inverse(const q3Mat3& m) {
+Q3_MATH_CONSTEXPR const q3Mat3 q3Inverse(const q3Mat3& m) {
     q3Vec3 tmp0, tmp1, tmp2;
     r32 detinv;
 
@@ -38,11 +38,11 @@ distribution.
 
 const r32 q3PI = r32(3.14159265);
 
-inline r32 q3Invert(r32 a) {
+constexpr r32 q3Invert(r32 a) {
     return a != 0.0f ? 1.0f / a : 0.0f;
 }
 
-inline r32 q3Sign(r32 a) {
+constexpr r32 q3Sign(r32 a) {
     if (a >= r32(0.0)) {
         return r32(1.0);
     } else {
@@ -50,67 +50,52 @@ inline r32 q3Sign(r32 a) {
     }
 }
 
-inline r32 q3Abs(r32 a) {
-    if (a < r32(0.0)) return -a;
-    return a;
-}
-
 namespace math {
 
 template <typename T>
-T min(T a, T b) {
+constexpr T min(T a, T b) {
     return (a < b) ? a : b;
 }
 
 template <typename T>
-T max(T a, T b) {
+constexpr T max(T a, T b) {
     return (a > b) ? a : b;
 }
 
 }; // namespace math
 
-inline i32 q3Min(i32 a, i32 b) {
+constexpr i32 q3Min(i32 a, i32 b) {
     if (a < b) return a;
     return b;
 }
 
-inline r32 q3Min(r32 a, r32 b) {
-    if (a < b) return a;
-    return b;
-}
-
-inline r32 q3Max(r32 a, r32 b) {
-    if (a > b) return a;
-    return b;
-}
-
-inline i32 q3Max(i32 a, i32 b) {
+constexpr i32 q3Max(i32 a, i32 b) {
     if (a > b) return a;
     return b;
 }
 
-inline u8 q3Max(u8 a, u8 b) {
+constexpr u8 q3Max(u8 a, u8 b) {
     if (a > b) return a;
     return b;
 }
 
-inline r32 q3Clamp01(r32 val) {
+constexpr r32 q3Clamp01(r32 val) {
     if (val >= r32(1.0)) return 1.0;
     if (val <= r32(0.0)) return 0.0;
     return val;
 }
 
-inline r32 q3Clamp(r32 min, r32 max, r32 a) {
+constexpr r32 q3Clamp(r32 min, r32 max, r32 a) {
     if (a < min) return min;
     if (a > max) return max;
     return a;
 }
 
-inline r32 q3Lerp(r32 a, r32 b, r32 t) {
+constexpr r32 q3Lerp(r32 a, r32 b, r32 t) {
     return a * (r32(1.0) - t) + b * t;
 }
 
-inline const q3Vec3 q3Lerp(const q3Vec3& a, const q3Vec3& b, r32 t) {
+Q3_MATH_CONSTEXPR const q3Vec3 q3Lerp(const q3Vec3& a, const q3Vec3& b, r32 t) {
     return a * (r32(1.0) - t) + b * t;
 }
 
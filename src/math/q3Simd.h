@@ -0,0 +1,404 @@
+/**
+@file	q3Simd.h
+
+        This software is provided 'as-is', without any express or implied
+        warranty. In no event will the authors be held liable for any damages
+        arising from the use of this software.
+
+        Permission is granted to anyone to use this software for any purpose,
+        including commercial applications, and to alter it and redistribute it
+        freely, subject to the following restrictions:
+          1. The origin of this software must not be misrepresented; you must
+not claim that you wrote the original software. If you use this software in a
+product, an acknowledgment in the product documentation would be appreciated but
+is not required.
+          2. Altered source versions must be plainly marked as such, and must
+not be misrepresented as being the original software.
+          3. This notice may not be removed or altered from any source
+distribution.
+*/
+
+#pragma once
+
+#include "../common/q3Types.h"
+
+// Compile with -DQ3_SIMD to back q3Vec3 and q3Mat3 with 4-wide SSE or NEON
+// registers. Without it (or on targets with neither instruction set) the
+// plain scalar math is used. The SIMD layout pads q3Vec3 to 16 bytes, the
+// fourth lane (w) is always kept at zero.
+#if defined(Q3_SIMD)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define Q3_SIMD_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define Q3_SIMD_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+#if defined(Q3_SIMD_SSE) || defined(Q3_SIMD_NEON)
+#define Q3_SIMD_ENABLED
+
+#if defined(Q3_SIMD_SSE)
+
+typedef __m128 q3Float4;
+
+inline q3Float4 q3SimdSet(r32 x, r32 y, r32 z, r32 w) {
+    return _mm_set_ps(w, z, y, x);
+}
+
+inline q3Float4 q3SimdSplat(r32 a) {
+    return _mm_set1_ps(a);
+}
+
+inline q3Float4 q3SimdZero() {
+    return _mm_setzero_ps();
+}
+
+inline q3Float4 q3SimdAdd(q3Float4 a, q3Float4 b) {
+    return _mm_add_ps(a, b);
+}
+
+inline q3Float4 q3SimdSub(q3Float4 a, q3Float4 b) {
+    return _mm_sub_ps(a, b);
+}
+
+inline q3Float4 q3SimdMul(q3Float4 a, q3Float4 b) {
+    return _mm_mul_ps(a, b);
+}
+
+inline q3Float4 q3SimdDiv(q3Float4 a, q3Float4 b) {
+    return _mm_div_ps(a, b);
+}
+
+inline q3Float4 q3SimdMin(q3Float4 a, q3Float4 b) {
+    return _mm_min_ps(a, b);
+}
+
+inline q3Float4 q3SimdMax(q3Float4 a, q3Float4 b) {
+    return _mm_max_ps(a, b);
+}
+
+inline q3Float4 q3SimdAbs(q3Float4 a) {
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), a);
+}
+
+inline q3Float4 q3SimdNeg(q3Float4 a) {
+    return _mm_xor_ps(_mm_set1_ps(-0.0f), a);
+}
+
+// a * b + c
+inline q3Float4 q3SimdMulAdd(q3Float4 a, q3Float4 b, q3Float4 c) {
+    return _mm_add_ps(_mm_mul_ps(a, b), c);
+}
+
+#define q3SimdShuffle(a, x, y, z, w) _mm_shuffle_ps((a), (a), _MM_SHUFFLE(w, z, y, x))
+
+inline q3Float4 q3SimdSplatX(q3Float4 a) {
+    return q3SimdShuffle(a, 0, 0, 0, 0);
+}
+
+inline q3Float4 q3SimdSplatY(q3Float4 a) {
+    return q3SimdShuffle(a, 1, 1, 1, 1);
+}
+
+inline q3Float4 q3SimdSplatZ(q3Float4 a) {
+    return q3SimdShuffle(a, 2, 2, 2, 2);
+}
+
+// Returns a (y, z, x, w) permutation, used by the cross product
+inline q3Float4 q3SimdYZX(q3Float4 a) {
+    return q3SimdShuffle(a, 1, 2, 0, 3);
+}
+
+inline r32 q3SimdGetX(q3Float4 a) {
+    return _mm_cvtss_f32(a);
+}
+
+inline q3Float4 q3SimdLoad(const r32* p) {
+    return _mm_loadu_ps(p);
+}
+
+inline void q3SimdStore(r32* p, q3Float4 a) {
+    _mm_storeu_ps(p, a);
+}
+
+// Comparisons return lane masks, all bits set where the comparison holds
+inline q3Float4 q3SimdLess(q3Float4 a, q3Float4 b) {
+    return _mm_cmplt_ps(a, b);
+}
+
+inline q3Float4 q3SimdLessEqual(q3Float4 a, q3Float4 b) {
+    return _mm_cmple_ps(a, b);
+}
+
+inline q3Float4 q3SimdAnd(q3Float4 a, q3Float4 b) {
+    return _mm_and_ps(a, b);
+}
+
+// Lanes of b where mask is set, lanes of a elsewhere
+inline q3Float4 q3SimdSelect(q3Float4 mask, q3Float4 a, q3Float4 b) {
+    return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, a));
+}
+
+// Bit i is set when lane i of the mask is
+inline u32 q3SimdMoveMask(q3Float4 mask) {
+    return u32(_mm_movemask_ps(mask));
+}
+
+// Sum of the x, y and z lanes
+inline r32 q3SimdHorizontalAdd3(q3Float4 a) {
+    q3Float4 y = q3SimdSplatY(a);
+    q3Float4 z = q3SimdSplatZ(a);
+    return _mm_cvtss_f32(_mm_add_ss(_mm_add_ss(a, y), z));
+}
+
+// Transposes the 3x3 block held in the x, y, z lanes of three rows. The w
+// lanes of the result are zero.
+inline void q3SimdTranspose3(q3Float4& a, q3Float4& b, q3Float4& c) {
+    q3Float4 d = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(a, b, c, d);
+}
+
+#elif defined(Q3_SIMD_NEON)
+
+typedef float32x4_t q3Float4;
+
+inline q3Float4 q3SimdSet(r32 x, r32 y, r32 z, r32 w) {
+    const r32 v[4] = {x, y, z, w};
+    return vld1q_f32(v);
+}
+
+inline q3Float4 q3SimdSplat(r32 a) {
+    return vdupq_n_f32(a);
+}
+
+inline q3Float4 q3SimdZero() {
+    return vdupq_n_f32(0.0f);
+}
+
+inline q3Float4 q3SimdAdd(q3Float4 a, q3Float4 b) {
+    return vaddq_f32(a, b);
+}
+
+inline q3Float4 q3SimdSub(q3Float4 a, q3Float4 b) {
+    return vsubq_f32(a, b);
+}
+
+inline q3Float4 q3SimdMul(q3Float4 a, q3Float4 b) {
+    return vmulq_f32(a, b);
+}
+
+inline q3Float4 q3SimdDiv(q3Float4 a, q3Float4 b) {
+    return vdivq_f32(a, b);
+}
+
+inline q3Float4 q3SimdMin(q3Float4 a, q3Float4 b) {
+    return vminq_f32(a, b);
+}
+
+inline q3Float4 q3SimdMax(q3Float4 a, q3Float4 b) {
+    return vmaxq_f32(a, b);
+}
+
+inline q3Float4 q3SimdAbs(q3Float4 a) {
+    return vabsq_f32(a);
+}
+
+inline q3Float4 q3SimdNeg(q3Float4 a) {
+    return vnegq_f32(a);
+}
+
+// a * b + c
+inline q3Float4 q3SimdMulAdd(q3Float4 a, q3Float4 b, q3Float4 c) {
+    return vmlaq_f32(c, a, b);
+}
+
+inline q3Float4 q3SimdSplatX(q3Float4 a) {
+    return vdupq_laneq_f32(a, 0);
+}
+
+inline q3Float4 q3SimdSplatY(q3Float4 a) {
+    return vdupq_laneq_f32(a, 1);
+}
+
+inline q3Float4 q3SimdSplatZ(q3Float4 a) {
+    return vdupq_laneq_f32(a, 2);
+}
+
+// Returns a (y, z, x, w) permutation, used by the cross product
+inline q3Float4 q3SimdYZX(q3Float4 a) {
+    q3Float4 yzwx = vextq_f32(a, a, 1);
+    return vsetq_lane_f32(vgetq_lane_f32(a, 3), vsetq_lane_f32(vgetq_lane_f32(a, 0), yzwx, 2), 3);
+}
+
+inline r32 q3SimdGetX(q3Float4 a) {
+    return vgetq_lane_f32(a, 0);
+}
+
+inline q3Float4 q3SimdLoad(const r32* p) {
+    return vld1q_f32(p);
+}
+
+inline void q3SimdStore(r32* p, q3Float4 a) {
+    vst1q_f32(p, a);
+}
+
+// Comparisons return lane masks, all bits set where the comparison holds
+inline q3Float4 q3SimdLess(q3Float4 a, q3Float4 b) {
+    return vreinterpretq_f32_u32(vcltq_f32(a, b));
+}
+
+inline q3Float4 q3SimdLessEqual(q3Float4 a, q3Float4 b) {
+    return vreinterpretq_f32_u32(vcleq_f32(a, b));
+}
+
+inline q3Float4 q3SimdAnd(q3Float4 a, q3Float4 b) {
+    return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)));
+}
+
+// Lanes of b where mask is set, lanes of a elsewhere
+inline q3Float4 q3SimdSelect(q3Float4 mask, q3Float4 a, q3Float4 b) {
+    return vbslq_f32(vreinterpretq_u32_f32(mask), b, a);
+}
+
+// Bit i is set when lane i of the mask is
+inline u32 q3SimdMoveMask(q3Float4 mask) {
+    const u32 bits[4] = {1, 2, 4, 8};
+    uint32x4_t set = vshrq_n_u32(vreinterpretq_u32_f32(mask), 31);
+    return vaddvq_u32(vmulq_u32(set, vld1q_u32(bits)));
+}
+
+// Sum of the x, y and z lanes
+inline r32 q3SimdHorizontalAdd3(q3Float4 a) {
+    return vgetq_lane_f32(a, 0) + vgetq_lane_f32(a, 1) + vgetq_lane_f32(a, 2);
+}
+
+// Transposes the 3x3 block held in the x, y, z lanes of three rows. The w
+// lanes of the result are zero.
+inline void q3SimdTranspose3(q3Float4& a, q3Float4& b, q3Float4& c) {
+    float32x4x2_t ab = vtrnq_f32(a, b);
+    float32x4x2_t cd = vtrnq_f32(c, vdupq_n_f32(0.0f));
+    a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+    b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+    c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+}
+
+#endif
+
+#else
+
+// Lane by lane fallback of the q3Float4 operations the ray packets use (see
+// q3RayPacket), so batched queries work without SIMD as well. Masks hold all
+// bits set in the lanes where a comparison holds, like the SIMD versions.
+#include <bit>
+
+struct q3Float4 {
+    r32 v[4];
+};
+
+#define Q3_SIMD_LANES(expr)                                                                        \
+    q3Float4 r;                                                                                    \
+    for (i32 i = 0; i < 4; ++i) r.v[i] = (expr);                                                   \
+    return r
+
+inline q3Float4 q3SimdSet(r32 x, r32 y, r32 z, r32 w) {
+    return q3Float4{{x, y, z, w}};
+}
+
+inline q3Float4 q3SimdSplat(r32 a) {
+    return q3Float4{{a, a, a, a}};
+}
+
+inline q3Float4 q3SimdZero() {
+    return q3SimdSplat(0.0f);
+}
+
+inline q3Float4 q3SimdLoad(const r32* p) {
+    return q3Float4{{p[0], p[1], p[2], p[3]}};
+}
+
+inline void q3SimdStore(r32* p, q3Float4 a) {
+    for (i32 i = 0; i < 4; ++i) p[i] = a.v[i];
+}
+
+inline r32 q3SimdGetX(q3Float4 a) {
+    return a.v[0];
+}
+
+inline q3Float4 q3SimdAdd(q3Float4 a, q3Float4 b) {
+    Q3_SIMD_LANES(a.v[i] + b.v[i]);
+}
+
+inline q3Float4 q3SimdSub(q3Float4 a, q3Float4 b) {
+    Q3_SIMD_LANES(a.v[i] - b.v[i]);
+}
+
+inline q3Float4 q3SimdMul(q3Float4 a, q3Float4 b) {
+    Q3_SIMD_LANES(a.v[i] * b.v[i]);
+}
+
+inline q3Float4 q3SimdDiv(q3Float4 a, q3Float4 b) {
+    Q3_SIMD_LANES(a.v[i] / b.v[i]);
+}
+
+inline q3Float4 q3SimdMin(q3Float4 a, q3Float4 b) {
+    Q3_SIMD_LANES(a.v[i] < b.v[i] ? a.v[i] : b.v[i]);
+}
+
+inline q3Float4 q3SimdMax(q3Float4 a, q3Float4 b) {
+    Q3_SIMD_LANES(a.v[i] > b.v[i] ? a.v[i] : b.v[i]);
+}
+
+inline q3Float4 q3SimdAbs(q3Float4 a) {
+    Q3_SIMD_LANES(a.v[i] < 0.0f ? -a.v[i] : a.v[i]);
+}
+
+inline q3Float4 q3SimdNeg(q3Float4 a) {
+    Q3_SIMD_LANES(-a.v[i]);
+}
+
+// a * b + c
+inline q3Float4 q3SimdMulAdd(q3Float4 a, q3Float4 b, q3Float4 c) {
+    Q3_SIMD_LANES(a.v[i] * b.v[i] + c.v[i]);
+}
+
+inline r32 q3SimdMaskLane(bool set) {
+    return std::bit_cast<r32>(set ? ~u32(0) : u32(0));
+}
+
+inline q3Float4 q3SimdLess(q3Float4 a, q3Float4 b) {
+    Q3_SIMD_LANES(q3SimdMaskLane(a.v[i] < b.v[i]));
+}
+
+inline q3Float4 q3SimdLessEqual(q3Float4 a, q3Float4 b) {
+    Q3_SIMD_LANES(q3SimdMaskLane(a.v[i] <= b.v[i]));
+}
+
+inline q3Float4 q3SimdAnd(q3Float4 a, q3Float4 b) {
+    Q3_SIMD_LANES(std::bit_cast<r32>(std::bit_cast<u32>(a.v[i]) & std::bit_cast<u32>(b.v[i])));
+}
+
+// Lanes of b where mask is set, lanes of a elsewhere
+inline q3Float4 q3SimdSelect(q3Float4 mask, q3Float4 a, q3Float4 b) {
+    Q3_SIMD_LANES(std::bit_cast<u32>(mask.v[i]) ? b.v[i] : a.v[i]);
+}
+
+// Bit i is set when lane i of the mask is
+inline u32 q3SimdMoveMask(q3Float4 mask) {
+    u32 bits = 0;
+    for (i32 i = 0; i < 4; ++i) bits |= (std::bit_cast<u32>(mask.v[i]) >> 31) << i;
+    return bits;
+}
+
+#undef Q3_SIMD_LANES
+
+#endif // Q3_SIMD_SSE || Q3_SIMD_NEON
+
+// Scalar vector and matrix math is constexpr, intrinsics can only run at
+// runtime so the SIMD variants are merely inline.
+#ifdef Q3_SIMD_ENABLED
+#define Q3_MATH_CONSTEXPR inline
+#else
+#define Q3_MATH_CONSTEXPR constexpr
+#endif
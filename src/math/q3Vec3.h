@@ -28,11 +28,96 @@ distribution.
 #include <cmath>
 
 #include "../common/q3Types.h"
+#include "q3Simd.h"
 
-r32 q3Abs(r32 a);
-r32 q3Min(r32 a, r32 b);
-r32 q3Max(r32 a, r32 b);
+constexpr r32 q3Abs(r32 a) {
+    if (a < r32(0.0)) return -a;
+    return a;
+}
+
+constexpr r32 q3Min(r32 a, r32 b) {
+    if (a < b) return a;
+    return b;
+}
+
+constexpr r32 q3Max(r32 a, r32 b) {
+    if (a > b) return a;
+    return b;
+}
+
+#ifdef Q3_SIMD_ENABLED
+
+// 16 byte aligned vector backed by a SIMD register. The w lane is padding and
+// always zero, so it never contributes to dot products, lengths or cross
+// products. All operators are inline so they can be fused by the compiler.
+struct alignas(16) q3Vec3 {
+    union {
+        q3Float4 m;
+        r32 v[4];
+
+        struct {
+            r32 x;
+            r32 y;
+            r32 z;
+            r32 w;
+        };
+    };
+
+    q3Vec3() {}
+
+    q3Vec3(r32 _x, r32 _y, r32 _z) : m(q3SimdSet(_x, _y, _z, r32(0.0))) {}
+
+    explicit q3Vec3(q3Float4 _m) : m(_m) {}
+
+    void Set(r32 _x, r32 _y, r32 _z) { m = q3SimdSet(_x, _y, _z, r32(0.0)); }
+
+    void SetAll(r32 a) { m = q3SimdSet(a, a, a, r32(0.0)); }
+
+    q3Vec3& operator+=(const q3Vec3& rhs) {
+        m = q3SimdAdd(m, rhs.m);
+        return *this;
+    }
+
+    q3Vec3& operator-=(const q3Vec3& rhs) {
+        m = q3SimdSub(m, rhs.m);
+        return *this;
+    }
+
+    q3Vec3& operator*=(r32 f) {
+        m = q3SimdMul(m, q3SimdSplat(f));
+        return *this;
+    }
+
+    q3Vec3& operator/=(r32 f) {
+        m = q3SimdDiv(m, q3SimdSplat(f));
+        return *this;
+    }
+
+    r32& operator[](u32 i) {
+        debug::assert(i < 3);
+        return v[i];
+    }
 
+    r32 operator[](u32 i) const {
+        debug::assert(i < 3);
+        return v[i];
+    }
+
+    q3Vec3 operator-(void) const { return q3Vec3(q3SimdNeg(m)); }
+
+    const q3Vec3 operator+(const q3Vec3& rhs) const { return q3Vec3(q3SimdAdd(m, rhs.m)); }
+
+    const q3Vec3 operator-(const q3Vec3& rhs) const { return q3Vec3(q3SimdSub(m, rhs.m)); }
+
+    const q3Vec3 operator*(r32 f) const { return q3Vec3(q3SimdMul(m, q3SimdSplat(f))); }
+
+    const q3Vec3 operator/(r32 f) const { return q3Vec3(q3SimdDiv(m, q3SimdSplat(f))); }
+};
+
+#else
+
+// All operators are inline and constexpr so the solver and narrowphase loops
+// compile down to plain float arithmetic without needing LTO.
 struct q3Vec3 {
     union {
         r32 v[3];
@@ -44,49 +129,113 @@ struct q3Vec3 {
         };
     };
 
-    q3Vec3();
-    q3Vec3(r32 _x, r32 _y, r32 _z);
+    constexpr q3Vec3() {}
+
+    constexpr q3Vec3(r32 _x, r32 _y, r32 _z) : x(_x), y(_y), z(_z) {}
+
+    constexpr void Set(r32 _x, r32 _y, r32 _z) {
+        x = _x;
+        y = _y;
+        z = _z;
+    }
+
+    constexpr void SetAll(r32 a) {
+        x = a;
+        y = a;
+        z = a;
+    }
+
+    constexpr q3Vec3& operator+=(const q3Vec3& rhs) {
+        x += rhs.x;
+        y += rhs.y;
+        z += rhs.z;
+        return *this;
+    }
+
+    constexpr q3Vec3& operator-=(const q3Vec3& rhs) {
+        x -= rhs.x;
+        y -= rhs.y;
+        z -= rhs.z;
+        return *this;
+    }
+
+    constexpr q3Vec3& operator*=(r32 f) {
+        x *= f;
+        y *= f;
+        z *= f;
+        return *this;
+    }
 
-    void Set(r32 _x, r32 _y, r32 _z);
-    void SetAll(r32 a);
-    q3Vec3& operator+=(const q3Vec3& rhs);
-    q3Vec3& operator-=(const q3Vec3& rhs);
-    q3Vec3& operator*=(r32 f);
-    q3Vec3& operator/=(r32 f);
+    constexpr q3Vec3& operator/=(r32 f) {
+        x /= f;
+        y /= f;
+        z /= f;
+        return *this;
+    }
 
-    r32& operator[](u32 i);
-    r32 operator[](u32 i) const;
+    r32& operator[](u32 i) {
+        debug::assert(i < 3);
+        return v[i];
+    }
 
-    q3Vec3 operator-(void) const;
+    r32 operator[](u32 i) const {
+        debug::assert(i < 3);
+        return v[i];
+    }
 
-    const q3Vec3 operator+(const q3Vec3& rhs) const;
-    const q3Vec3 operator-(const q3Vec3& rhs) const;
-    const q3Vec3 operator*(r32 f) const;
-    const q3Vec3 operator/(r32 f) const;
+    constexpr q3Vec3 operator-(void) const { return q3Vec3(-x, -y, -z); }
+
+    constexpr const q3Vec3 operator+(const q3Vec3& rhs) const {
+        return q3Vec3(x + rhs.x, y + rhs.y, z + rhs.z);
+    }
+
+    constexpr const q3Vec3 operator-(const q3Vec3& rhs) const {
+        return q3Vec3(x - rhs.x, y - rhs.y, z - rhs.z);
+    }
+
+    constexpr const q3Vec3 operator*(r32 f) const { return q3Vec3(x * f, y * f, z * f); }
+
+    constexpr const q3Vec3 operator/(r32 f) const { return q3Vec3(x / f, y / f, z / f); }
 };
 
-inline void q3Identity(q3Vec3& v) {
+#endif // Q3_SIMD_ENABLED
+
+Q3_MATH_CONSTEXPR void q3Identity(q3Vec3& v) {
     v.Set(r32(0.0), r32(0.0), r32(0.0));
 }
 
-inline const q3Vec3 q3Mul(const q3Vec3& a, const q3Vec3& b) {
+Q3_MATH_CONSTEXPR const q3Vec3 q3Mul(const q3Vec3& a, const q3Vec3& b) {
+#ifdef Q3_SIMD_ENABLED
+    return q3Vec3(q3SimdMul(a.m, b.m));
+#else
     return q3Vec3(a.x * b.x, a.y * b.y, a.z * b.z);
+#endif
 }
 
-inline r32 q3Dot(const q3Vec3& a, const q3Vec3& b) {
+Q3_MATH_CONSTEXPR r32 q3Dot(const q3Vec3& a, const q3Vec3& b) {
+#ifdef Q3_SIMD_ENABLED
+    return q3SimdHorizontalAdd3(q3SimdMul(a.m, b.m));
+#else
     return a.x * b.x + a.y * b.y + a.z * b.z;
+#endif
 }
 
-inline const q3Vec3 q3Cross(const q3Vec3& a, const q3Vec3& b) {
+Q3_MATH_CONSTEXPR const q3Vec3 q3Cross(const q3Vec3& a, const q3Vec3& b) {
+#ifdef Q3_SIMD_ENABLED
+    // (a * b.yzx - a.yzx * b).yzx
+    q3Float4 c = q3SimdSub(q3SimdMul(a.m, q3SimdYZX(b.m)), q3SimdMul(q3SimdYZX(a.m), b.m));
+    return q3Vec3(q3SimdYZX(c));
+#else
     return q3Vec3((a.y * b.z) - (b.y * a.z), (b.x * a.z) - (a.x * b.z), (a.x * b.y) - (b.x * a.y));
+#endif
 }
 
 inline r32 q3Length(const q3Vec3& v) {
-    return std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+    return std::sqrt(q3Dot(v, v));
 }
 
-inline r32 q3LengthSq(const q3Vec3& v) {
-    return v.x * v.x + v.y * v.y + v.z * v.z;
+Q3_MATH_CONSTEXPR r32 q3LengthSq(const q3Vec3& v) {
+    return q3Dot(v, v);
 }
 
 inline const q3Vec3 q3Normalize(const q3Vec3& v) {
@@ -108,7 +257,7 @@ inline r32 q3Distance(const q3Vec3& a, const q3Vec3& b) {
     return std::sqrt(xp * xp + yp * yp + zp * zp);
 }
 
-inline r32 q3DistanceSq(const q3Vec3& a, const q3Vec3& b) {
+Q3_MATH_CONSTEXPR r32 q3DistanceSq(const q3Vec3& a, const q3Vec3& b) {
     r32 xp = a.x - b.x;
     r32 yp = a.y - b.y;
     r32 zp = a.z - b.z;
@@ -116,22 +265,34 @@ inline r32 q3DistanceSq(const q3Vec3& a, const q3Vec3& b) {
     return xp * xp + yp * yp + zp * zp;
 }
 
-inline const q3Vec3 q3Abs(const q3Vec3& v) {
+Q3_MATH_CONSTEXPR const q3Vec3 q3Abs(const q3Vec3& v) {
+#ifdef Q3_SIMD_ENABLED
+    return q3Vec3(q3SimdAbs(v.m));
+#else
     return q3Vec3(q3Abs(v.x), q3Abs(v.y), q3Abs(v.z));
+#endif
 }
 
-inline const q3Vec3 q3Min(const q3Vec3& a, const q3Vec3& b) {
+Q3_MATH_CONSTEXPR const q3Vec3 q3Min(const q3Vec3& a, const q3Vec3& b) {
+#ifdef Q3_SIMD_ENABLED
+    return q3Vec3(q3SimdMin(a.m, b.m));
+#else
     return q3Vec3(q3Min(a.x, b.x), q3Min(a.y, b.y), q3Min(a.z, b.z));
+#endif
 }
 
-inline const q3Vec3 q3Max(const q3Vec3& a, const q3Vec3& b) {
+Q3_MATH_CONSTEXPR const q3Vec3 q3Max(const q3Vec3& a, const q3Vec3& b) {
+#ifdef Q3_SIMD_ENABLED
+    return q3Vec3(q3SimdMax(a.m, b.m));
+#else
     return q3Vec3(q3Max(a.x, b.x), q3Max(a.y, b.y), q3Max(a.z, b.z));
+#endif
 }
 
-inline const r32 q3MinPerElem(const q3Vec3& a) {
+Q3_MATH_CONSTEXPR const r32 q3MinPerElem(const q3Vec3& a) {
     return q3Min(a.x, q3Min(a.y, a.z));
 }
 
-inline const r32 q3MaxPerElem(const q3Vec3& a) {
+Q3_MATH_CONSTEXPR const r32 q3MaxPerElem(const q3Vec3& a) {
     return q3Max(a.x, q3Max(a.y, a.z));
 }
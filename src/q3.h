@@ -26,11 +26,14 @@ distribution.
 #pragma once
 
 #include "collision/q3Box.h"
+#include "common/q3Jobs.h"
 #include "common/q3Types.h"
 #include "debug/q3Render.h"
+#include "debug/q3Trace.h"
 #include "dynamics/q3Body.h"
 #include "math/q3Mat3.h"
 #include "math/q3Quaternion.h"
 #include "math/q3Transform.h"
 #include "math/q3Vec3.h"
 #include "scene/q3Scene.h"
+#include "scene/q3TransformStream.h"
@@ -0,0 +1,189 @@
+/**
+@file	q3AsyncStep.cpp
+
+        This software is provided 'as-is', without any express or implied
+        warranty. In no event will the authors be held liable for any damages
+        arising from the use of this software.
+
+        Permission is granted to anyone to use this software for any purpose,
+        including commercial applications, and to alter it and redistribute it
+        freely, subject to the following restrictions:
+          1. The origin of this software must not be misrepresented; you must
+not claim that you wrote the original software. If you use this software in a
+product, an acknowledgment in the product documentation would be appreciated but
+is not required.
+          2. Altered source versions must be plainly marked as such, and must
+not be misrepresented as being the original software.
+          3. This notice may not be removed or altered from any source
+distribution.
+*/
+
+
+#include "q3AsyncStep.h"
+#include "q3Scene.h"
+#include "../dynamics/q3Body.h"
+
+void q3BodyCommand::Apply() const {
+    switch (type) {
+    case eApplyLinearForce: body->ApplyLinearForce(a); break;
+    case eApplyForceAtWorldPoint: body->ApplyForceAtWorldPoint(a, b); break;
+    case eApplyLinearImpulse: body->ApplyLinearImpulse(a); break;
+    case eApplyLinearImpulseAtWorldPoint: body->ApplyLinearImpulseAtWorldPoint(a, b); break;
+    case eApplyTorque: body->ApplyTorque(a); break;
+    case eSetLinearVelocity: body->SetLinearVelocity(a); break;
+    case eSetAngularVelocity: body->SetAngularVelocity(a); break;
+    case eSetPosition: body->SetTransform(a); break;
+    case eSetTransform: body->SetTransform(a, b, angle); break;
+    }
+}
+
+q3CommandQueue::q3CommandQueue(Allocator allocator) {
+    commands = ArrayList<q3BodyCommand>::init(allocator);
+}
+
+q3CommandQueue::~q3CommandQueue() {
+    commands.deinit();
+}
+
+void q3CommandQueue::ApplyLinearForce(q3Body* body, const q3Vec3& force) {
+    commands.append({.type = q3BodyCommand::eApplyLinearForce, .body = body, .a = force}).unwrap();
+}
+
+void q3CommandQueue::ApplyForceAtWorldPoint(q3Body* body, const q3Vec3& force, const q3Vec3& point) {
+    commands
+        .append({.type = q3BodyCommand::eApplyForceAtWorldPoint, .body = body, .a = force, .b = point})
+        .unwrap();
+}
+
+void q3CommandQueue::ApplyLinearImpulse(q3Body* body, const q3Vec3& impulse) {
+    commands.append({.type = q3BodyCommand::eApplyLinearImpulse, .body = body, .a = impulse})
+        .unwrap();
+}
+
+void q3CommandQueue::ApplyLinearImpulseAtWorldPoint(
+    q3Body* body, const q3Vec3& impulse, const q3Vec3& point
+) {
+    commands
+        .append({
+            .type = q3BodyCommand::eApplyLinearImpulseAtWorldPoint,
+            .body = body,
+            .a = impulse,
+            .b = point,
+        })
+        .unwrap();
+}
+
+void q3CommandQueue::ApplyTorque(q3Body* body, const q3Vec3& torque) {
+    commands.append({.type = q3BodyCommand::eApplyTorque, .body = body, .a = torque}).unwrap();
+}
+
+void q3CommandQueue::SetLinearVelocity(q3Body* body, const q3Vec3& v) {
+    commands.append({.type = q3BodyCommand::eSetLinearVelocity, .body = body, .a = v}).unwrap();
+}
+
+void q3CommandQueue::SetAngularVelocity(q3Body* body, const q3Vec3& v) {
+    commands.append({.type = q3BodyCommand::eSetAngularVelocity, .body = body, .a = v}).unwrap();
+}
+
+void q3CommandQueue::SetTransform(q3Body* body, const q3Vec3& position) {
+    commands.append({.type = q3BodyCommand::eSetPosition, .body = body, .a = position}).unwrap();
+}
+
+void q3CommandQueue::SetTransform(
+    q3Body* body, const q3Vec3& position, const q3Vec3& axis, r32 angle
+) {
+    commands
+        .append({
+            .type = q3BodyCommand::eSetTransform,
+            .body = body,
+            .a = position,
+            .b = axis,
+            .angle = angle,
+        })
+        .unwrap();
+}
+
+void q3CommandQueue::Apply() {
+    for (const q3BodyCommand& command : commands.items) command.Apply();
+    commands.shrinkRetainingCapacity(0);
+}
+
+void q3CommandQueue::RemoveBody(const q3Body* body) {
+    usize kept = 0;
+    for (usize i = 0; i < commands.items.len; ++i) {
+        if (commands.items[i].body != body) commands.items[kept++] = commands.items[i];
+    }
+    commands.shrinkRetainingCapacity(kept);
+}
+
+q3AsyncStepper::q3AsyncStepper(Allocator allocator) : requested(0), completed(0), quit(false) {
+    front = ArrayList<q3BodyTransform>::init(allocator);
+}
+
+q3AsyncStepper::~q3AsyncStepper() {
+    Shutdown();
+    front.deinit();
+}
+
+q3StepToken q3AsyncStepper::Launch(q3Scene* scene) {
+    // The bodies are only read here, before the thread starts writing them
+    front.shrinkRetainingCapacity(0);
+    front.ensureTotalCapacity(scene->bodies.len).unwrap();
+    for (q3Body* body : scene->bodies.ptrIter()) front.append({body, body->m_tx}).unwrap();
+
+    if (!thread.joinable()) thread = std::thread(&q3AsyncStepper::ThreadMain, this, scene);
+
+    u64 step;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        step = ++requested;
+    }
+    cv.notify_all();
+    return q3StepToken{step};
+}
+
+bool q3AsyncStepper::IsDone(q3StepToken token) const {
+    return completed.load(std::memory_order_acquire) >= token.step;
+}
+
+void q3AsyncStepper::Wait(q3StepToken token) {
+    if (IsDone(token)) return;
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this, token] { return IsDone(token); });
+}
+
+bool q3AsyncStepper::Busy() const {
+    return completed.load(std::memory_order_acquire) != requested;
+}
+
+void q3AsyncStepper::Shutdown() {
+    if (!thread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    cv.notify_all();
+    thread.join();
+}
+
+void q3AsyncStepper::ThreadMain(q3Scene* scene) {
+    u64 done = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            // Quit only once every launched step ran
+            cv.wait(lock, [this, done] { return requested > done || quit; });
+            if (requested == done) return;
+        }
+
+        scene->Simulate();
+        done += 1;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            completed.store(done, std::memory_order_release);
+        }
+        cv.notify_all();
+    }
+}
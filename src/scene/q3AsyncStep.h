@@ -0,0 +1,128 @@
+/**
+@file	q3AsyncStep.h
+
+        This software is provided 'as-is', without any express or implied
+        warranty. In no event will the authors be held liable for any damages
+        arising from the use of this software.
+
+        Permission is granted to anyone to use this software for any purpose,
+        including commercial applications, and to alter it and redistribute it
+        freely, subject to the following restrictions:
+          1. The origin of this software must not be misrepresented; you must
+not claim that you wrote the original software. If you use this software in a
+product, an acknowledgment in the product documentation would be appreciated but
+is not required.
+          2. Altered source versions must be plainly marked as such, and must
+not be misrepresented as being the original software.
+          3. This notice may not be removed or altered from any source
+distribution.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "../common/q3Types.h"
+#include "../math/q3Transform.h"
+
+// Asynchronous stepping, see q3Scene::StepAsync. A frame then looks like:
+//
+//     q3StepToken token = scene.StepAsync();       // Simulation starts on the step thread
+//     for (q3BodyTransform t : scene.FrontTransforms()) Draw(t.body, t.tx);
+//     scene.commands.ApplyLinearImpulse(body, jump); // Applied by the next step
+//     scene.WaitStep(token);
+//
+// While a step runs the bodies must not be read or written directly: their
+// transforms as of the last completed step are in the front buffer and writes
+// go through the command queue.
+
+// Write to a body, deferred to the start of the next step
+struct q3BodyCommand {
+    enum Type {
+        eApplyLinearForce,
+        eApplyForceAtWorldPoint,
+        eApplyLinearImpulse,
+        eApplyLinearImpulseAtWorldPoint,
+        eApplyTorque,
+        eSetLinearVelocity,
+        eSetAngularVelocity,
+        eSetPosition,
+        eSetTransform,
+    };
+
+    Type type;
+    q3Body* body;
+    q3Vec3 a;  // Force, impulse, torque, velocity or position
+    q3Vec3 b;  // World point or rotation axis
+    r32 angle; // eSetTransform only
+
+    // Calls the q3Body method
+    void Apply() const;
+};
+
+// Commands queued by the game and applied in order at the start of the next
+// q3Scene::Step or StepAsync. Mirrors the q3Body methods of the same names.
+// Not thread safe, use it from the thread that steps the scene.
+struct q3CommandQueue {
+    ArrayList<q3BodyCommand> commands;
+
+    q3CommandQueue(Allocator allocator);
+    ~q3CommandQueue();
+
+    void ApplyLinearForce(q3Body* body, const q3Vec3& force);
+    void ApplyForceAtWorldPoint(q3Body* body, const q3Vec3& force, const q3Vec3& point);
+    void ApplyLinearImpulse(q3Body* body, const q3Vec3& impulse);
+    void ApplyLinearImpulseAtWorldPoint(q3Body* body, const q3Vec3& impulse, const q3Vec3& point);
+    void ApplyTorque(q3Body* body, const q3Vec3& torque);
+    void SetLinearVelocity(q3Body* body, const q3Vec3& v);
+    void SetAngularVelocity(q3Body* body, const q3Vec3& v);
+    void SetTransform(q3Body* body, const q3Vec3& position);
+    void SetTransform(q3Body* body, const q3Vec3& position, const q3Vec3& axis, r32 angle);
+
+    // Runs and clears the queued commands
+    void Apply();
+    // Drops the commands of a body that is about to be removed
+    void RemoveBody(const q3Body* body);
+};
+
+// A body's world transform as of the last completed step
+struct q3BodyTransform {
+    q3Body* body;
+    q3Transform tx;
+};
+
+// Identifies one q3Scene::StepAsync call
+struct q3StepToken {
+    u64 step;
+};
+
+// The thread that runs the asynchronous steps of a scene. It is started by
+// the first StepAsync and sleeps between steps, so no thread is created per
+// step.
+struct q3AsyncStepper {
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cv;
+    u64 requested;               // Guarded by mutex
+    std::atomic<u64> completed;  // Steps finished by the thread
+    bool quit;                   // Guarded by mutex
+    ArrayList<q3BodyTransform> front;
+
+    q3AsyncStepper(Allocator allocator);
+    ~q3AsyncStepper();
+
+    // Starts one more step of the scene on the thread
+    q3StepToken Launch(q3Scene* scene);
+    bool IsDone(q3StepToken token) const;
+    void Wait(q3StepToken token);
+    // True while a launched step has not completed
+    bool Busy() const;
+    // Waits for the running step and stops the thread
+    void Shutdown();
+
+    void ThreadMain(q3Scene* scene);
+};
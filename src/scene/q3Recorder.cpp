@@ -0,0 +1,379 @@
+/**
+@file	q3Recorder.cpp
+
+        This software is provided 'as-is', without any express or implied
+        warranty. In no event will the authors be held liable for any damages
+        arising from the use of this software.
+
+        Permission is granted to anyone to use this software for any purpose,
+        including commercial applications, and to alter it and redistribute it
+        freely, subject to the following restrictions:
+          1. The origin of this software must not be misrepresented; you must
+not claim that you wrote the original software. If you use this software in a
+product, an acknowledgment in the product documentation would be appreciated but
+is not required.
+          2. Altered source versions must be plainly marked as such, and must
+not be misrepresented as being the original software.
+          3. This notice may not be removed or altered from any source
+distribution.
+*/
+
+
+#include <string.h>
+
+#include "q3Recorder.h"
+#include "q3AsyncStep.h"
+#include "q3Scene.h"
+#include "q3SceneState.h"
+#include "q3StaticWorld.h"
+#include "../collision/q3Box.h"
+#include "../dynamics/q3Body.h"
+
+static void q3Put(r32* out, const q3Vec3& v) {
+    out[0] = v.x;
+    out[1] = v.y;
+    out[2] = v.z;
+}
+
+static void q3Put(r32* out, const q3Mat3& m) {
+    q3Put(out, m[0]);
+    q3Put(out + 3, m[1]);
+    q3Put(out + 6, m[2]);
+}
+
+static q3Vec3 q3GetVec3(const r32* in) {
+    return q3Vec3(in[0], in[1], in[2]);
+}
+
+static q3Mat3 q3GetMat3(const r32* in) {
+    return q3Mat3(q3GetVec3(in), q3GetVec3(in + 3), q3GetVec3(in + 6));
+}
+
+static q3SettingsRecord q3CaptureSettings(const q3Scene* scene) {
+    q3SettingsRecord r = {};
+    r.dt = scene->dt;
+    q3Put(r.gravity, scene->gravity);
+    r.iterations = u32(scene->iterations);
+    r.substeps = u32(scene->substeps);
+    r.position_iterations = u32(scene->position_iterations);
+    r.enable_friction = scene->enable_friction;
+    r.enable_persist_events = scene->enable_persist_events;
+    r.enable_snapshots = scene->enable_snapshots;
+    r.deterministic = scene->deterministic;
+    return r;
+}
+
+q3Recorder::q3Recorder() :
+    file(nullptr),
+    scene(nullptr),
+    settings({}),
+    steps(0),
+    failed(false) {}
+
+q3Recorder::~q3Recorder() {
+    if (scene) scene->recorder = nullptr;
+}
+
+ErrOrVoid q3Recorder::Start(q3Scene* scene, FILE* file) {
+    debug::assert(this->scene == nullptr && scene->recorder == nullptr);
+    debug::assert(!scene->async_stepper.Busy());
+    if (file == nullptr) return Error::FileNotFound;
+
+    this->file = file;
+    this->scene = scene;
+    steps = 0;
+    failed = false;
+
+    q3RecordHeader header = {.magic = q3_record_magic, .version = q3_record_version};
+    if (fwrite(&header, sizeof(header), 1, file) != 1) failed = true;
+    settings = q3CaptureSettings(scene);
+    StaticWorld(scene->contact_manager.static_world);
+    Checkpoint();
+
+    scene->recorder = this;
+    if (failed) {
+        scene->recorder = nullptr;
+        this->scene = nullptr;
+        return Error::Unexpected;
+    }
+    return {};
+}
+
+ErrOrVoid q3Recorder::Stop() {
+    debug::assert(scene != nullptr);
+    debug::assert(!scene->async_stepper.Busy());
+    scene->recorder = nullptr;
+    scene = nullptr;
+    if (fflush(file) != 0) failed = true;
+    if (failed) return Error::Unexpected;
+    return {};
+}
+
+void q3Recorder::Write(q3RecordType type, const void* payload, usize size) {
+    if (fwrite(&type, 1, 1, file) != 1) failed = true;
+    if (size > 0 && fwrite(payload, size, 1, file) != 1) failed = true;
+}
+
+void q3Recorder::CreateBody(const q3Body* body, const q3BodyDef& def) {
+    q3CreateBodyRecord r = {};
+    r.id = body->id;
+    r.type = def.bodyType;
+    q3Put(r.axis, def.axis);
+    r.angle = def.angle;
+    q3Put(r.position, def.position);
+    q3Put(r.linear_velocity, def.linearVelocity);
+    q3Put(r.angular_velocity, def.angularVelocity);
+    r.gravity_scale = def.gravityScale;
+    r.linear_damping = def.linearDamping;
+    r.angular_damping = def.angularDamping;
+    Write(eRecordCreateBody, &r, sizeof(r));
+}
+
+void q3Recorder::RemoveBody(const q3Body* body) {
+    Write(eRecordRemoveBody, &body->id, sizeof(body->id));
+}
+
+void q3Recorder::RemoveAllBodies() {
+    Write(eRecordRemoveAllBodies, nullptr, 0);
+}
+
+void q3Recorder::SetBox(const q3Body* body, const q3BoxDef& def) {
+    q3SetBoxRecord r = {};
+    r.id = body->id;
+    q3Put(r.position, def.m_tx.position);
+    q3Put(r.rotation, def.m_tx.rotation);
+    q3Put(r.extent, def.m_e);
+    r.friction = def.m_friction;
+    r.restitution = def.m_restitution;
+    r.density = def.m_density;
+    r.sensor = def.m_sensor;
+    r.category_bits = def.m_categoryBits;
+    r.mask_bits = def.m_maskBits;
+    r.group_index = def.m_groupIndex;
+    Write(eRecordSetBox, &r, sizeof(r));
+}
+
+void q3Recorder::RemoveBox(const q3Body* body) {
+    Write(eRecordRemoveBox, &body->id, sizeof(body->id));
+}
+
+void q3Recorder::RemoveAllBoxes(const q3Body* body) {
+    Write(eRecordRemoveAllBoxes, &body->id, sizeof(body->id));
+}
+
+void q3Recorder::Command(const q3BodyCommand& command) {
+    q3CommandRecord r = {};
+    r.type = command.type;
+    r.id = command.body->id;
+    q3Put(r.a, command.a);
+    q3Put(r.b, command.b);
+    r.angle = command.angle;
+    Write(eRecordCommand, &r, sizeof(r));
+}
+
+void q3Recorder::StaticWorld(const q3StaticWorld* world) {
+    q3StaticWorldRecord r = {};
+    if (world) {
+        r.box_count = world->box_count;
+        r.node_count = world->node_count;
+        r.content_hash = world->ContentHash();
+    }
+    Write(eRecordStaticWorld, &r, sizeof(r));
+}
+
+void q3Recorder::Checkpoint() {
+    q3SceneState state(scene->allocator);
+    state.Capture(scene);
+    Write(eRecordCheckpoint, nullptr, 0);
+    if (state.Write(file).is_err()) failed = true;
+}
+
+void q3Recorder::BeginStep() {
+    q3SettingsRecord current = q3CaptureSettings(scene);
+    if (memcmp(&current, &settings, sizeof(current)) != 0) {
+        settings = current;
+        Write(eRecordSettings, &settings, sizeof(settings));
+    }
+    step_start = std::chrono::steady_clock::now();
+}
+
+void q3Recorder::EndStep() {
+    auto now = std::chrono::steady_clock::now();
+    q3StepRecord r = {};
+    r.step = steps++;
+    r.ms = std::chrono::duration<f64, std::milli>(now - step_start).count();
+    r.body_count = u32(scene->bodies.len);
+    r.contact_count = u32(scene->contact_manager.contacts.len);
+    r.state_hash = scene->deterministic ? scene->state_hash : 0;
+    Write(eRecordStep, &r, sizeof(r));
+}
+
+q3Replay::q3Replay(Allocator allocator) :
+    file(nullptr),
+    static_world(nullptr),
+    bodies(ArrayList<q3Body*>::init(allocator)) {}
+
+q3Replay::~q3Replay() {
+    bodies.deinit();
+}
+
+ErrOrVoid q3Replay::Open(FILE* file, const q3StaticWorld* static_world) {
+    if (file == nullptr) return Error::FileNotFound;
+    this->file = file;
+    this->static_world = static_world;
+    bodies.shrinkRetainingCapacity(0);
+
+    q3RecordHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1) return Error::UnexpectedEndOfFile;
+    if (header.magic != q3_record_magic || header.version != q3_record_version) {
+        return Error::ParseError;
+    }
+    return {};
+}
+
+ErrOr<q3Body*> q3Replay::Body(u32 id) const {
+    if (id >= bodies.items.len || bodies.items[id] == nullptr) return Error::ParseError;
+    return bodies.items[id];
+}
+
+void q3Replay::IndexBodies(const q3Scene* scene) {
+    bodies.resize(scene->next_body_id).unwrap();
+    for (q3Body*& body : bodies.items) body = nullptr;
+    for (q3Body* body : scene->bodies.ptrIter()) bodies.items[body->id] = body;
+}
+
+template <typename T>
+static ErrOrVoid q3ReadRecord(FILE* file, T* record) {
+    if (fread(record, sizeof(T), 1, file) != 1) return Error::UnexpectedEndOfFile;
+    return {};
+}
+
+ErrOr<bool> q3Replay::Next(q3Scene* scene, q3StepRecord* step) {
+    for (;;) {
+        u8 type;
+        if (fread(&type, 1, 1, file) != 1) {
+            if (feof(file)) return false;
+            return Error::Unexpected;
+        }
+
+        switch (type) {
+        case eRecordCheckpoint: {
+            try_expr(scene->Load(file));
+            IndexBodies(scene);
+        } break;
+
+        case eRecordCreateBody: {
+            q3CreateBodyRecord r;
+            try_expr(q3ReadRecord(file, &r));
+            if (r.id != scene->next_body_id || r.type > eKinematicBody) return Error::ParseError;
+            q3BodyDef def;
+            def.axis = q3GetVec3(r.axis);
+            def.angle = r.angle;
+            def.position = q3GetVec3(r.position);
+            def.linearVelocity = q3GetVec3(r.linear_velocity);
+            def.angularVelocity = q3GetVec3(r.angular_velocity);
+            def.gravityScale = r.gravity_scale;
+            def.linearDamping = r.linear_damping;
+            def.angularDamping = r.angular_damping;
+            def.bodyType = q3BodyType(r.type);
+            q3Body* body = scene->CreateBody(def);
+            bodies.append(body).unwrap();
+        } break;
+
+        case eRecordRemoveBody: {
+            u32 id;
+            try_expr(q3ReadRecord(file, &id));
+            q3Body* body = try_expr(Body(id));
+            scene->RemoveBody(body);
+            bodies.items[id] = nullptr;
+        } break;
+
+        case eRecordRemoveAllBodies: {
+            scene->RemoveAllBodies();
+            for (q3Body*& body : bodies.items) body = nullptr;
+        } break;
+
+        case eRecordSetBox: {
+            q3SetBoxRecord r;
+            try_expr(q3ReadRecord(file, &r));
+            q3Body* body = try_expr(Body(r.id));
+            q3BoxDef def;
+            def.m_tx.position = q3GetVec3(r.position);
+            def.m_tx.rotation = q3GetMat3(r.rotation);
+            def.m_e = q3GetVec3(r.extent);
+            def.m_friction = r.friction;
+            def.m_restitution = r.restitution;
+            def.m_density = r.density;
+            def.m_sensor = r.sensor != 0;
+            def.m_categoryBits = r.category_bits;
+            def.m_maskBits = r.mask_bits;
+            def.m_groupIndex = r.group_index;
+            body->SetBox(def);
+        } break;
+
+        case eRecordRemoveBox: {
+            u32 id;
+            try_expr(q3ReadRecord(file, &id));
+            q3Body* body = try_expr(Body(id));
+            body->RemoveBox();
+        } break;
+
+        case eRecordRemoveAllBoxes: {
+            u32 id;
+            try_expr(q3ReadRecord(file, &id));
+            q3Body* body = try_expr(Body(id));
+            body->RemoveAllBoxes();
+        } break;
+
+        case eRecordCommand: {
+            q3CommandRecord r;
+            try_expr(q3ReadRecord(file, &r));
+            if (r.type > q3BodyCommand::eSetTransform) return Error::ParseError;
+            q3BodyCommand command = {
+                .type = q3BodyCommand::Type(r.type),
+                .body = try_expr(Body(r.id)),
+                .a = q3GetVec3(r.a),
+                .b = q3GetVec3(r.b),
+                .angle = r.angle,
+            };
+            command.Apply();
+        } break;
+
+        case eRecordSettings: {
+            q3SettingsRecord r;
+            try_expr(q3ReadRecord(file, &r));
+            scene->dt = r.dt;
+            scene->gravity = q3GetVec3(r.gravity);
+            scene->iterations = r.iterations;
+            scene->substeps = r.substeps;
+            scene->position_iterations = r.position_iterations;
+            scene->enable_friction = r.enable_friction;
+            scene->enable_persist_events = r.enable_persist_events;
+            scene->enable_snapshots = r.enable_snapshots;
+            scene->deterministic = r.deterministic;
+        } break;
+
+        case eRecordStaticWorld: {
+            q3StaticWorldRecord r;
+            try_expr(q3ReadRecord(file, &r));
+            if (r.box_count == 0) {
+                scene->SetStaticWorld(nullptr);
+                break;
+            }
+            if (static_world == nullptr || static_world->box_count != r.box_count ||
+                static_world->node_count != r.node_count ||
+                static_world->ContentHash() != r.content_hash) {
+                return Error::ParseError;
+            }
+            scene->SetStaticWorld(static_world);
+        } break;
+
+        case eRecordStep: {
+            try_expr(q3ReadRecord(file, step));
+            return true;
+        }
+
+        default: return Error::ParseError;
+        }
+    }
+}
@@ -0,0 +1,216 @@
+/**
+@file	q3Recorder.h
+
+        This software is provided 'as-is', without any express or implied
+        warranty. In no event will the authors be held liable for any damages
+        arising from the use of this software.
+
+        Permission is granted to anyone to use this software for any purpose,
+        including commercial applications, and to alter it and redistribute it
+        freely, subject to the following restrictions:
+          1. The origin of this software must not be misrepresented; you must
+not claim that you wrote the original software. If you use this software in a
+product, an acknowledgment in the product documentation would be appreciated but
+is not required.
+          2. Altered source versions must be plainly marked as such, and must
+not be misrepresented as being the original software.
+          3. This notice may not be removed or altered from any source
+distribution.
+*/
+
+
+#pragma once
+
+#include <chrono>
+#include <stdio.h>
+
+#include "../common/q3Types.h"
+
+// Recording of everything a game does to a scene, for replaying a real session
+// offline (see demo/replay.cpp) to reproduce its performance spikes or to
+// compare engine builds on it:
+//
+//     q3Recorder recorder;
+//     recorder.Start(&scene, fopen("session.q3rc", "wb")).unwrap();
+//     ... // CreateBody, SetBox, ApplyLinearImpulse, SetTransform, Step ...
+//     recorder.Stop().unwrap();
+//
+// While recording, the scene and its bodies append a record for each body
+// creation and removal, box change, force, impulse, velocity and transform
+// write and step. The file is written as the session runs, nothing is kept in
+// memory. Forces queued on q3Scene::commands are recorded when a step applies
+// them. Changes to the public scene settings are picked up at the next step.
+//
+// File layout, all little endian:
+//
+//     q3RecordHeader
+//     records, each a u8 q3RecordType followed by its payload:
+//         eRecordCheckpoint        a q3Scene::Save file (see q3SceneState.h)
+//         eRecordCreateBody        q3CreateBodyRecord
+//         eRecordRemoveBody        u32 body id
+//         eRecordRemoveAllBodies   nothing
+//         eRecordSetBox            q3SetBoxRecord
+//         eRecordRemoveBox         u32 body id
+//         eRecordRemoveAllBoxes    u32 body id
+//         eRecordCommand           q3CommandRecord
+//         eRecordSettings          q3SettingsRecord
+//         eRecordStaticWorld       q3StaticWorldRecord
+//         eRecordStep              q3StepRecord
+//
+// Start writes the static world in use and a checkpoint, so a recording can
+// begin in the middle of a session. q3Scene::Load and RestoreState write
+// another checkpoint, since they change the scene without individual calls.
+
+constexpr u32 q3_record_magic = 0x43523351; // "Q3RC"
+constexpr u32 q3_record_version = 4;
+
+enum q3RecordType : u8 {
+    eRecordCheckpoint,
+    eRecordCreateBody,
+    eRecordRemoveBody,
+    eRecordRemoveAllBodies,
+    eRecordSetBox,
+    eRecordRemoveBox,
+    eRecordRemoveAllBoxes,
+    eRecordCommand,
+    eRecordSettings,
+    eRecordStaticWorld,
+    eRecordStep,
+};
+
+struct q3RecordHeader {
+    u32 magic;
+    u32 version;
+};
+
+struct q3CreateBodyRecord {
+    u32 id; // Checked on replay, the scene assigns the same one
+    u32 type; // q3BodyType
+    r32 axis[3];
+    r32 angle;
+    r32 position[3];
+    r32 linear_velocity[3];
+    r32 angular_velocity[3];
+    r32 gravity_scale;
+    r32 linear_damping;
+    r32 angular_damping;
+};
+
+struct q3SetBoxRecord {
+    u32 id;
+    r32 position[3];
+    r32 rotation[9];
+    r32 extent[3]; // Half extents, as in q3BoxDef::m_e
+    r32 friction;
+    r32 restitution;
+    r32 density;
+    u32 sensor;
+    u32 category_bits;
+    u32 mask_bits;
+    i32 group_index;
+};
+
+// A q3Body force, impulse, velocity or transform call
+struct q3CommandRecord {
+    u32 type; // q3BodyCommand::Type
+    u32 id;
+    r32 a[3];
+    r32 b[3];
+    r32 angle;
+};
+
+struct q3SettingsRecord {
+    r32 dt;
+    r32 gravity[3];
+    u32 iterations;
+    u32 substeps;
+    u32 position_iterations;
+    u8 enable_friction;
+    u8 enable_persist_events;
+    u8 enable_snapshots;
+    u8 deterministic;
+};
+
+// The static world attached by q3Scene::SetStaticWorld, identified by its size
+// and q3StaticWorld::ContentHash
+struct q3StaticWorldRecord {
+    u32 box_count; // Zero when detached
+    u32 node_count;
+    u64 content_hash;
+};
+
+struct q3StepRecord {
+    u64 step; // Steps since Start
+    f64 ms;   // Wall time of the step in the recorded session
+    u32 body_count;
+    u32 contact_count;
+    u64 state_hash; // q3Scene::state_hash, zero unless deterministic
+};
+
+struct q3Recorder {
+    FILE* file;
+    q3Scene* scene;
+    q3SettingsRecord settings; // Last written
+    u64 steps;
+    std::chrono::steady_clock::time_point step_start;
+    bool failed; // A write failed, reported by Stop
+
+    q3Recorder();
+    // Detaches from the scene if still recording
+    ~q3Recorder();
+
+    // Writes the header, the static world and a checkpoint of scene to file
+    // and records scene until Stop. The file stays owned by the caller.
+    ErrOrVoid Start(q3Scene* scene, FILE* file);
+    // Flushes the file and detaches from the scene. Error::Unexpected if any
+    // write failed since Start.
+    ErrOrVoid Stop();
+
+    // Called by the scene and its bodies while recording
+    void CreateBody(const q3Body* body, const q3BodyDef& def);
+    void RemoveBody(const q3Body* body);
+    void RemoveAllBodies();
+    void SetBox(const q3Body* body, const q3BoxDef& def);
+    void RemoveBox(const q3Body* body);
+    void RemoveAllBoxes(const q3Body* body);
+    void Command(const q3BodyCommand& command);
+    void StaticWorld(const q3StaticWorld* world);
+    void Checkpoint();
+    void BeginStep();
+    void EndStep();
+
+    void Write(q3RecordType type, const void* payload, usize size);
+};
+
+// Reads a recording back and replays it into a scene one step at a time:
+//
+//     q3Scene scene(1.0 / 60.0);
+//     q3Replay replay(scene.allocator);
+//     replay.Open(file).unwrap();
+//     q3StepRecord recorded;
+//     while (replay.Next(&scene, &recorded).unwrap()) scene.Step();
+//
+// Nothing but the records is needed, the first checkpoint recreates the bodies
+// and settings. Recordings of a scene with a static world need the same world.
+struct q3Replay {
+    FILE* file;
+    const q3StaticWorld* static_world;
+    ArrayList<q3Body*> bodies; // By id
+
+    q3Replay(Allocator allocator);
+    ~q3Replay();
+
+    // Reads the header. Error::ParseError for a file of another format or
+    // version.
+    ErrOrVoid Open(FILE* file, const q3StaticWorld* static_world = nullptr);
+    // Applies the records up to the next step to scene and reads that step's
+    // record into step, then the caller steps the scene. False at the end of
+    // the file. Error::ParseError for records that do not fit the scene, e.g.
+    // an unknown body or a static world other than the one given to Open.
+    ErrOr<bool> Next(q3Scene* scene, q3StepRecord* step);
+
+    // helper for `Next`, the body a record refers to
+    ErrOr<q3Body*> Body(u32 id) const;
+    // helper for `Next`, rebuilds bodies after a checkpoint
+    void IndexBodies(const q3Scene* scene);
+};
@@ -0,0 +1,130 @@
+/**
+@file	q3Rollback.cpp
+
+        This software is provided 'as-is', without any express or implied
+        warranty. In no event will the authors be held liable for any damages
+        arising from the use of this software.
+
+        Permission is granted to anyone to use this software for any purpose,
+        including commercial applications, and to alter it and redistribute it
+        freely, subject to the following restrictions:
+          1. The origin of this software must not be misrepresented; you must
+not claim that you wrote the original software. If you use this software in a
+product, an acknowledgment in the product documentation would be appreciated but
+is not required.
+          2. Altered source versions must be plainly marked as such, and must
+not be misrepresented as being the original software.
+          3. This notice may not be removed or altered from any source
+distribution.
+*/
+
+
+#include "q3Rollback.h"
+#include "q3Scene.h"
+#include "../debug/q3Trace.h"
+#include "../dynamics/q3Body.h"
+
+q3RollbackState::q3RollbackState(Allocator allocator) :
+    bodies(ArrayList<q3BodyState>::init(allocator)),
+    proxies(ArrayList<BoxInfo>::init(allocator)),
+    free_proxies(ArrayList<usize>::init(allocator)),
+    contacts(ArrayList<q3ContactConstraint>::init(allocator)),
+    state_hash(0) {}
+
+q3RollbackState::~q3RollbackState() {
+    bodies.deinit();
+    proxies.deinit();
+    free_proxies.deinit();
+    contacts.deinit();
+}
+
+void q3RollbackState::Save(const q3Scene* scene) {
+    Q3_TRACE_ZONE("SaveState", "contacts", i64(scene->contact_manager.contacts.len));
+    bodies.resize(scene->bodies.len).unwrap();
+    usize i = 0;
+    for (const q3Body* body : scene->bodies.ptrIter()) {
+        bodies.items[i++] = {
+            .tx = body->m_tx,
+            .q = body->m_q,
+            .worldCenter = body->m_worldCenter,
+            .linearVelocity = body->m_linearVelocity,
+            .angularVelocity = body->m_angularVelocity,
+            .force = body->m_force,
+            .torque = body->m_torque,
+            .invInertiaWorld = body->m_invInertiaWorld,
+            .id = body->id,
+        };
+    }
+
+    const q3BroadPhase* broadphase = &scene->contact_manager.m_broadphase;
+    proxies.shrinkRetainingCapacity(0);
+    if (broadphase->boxes.items.len > 0) proxies.appendSlice(broadphase->boxes.items).unwrap();
+    free_proxies.shrinkRetainingCapacity(0);
+    if (broadphase->unused_boxes.items.len > 0) {
+        free_proxies.appendSlice(broadphase->unused_boxes.items).unwrap();
+    }
+
+    contacts.resize(scene->contact_manager.contacts.len).unwrap();
+    i = 0;
+    for (const q3ContactConstraint* contact : scene->contact_manager.contacts.ptrIter()) {
+        contacts.items[i++] = *contact;
+    }
+
+    state_hash = scene->state_hash;
+}
+
+void q3RollbackState::Restore(q3Scene* scene) const {
+    Q3_TRACE_ZONE("RestoreState", "contacts", i64(contacts.items.len));
+    debug::assert(scene->bodies.len == bodies.items.len);
+
+    usize i = 0;
+    for (q3Body* body : scene->bodies.ptrIter()) {
+        const q3BodyState& state = bodies.items[i++];
+        debug::assert(body->id == state.id);
+        body->m_tx = state.tx;
+        body->m_q = state.q;
+        body->m_worldCenter = state.worldCenter;
+        body->m_linearVelocity = state.linearVelocity;
+        body->m_angularVelocity = state.angularVelocity;
+        body->m_force = state.force;
+        body->m_torque = state.torque;
+        body->m_invInertiaWorld = state.invInertiaWorld;
+        body->contact_edge_list = nullptr;
+    }
+    scene->static_body.contact_edge_list = nullptr;
+
+    q3BroadPhase* broadphase = &scene->contact_manager.m_broadphase;
+    debug::assert(broadphase->boxes.items.len == proxies.items.len);
+    broadphase->boxes.shrinkRetainingCapacity(0);
+    if (proxies.items.len > 0) broadphase->boxes.appendSlice(proxies.items).unwrap();
+    broadphase->unused_boxes.shrinkRetainingCapacity(0);
+    if (free_proxies.items.len > 0) {
+        broadphase->unused_boxes.appendSlice(free_proxies.items).unwrap();
+    }
+
+    // The contact nodes are reused, only the difference in count is
+    // allocated or freed. The head is always found first by remove().
+    LinkedList<q3ContactConstraint>* list = &scene->contact_manager.contacts;
+    while (list->len > contacts.items.len) list->remove(list->head.unwrap());
+    while (list->len < contacts.items.len) list->prepend({}).unwrap();
+
+    using Node = LinkedList<q3ContactConstraint>::Node;
+    Opt<Node*> tail = Null;
+    i = 0;
+    for (Opt<Node*> node = list->head; node.is_not_null(); node = node.unwrap()->next) {
+        node.unwrap()->data = contacts.items[i++];
+        tail = node;
+    }
+
+    // Edges were prepended when their contacts were created, so relinking
+    // them from the last contact to the first recreates every edge list
+    for (Opt<Node*> node = tail; node.is_not_null(); node = node.unwrap()->prev) {
+        q3ContactConstraint* contact = &node.unwrap()->data;
+        contact->edgeA.constraint = contact;
+        contact->bodyA->linkEdgeIntoList(&contact->edgeA);
+        contact->edgeB.constraint = contact;
+        contact->bodyB->linkEdgeIntoList(&contact->edgeB);
+    }
+
+    scene->state_hash = state_hash;
+}
@@ -0,0 +1,66 @@
+/**
+@file	q3Rollback.h
+
+        This software is provided 'as-is', without any express or implied
+        warranty. In no event will the authors be held liable for any damages
+        arising from the use of this software.
+
+        Permission is granted to anyone to use this software for any purpose,
+        including commercial applications, and to alter it and redistribute it
+        freely, subject to the following restrictions:
+          1. The origin of this software must not be misrepresented; you must
+not claim that you wrote the original software. If you use this software in a
+product, an acknowledgment in the product documentation would be appreciated but
+is not required.
+          2. Altered source versions must be plainly marked as such, and must
+not be misrepresented as being the original software.
+          3. This notice may not be removed or altered from any source
+distribution.
+*/
+
+
+#pragma once
+
+#include "../broadphase/q3BroadPhase.h"
+#include "../common/q3Types.h"
+#include "../dynamics/q3Contact.h"
+#include "../math/q3Math.h"
+
+// Dynamic state of a scene for rollback networking, see q3Scene::SaveState.
+// Unlike q3SceneState nothing is encoded: the body state, the broadphase
+// proxies and the contacts are copied as they are, and restoring reuses the
+// scene's bodies and contact nodes. Keep a ring of these (one per frame of
+// the rollback window); after the first few saves the arrays have grown to
+// size and saving or restoring no longer allocates.
+//
+// The state refers to the scene's bodies by address, so it can only be
+// restored into the scene it was saved from and no body may be created or
+// removed in between (asserted). Queued commands are input, not state, and
+// are not saved.
+
+// Everything about a body that Step changes
+struct q3BodyState {
+    q3Transform tx;
+    q3Quaternion q;
+    q3Vec3 worldCenter;
+    q3Vec3 linearVelocity;
+    q3Vec3 angularVelocity;
+    q3Vec3 force;
+    q3Vec3 torque;
+    q3Mat3 invInertiaWorld;
+    u32 id;
+};
+
+struct q3RollbackState {
+    ArrayList<q3BodyState> bodies;    // In q3Scene::bodies order
+    ArrayList<BoxInfo> proxies;       // q3BroadPhase::boxes
+    ArrayList<usize> free_proxies;    // q3BroadPhase::unused_boxes
+    ArrayList<q3ContactConstraint> contacts; // In contact list order
+    u64 state_hash;
+
+    q3RollbackState(Allocator allocator);
+    ~q3RollbackState();
+
+    void Save(const q3Scene* scene);
+    void Restore(q3Scene* scene) const;
+};
@@ -24,6 +24,7 @@ distribution.
 */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "q3Scene.h"
 #include "../collision/q3Box.h"
@@ -31,22 +32,45 @@ distribution.
 #include "../dynamics/q3Contact.h"
 #include "../dynamics/q3Island.h"
 #include "../debug/q3Render.h"
+#include "../debug/q3Trace.h"
 
 q3Scene::q3Scene(r32 dt, const q3Vec3& gravity, usize iterations) :
     allocator(),
-    contact_manager(allocator),
-    bodies(LinkedList<q3Body>::init(allocator)),
-    gravity(gravity),
     dt(dt),
+    gravity(gravity),
     new_box(false),
     enable_friction(true),
-    iterations(iterations) {}
+    iterations(iterations),
+    substeps(1),
+    position_iterations(0),
+    enable_persist_events(false),
+    enable_snapshots(false),
+    jobs(nullptr),
+    deterministic(false),
+    state_hash(0),
+    next_body_id(0),
+    contact_manager(allocator),
+    bodies(LinkedList<q3Body>::init(allocator)),
+    islands(ArrayList<q3Island>::init(allocator)),
+    static_body(q3BodyDef(), this),
+    snapshots(allocator),
+    commands(allocator),
+    async_stepper(allocator),
+    recorder(nullptr) {
+    Q3_STATS(stats = {});
+    static_body.id = ~u32(0);
+    static_body.CalculateMassData();
+}
 
 q3Scene::~q3Scene() {
+    async_stepper.Shutdown();
     RemoveAllBodies();
+    for (q3Island& island : islands.items) island.deinit();
+    islands.deinit();
 }
 
 void q3Scene::BuildIsland(q3Island* island, q3Body* seed) {
+    Q3_TRACE_ZONE("BuildIsland");
     seed->flags.Island = true; // Mark seed as apart of island
 
     auto stack = ArrayList<q3Body*>::init(allocator);
@@ -54,7 +78,9 @@ void q3Scene::BuildIsland(q3Island* island, q3Body* seed) {
     stack.append(seed).unwrap();
 
     island->bodies.shrinkRetainingCapacity(0);
+    island->velocities.shrinkRetainingCapacity(0);
     island->contacts.shrinkRetainingCapacity(0);
+    island->contact_states.shrinkRetainingCapacity(0);
 
     // Perform DFS on constraint graph
     while (stack.items.len > 0) {
@@ -97,145 +123,485 @@ void q3Scene::BuildIsland(q3Island* island, q3Body* seed) {
 }
 
 void q3Scene::Step() {
-    contact_manager.TestCollisions();
+    debug::assert(!async_stepper.Busy());
+    commands.Apply();
+    Simulate();
+}
 
-    for (q3Body* body : bodies.ptrIter()) body->flags.Island = false;
+q3StepToken q3Scene::StepAsync() {
+    async_stepper.Wait(q3StepToken{async_stepper.requested});
+    commands.Apply();
+    return async_stepper.Launch(this);
+}
+
+bool q3Scene::IsStepDone(q3StepToken token) const {
+    return async_stepper.IsDone(token);
+}
 
-    q3Island island = q3Island::init(allocator, dt, gravity, iterations, enable_friction);
-    defer(island.deinit());
-    island.bodies.ensureTotalCapacity(bodies.len).unwrap();
-    island.velocities.ensureTotalCapacity(bodies.len).unwrap();
-    island.contacts.ensureTotalCapacity(contact_manager.contacts.len).unwrap();
-    island.contact_states.ensureTotalCapacity(contact_manager.contacts.len).unwrap();
+void q3Scene::WaitStep(q3StepToken token) {
+    async_stepper.Wait(token);
+}
+
+Slice<q3BodyTransform> q3Scene::FrontTransforms() const {
+    return async_stepper.front.items;
+}
 
-    // Build each active island and then solve each built island
+#ifdef Q3_STEP_STATS
+// Sums the solve phases the islands timed on their own. With jobs these are
+// thread times added up over the islands, which can exceed the wall time.
+static void q3AddIslandStats(q3StepStats* sum, const q3Island* islands, u32 count) {
+    for (u32 i = 0; i < count; ++i) {
+        const q3StepStats& island = islands[i].stats;
+        sum->island_integrate += island.island_integrate;
+        sum->island_presolve += island.island_presolve;
+        sum->island_iterations += island.island_iterations;
+        sum->island_writeback += island.island_writeback;
+        sum->island_positions += island.island_positions;
+        sum->island_contacts += island.island_contacts;
+        sum->manifold_points += island.manifold_points;
+    }
+}
+#endif
+
+void q3Scene::Simulate() {
+    Q3_TRACE_ZONE("Step", "bodies", i64(bodies.len));
+    if (recorder) recorder->BeginStep();
+    Q3_STATS(stats = {});
+    Q3_STATS(usize alloc_calls_before = allocator_stats.alloc_calls);
+    Q3_STATS(usize free_calls_before = allocator_stats.free_calls);
+    Q3_STATS(q3StatsTimer step_timer);
+    Q3_STATS(q3StatsTimer timer);
+
+    contact_manager.TestCollisions(jobs);
+    Q3_STATS(stats.test_collisions = timer.Lap());
+    Q3_STATS(stats.contacts = contact_manager.contacts.len);
+
+    for (q3Body* body : bodies.ptrIter()) body->flags.Island = false;
+
+    // Build every island first. Initialize copies the island indices of the
+    // bodies right away, since a static body is in several islands and its
+    // m_islandIndex is only valid for the last one built.
+    u32 island_count = 0;
     for (q3Body* seed : bodies.ptrIter()) {
         if (seed->flags.Island) continue; // Seed can't be part of an island already
         // Seed cannot be a static body in order to keep islands as small as possible
         if (seed->flags.Static) continue;
 
-        BuildIsland(&island, seed);
-        debug::assert(island.bodies.items.len != 0);
-
-        island.Initialize();
-        island.Solve();
+        if (island_count == islands.items.len) {
+            islands.append(q3Island::init(allocator, dt, gravity, iterations, enable_friction))
+                .unwrap();
+        }
+        q3Island* island = &islands.items[island_count++];
+        island->dt = dt;
+        island->gravity = gravity;
+        island->iterations = iterations;
+        island->substeps = substeps;
+        island->position_iterations = position_iterations;
+        island->enable_friction = enable_friction;
+        island->jobs = jobs;
+        Q3_STATS(island->stats = {});
+
+        BuildIsland(island, seed);
+        debug::assert(island->bodies.items.len != 0);
+        Q3_STATS(stats.islands += 1);
+
+        island->Initialize();
 
         // Reset all static island flags
         // This allows static bodies to participate in other island formations
-        for (auto body : island.bodies.items) {
+        for (auto body : island->bodies.items) {
             if (body->flags.Static) body->flags.Island = false;
         }
     }
+    Q3_STATS(stats.island_build += timer.Lap());
+
+    // Islands share no dynamic bodies or contacts and static bodies are only
+    // read, so they are solved in parallel with the same results in any order
+    {
+        Q3_TRACE_ZONE("SolveIslands", "islands", i64(island_count));
+        q3ParallelFor(jobs, island_count, 1, [this](u32 begin, u32 end, u32 worker) {
+            for (u32 i = begin; i < end; ++i) islands.items[i].Solve();
+        });
+    }
+    Q3_STATS(timer.Lap()); // The islands time their own phases
+    Q3_STATS(q3AddIslandStats(&stats, islands.items.ptr, island_count));
+
+    // Impulses are final now, so this is where contact events are reported
+    contact_manager.ReportContactEvents(enable_persist_events);
+    Q3_STATS(stats.contact_events = timer.Lap());
 
     // Update the broadphase AABBs
-    for (q3Body* body : bodies.ptrIter()) {
-        if (body->flags.Static) continue;
-        body->SynchronizeProxies();
+    {
+        Q3_TRACE_ZONE("SynchronizeProxies");
+        for (q3Body* body : bodies.ptrIter()) {
+            if (body->flags.Static) continue;
+            body->SynchronizeProxies();
+        }
     }
+    Q3_STATS(stats.synchronize_proxies = timer.Lap());
 
     // Look for new contacts
-    contact_manager.FindNewContacts();
+    Q3_STATS(usize contacts_before = contact_manager.contacts.len);
+    contact_manager.FindNewContacts(jobs, deterministic);
+    Q3_STATS(stats.find_new_contacts = timer.Lap());
+    Q3_STATS(stats.pairs = contact_manager.m_broadphase.pairs.items.len);
+    Q3_STATS(stats.new_contacts = contact_manager.contacts.len - contacts_before);
 
     // Clear all forces
     for (q3Body* body : bodies.ptrIter()) {
         q3Identity(body->m_force);
         q3Identity(body->m_torque);
     }
+
+    if (deterministic) state_hash = StateHash();
+
+    if (enable_snapshots) {
+        Q3_TRACE_ZONE("PublishSnapshot");
+        snapshots.Publish(&contact_manager.m_broadphase);
+    }
+
+    Q3_STATS(stats.bodies = bodies.len);
+    Q3_STATS(stats.total = step_timer.Lap());
+
+    Q3_STATS(q3BroadPhase* broadphase = &contact_manager.m_broadphase);
+    Q3_STATS(stats.proxies_inserted = broadphase->proxies_inserted);
+    Q3_STATS(stats.proxies_removed = broadphase->proxies_removed);
+    Q3_STATS(stats.proxies_moved = broadphase->proxies_moved);
+    Q3_STATS(broadphase->proxies_inserted = 0);
+    Q3_STATS(broadphase->proxies_removed = 0);
+    Q3_STATS(broadphase->proxies_moved = 0);
+
+    Q3_STATS(stats.alloc_calls = allocator_stats.alloc_calls - alloc_calls_before);
+    Q3_STATS(stats.free_calls = allocator_stats.free_calls - free_calls_before);
+    Q3_STATS(stats.live_bytes = allocator_stats.live_bytes);
+
+    if (recorder) recorder->EndStep();
 }
 
 q3Body* q3Scene::CreateBody(const q3BodyDef& def) {
+    debug::assert(!async_stepper.Busy());
     q3Body* body = &bodies.prepend(q3Body(def, this)).unwrap()->data;
+    body->id = next_body_id++;
+    if (recorder) recorder->CreateBody(body, def);
     return body;
 }
 
 void q3Scene::RemoveBody(q3Body* body) {
     debug::assert(bodies.len > 0);
+    debug::assert(!async_stepper.Busy());
+    if (recorder) recorder->RemoveBody(body);
+    commands.RemoveBody(body);
     contact_manager.RemoveContactsFromBody(body);
-    body->RemoveAllBoxes();
+    contact_manager.RemoveFromBroadphase(body);
     bodies.remove(body);
 }
 
 void q3Scene::RemoveAllBodies() {
-    auto opt_node = bodies.head;
-    while (opt_node.is_not_null()) {
-        auto opt_next = opt_node.unwrap()->next;
-        q3Body* body = &opt_node.unwrap()->data;
-        body->RemoveAllBoxes();
-        bodies.remove(body);
-        opt_node = opt_next;
+    // Removing bodies (and their contacts) one at a time is quadratic since
+    // list removal is O(n), so the contacts and bodies are dropped wholesale
+    debug::assert(!async_stepper.Busy());
+    if (recorder) recorder->RemoveAllBodies();
+    commands.commands.shrinkRetainingCapacity(0);
+    contact_manager.RemoveAllContacts();
+    for (q3Body* body : bodies.ptrIter()) contact_manager.RemoveFromBroadphase(body);
+
+    bodies.deinit();
+    bodies = LinkedList<q3Body>::init(allocator);
+}
+
+ErrOrVoid q3Scene::Save(FILE* file) const {
+    debug::assert(!async_stepper.Busy());
+    q3SceneState state(allocator);
+    state.Capture(this);
+    return state.Write(file);
+}
+
+ErrOrVoid q3Scene::Load(FILE* file) {
+    debug::assert(!async_stepper.Busy());
+    q3SceneState state(allocator);
+    try_expr(state.Read(file));
+    if (!state.MatchesStaticWorld(this)) return Error::ParseError;
+    try_expr(state.Restore(this));
+    if (recorder) recorder->Checkpoint();
+    return {};
+}
+
+void q3Scene::SaveState(q3RollbackState* state) const {
+    debug::assert(!async_stepper.Busy());
+    state->Save(this);
+}
+
+void q3Scene::RestoreState(const q3RollbackState& state) {
+    debug::assert(!async_stepper.Busy());
+    state.Restore(this);
+    if (recorder) recorder->Checkpoint();
+}
+
+static u64 q3HashBits(u64 hash, r32 value) {
+    u32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    for (i32 i = 0; i < 4; ++i) {
+        hash ^= (bits >> (i * 8)) & 0xff;
+        hash *= 0x100000001b3ull;
     }
+    return hash;
+}
+
+static u64 q3HashVec3(u64 hash, const q3Vec3& v) {
+    hash = q3HashBits(hash, v.x);
+    hash = q3HashBits(hash, v.y);
+    return q3HashBits(hash, v.z);
+}
+
+u64 q3Scene::StateHash() const {
+    u64 hash = 0xcbf29ce484222325ull;
+    for (const q3Body* body : bodies.ptrIter()) {
+        for (i32 i = 0; i < 4; ++i) {
+            hash ^= (body->id >> (i * 8)) & 0xff;
+            hash *= 0x100000001b3ull;
+        }
+        hash = q3HashVec3(hash, body->m_tx.position);
+        for (i32 i = 0; i < 4; ++i) hash = q3HashBits(hash, body->m_q.v[i]);
+        hash = q3HashVec3(hash, body->m_linearVelocity);
+        hash = q3HashVec3(hash, body->m_angularVelocity);
+    }
+    return hash;
+}
+
+void q3Scene::SetStaticWorld(const q3StaticWorld* world) {
+    debug::assert(!async_stepper.Busy());
+    contact_manager.SetStaticWorld(world, &static_body);
+    if (recorder) recorder->StaticWorld(world);
+}
+
+Slice<q3SensorEvent> q3Scene::SensorEvents() const {
+    return contact_manager.sensor_events.items;
+}
+
+Slice<q3ContactEvent> q3Scene::ContactEvents() const {
+    return contact_manager.contact_events.items;
 }
 
 void q3Scene::QueryAABB(q3QueryCallback* cb, const q3AABB& aabb) {
+    QueryAABB(aabb, [cb](q3Box* box) { return cb->ReportShape(box); });
+}
+
+usize q3Scene::QueryAABB(const q3AABB& aabb, Slice<q3Box*> results) {
+    usize count = 0;
+    QueryAABB(aabb, [&](q3Box* box) {
+        if (count < results.len) results[count] = box;
+        count += 1;
+        return true;
+    });
+    return count;
+}
+
+void q3Scene::QueryPoint(q3QueryCallback* cb, const q3Vec3& point) {
+    // The callback's return value has never stopped point queries
+    QueryPoint(point, [cb](q3Box* box) {
+        cb->ReportShape(box);
+        return true;
+    });
+}
+
+void q3Scene::RayCast(q3QueryCallback* cb, q3RaycastData& rayCast) {
     struct SceneQueryWrapper {
         bool TreeCallBack(i32 id) {
-            q3AABB aabb;
-            q3Box* box = broadPhase->GetBoxInfo(id).box;
-
-            box->ComputeAABB(box->body->m_tx, &aabb);
+            return Report(broadPhase->GetBoxInfo(id).box);
+        }
 
-            if (q3AABBtoAABB(m_aabb, aabb)) { return cb->ReportShape(box); }
+        bool Report(q3Box* box) {
+            if (box->Raycast(box->body->m_tx, m_rayCast)) { more = cb->ReportShape(box); }
 
-            return true;
+            return more;
         }
 
         q3QueryCallback* cb;
         q3BroadPhase* broadPhase;
-        q3AABB m_aabb;
+        q3RaycastData* m_rayCast;
+        bool more;
     };
 
     SceneQueryWrapper wrapper;
-    wrapper.m_aabb = aabb;
+    wrapper.m_rayCast = &rayCast;
     wrapper.broadPhase = &contact_manager.m_broadphase;
     wrapper.cb = cb;
-    contact_manager.m_broadphase.Query(&wrapper, aabb);
+    wrapper.more = true;
+    contact_manager.m_broadphase.Query(&wrapper, rayCast);
+
+    const q3StaticWorld* world = contact_manager.static_world;
+    if (!wrapper.more || world == nullptr) return;
+    world->QuerySegment(rayCast, q3Vec3(r32(0.0), r32(0.0), r32(0.0)), [&](u32 index) {
+        return wrapper.Report(contact_manager.StaticProxy(index));
+    });
 }
 
-void q3Scene::QueryPoint(q3QueryCallback* cb, const q3Vec3& point) {
+q3Box* q3Scene::RayCastClosest(q3RaycastData& rayCast) {
     struct SceneQueryWrapper {
         bool TreeCallBack(i32 id) {
-            q3Box* box = broadPhase->GetBoxInfo(id).box;
-            if (box->TestPoint(box->body->m_tx, m_point)) { cb->ReportShape(box); }
+            return Report(broadPhase->GetBoxInfo(id).box);
+        }
+
+        bool Report(q3Box* box) {
+            // Raycast only hits before rayCast.t, so every hit is the closest yet
+            if (box->Raycast(box->body->m_tx, m_rayCast)) {
+                closest = box;
+                m_rayCast->t = m_rayCast->toi;
+            }
+
             return true;
         }
 
-        q3QueryCallback* cb;
         q3BroadPhase* broadPhase;
-        q3Vec3 m_point;
+        q3RaycastData* m_rayCast;
+        q3Box* closest;
     };
 
+    r32 t = rayCast.t;
+    rayCast.toi = t;
+    rayCast.normal.Set(r32(0.0), r32(0.0), r32(0.0));
+
     SceneQueryWrapper wrapper;
-    wrapper.m_point = point;
+    wrapper.m_rayCast = &rayCast;
     wrapper.broadPhase = &contact_manager.m_broadphase;
-    wrapper.cb = cb;
-    const r32 k_fattener = r32(0.5);
-    q3Vec3 v(k_fattener, k_fattener, k_fattener);
-    q3AABB aabb;
-    aabb.min = point - v;
-    aabb.max = point + v;
-    contact_manager.m_broadphase.Query(&wrapper, aabb);
+    wrapper.closest = nullptr;
+    contact_manager.m_broadphase.Query(&wrapper, rayCast);
+
+    // The ray is already clipped at the closest body hit
+    if (const q3StaticWorld* world = contact_manager.static_world) {
+        world->QuerySegment(rayCast, q3Vec3(r32(0.0), r32(0.0), r32(0.0)), [&](u32 index) {
+            return wrapper.Report(contact_manager.StaticProxy(index));
+        });
+    }
+
+    rayCast.t = t;
+    return wrapper.closest;
 }
 
-void q3Scene::RayCast(q3QueryCallback* cb, q3RaycastData& rayCast) {
+q3Box* q3Scene::BoxCast(q3BoxCastData& cast) {
     struct SceneQueryWrapper {
         bool TreeCallBack(i32 id) {
-            q3Box* box = broadPhase->GetBoxInfo(id).box;
+            return Report(broadPhase->GetBoxInfo(id).box);
+        }
+
+        bool Report(q3Box* box) {
+            if ((box->categoryBits & m_cast->maskBits) == 0) return true;
 
-            if (box->Raycast(box->body->m_tx, m_rayCast)) { return cb->ReportShape(box); }
+            // Like RayCastClosest the sweep is clipped at every hit
+            q3Transform world = q3Mul(box->body->m_tx, box->local);
+            if (q3BoxCastOBB(world, box->e, m_cast)) {
+                closest = box;
+                m_cast->t = m_cast->toi;
+                m_sweep->t = m_cast->toi;
+            }
 
             return true;
         }
 
-        q3QueryCallback* cb;
         q3BroadPhase* broadPhase;
-        q3RaycastData* m_rayCast;
+        q3BoxCastData* m_cast;
+        q3RaycastData* m_sweep;
+        q3Box* closest;
     };
 
+    r32 t = cast.t;
+    cast.toi = t;
+    cast.normal.Set(r32(0.0), r32(0.0), r32(0.0));
+
+    // The broadphase sweeps the world AABB of the box along its center
+    const q3Mat3& r = cast.tx.rotation;
+    q3Vec3 extent = q3Abs(r[0]) * cast.e.x + q3Abs(r[1]) * cast.e.y + q3Abs(r[2]) * cast.e.z;
+    q3RaycastData sweep;
+    sweep.Set(cast.tx.position, cast.dir, t);
+
     SceneQueryWrapper wrapper;
-    wrapper.m_rayCast = &rayCast;
     wrapper.broadPhase = &contact_manager.m_broadphase;
-    wrapper.cb = cb;
-    contact_manager.m_broadphase.Query(&wrapper, rayCast);
+    wrapper.m_cast = &cast;
+    wrapper.m_sweep = &sweep;
+    wrapper.closest = nullptr;
+    contact_manager.m_broadphase.Query(&wrapper, sweep, extent);
+
+    if (const q3StaticWorld* world = contact_manager.static_world) {
+        world->QuerySegment(sweep, extent, [&](u32 index) {
+            return wrapper.Report(contact_manager.StaticProxy(index));
+        });
+    }
+
+    cast.t = t;
+    return wrapper.closest;
+}
+
+void q3Scene::RayCastBatch(Slice<q3RaycastData> rays, Slice<q3RayHit> hits) {
+    debug::assert(hits.len >= rays.len);
+
+    struct PacketQueryWrapper {
+        bool TreeCallBack(i32 id, u32 lanes) {
+            q3Box* box = broadPhase->GetBoxInfo(id).box;
+            q3Float4 toi;
+            q3Float4 normal[3];
+            lanes = box->RaycastPacket(box->body->m_tx, *packet, lanes, &toi, normal);
+            if (!lanes) return true;
+
+            r32 toiLanes[4];
+            r32 normalLanes[3][4];
+            q3SimdStore(toiLanes, toi);
+            for (i32 i = 0; i < 3; ++i) q3SimdStore(normalLanes[i], normal[i]);
+
+            // Only hits closer than the packet t are reported, so every one
+            // replaces the lane's closest hit
+            for (i32 lane = 0; lane < 4; ++lane) {
+                if (!(lanes & (1 << lane))) continue;
+                q3RayHit* hit = hits + lane;
+                hit->box = box;
+                hit->toi = toiLanes[lane];
+                hit->normal.Set(normalLanes[0][lane], normalLanes[1][lane], normalLanes[2][lane]);
+                t[lane] = toiLanes[lane];
+            }
+            packet->t = q3SimdLoad(t);
+
+            return true;
+        }
+
+        q3BroadPhase* broadPhase;
+        q3RayPacket* packet;
+        q3RayHit* hits;
+        r32 t[4];
+    };
+
+    for (usize first = 0; first < rays.len; first += 4) {
+        i32 count = rays.len - first < 4 ? i32(rays.len - first) : 4;
+
+        q3RayPacket packet;
+        packet.Set(rays.ptr + first, count);
+
+        PacketQueryWrapper wrapper;
+        wrapper.broadPhase = &contact_manager.m_broadphase;
+        wrapper.packet = &packet;
+        wrapper.hits = hits.ptr + first;
+        q3SimdStore(wrapper.t, packet.t);
+
+        // Padding lanes of the last packet never hit, so they are never written
+        for (i32 i = 0; i < count; ++i) {
+            wrapper.hits[i] = q3RayHit{nullptr, rays[first + i].t, q3Vec3(0, 0, 0)};
+        }
+
+        contact_manager.m_broadphase.Query(&wrapper, packet);
+
+        const q3StaticWorld* world = contact_manager.static_world;
+        for (i32 i = 0; world && i < count; ++i) {
+            q3RayHit* hit = wrapper.hits + i;
+            q3RaycastData ray = rays[first + i];
+            ray.t = hit->toi;
+            world->QuerySegment(ray, q3Vec3(r32(0.0), r32(0.0), r32(0.0)), [&](u32 index) {
+                q3Box* box = contact_manager.StaticProxy(index);
+                if (box->Raycast(box->body->m_tx, &ray)) {
+                    *hit = q3RayHit{box, ray.toi, ray.normal};
+                    ray.t = ray.toi;
+                }
+                return true;
+            });
+        }
+    }
 }
 
 void q3Scene::Render(q3Render* render) {
@@ -245,10 +611,7 @@ void q3Scene::Render(q3Render* render) {
         5, 7, 8,     5, 8, 6,     1, 5, 6,     1, 6, 2,     2, 6, 8,     2, 8, 4,
     };
     // clang-format on
-    for (q3Body* body : bodies.ptrIter()) {
-        const auto box = &body->box;
-        q3Transform world = q3Mul(body->m_tx, box->local);
-        const auto e = box->e;
+    auto render_box = [render, &box_indices](const q3Transform& world, const q3Vec3& e) {
         const q3Vec3 vertices[8] = {q3Vec3(-e.x, -e.y, -e.z), q3Vec3(-e.x, -e.y, e.z),
                                     q3Vec3(-e.x, e.y, -e.z),  q3Vec3(-e.x, e.y, e.z),
                                     q3Vec3(e.x, -e.y, -e.z),  q3Vec3(e.x, -e.y, e.z),
@@ -261,6 +624,14 @@ void q3Scene::Render(q3Render* render) {
             render->SetTriNormal(n.x, n.y, n.z);
             render->Triangle(a.x, a.y, a.z, b.x, b.y, b.z, c.x, c.y, c.z);
         }
+    };
+    for (q3Body* body : bodies.ptrIter()) {
+        render_box(q3Mul(body->m_tx, body->box.local), body->box.e);
+    }
+    if (const q3StaticWorld* world = contact_manager.static_world) {
+        for (u32 i = 0; i < world->box_count; ++i) {
+            render_box(world->boxes[i].GetTransform(), world->boxes[i].GetExtent());
+        }
     }
 
     for (auto contact : contact_manager.contacts.iter()) {
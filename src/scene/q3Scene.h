@@ -27,9 +27,19 @@ distribution.
 
 #include <stdio.h>
 
+#include "../common/q3Jobs.h"
 #include "../common/q3Types.h"
 #include "../math/q3Math.h"
+#include "../dynamics/q3Body.h"
 #include "../dynamics/q3ContactManager.h"
+#include "../dynamics/q3Island.h"
+#include "../debug/q3StepStats.h"
+#include "q3AsyncStep.h"
+#include "q3Recorder.h"
+#include "q3Rollback.h"
+#include "q3SceneSnapshot.h"
+#include "q3SceneState.h"
+#include "q3StaticWorld.h"
 
 struct q3QueryCallback {
     virtual ~q3QueryCallback() {}
@@ -49,8 +59,59 @@ struct q3Scene {
     // Scene.Step(). Decreasing the iterations makes the simulation less
     // realistic (convergent). A good iteration number range is 5 to 20.
     usize iterations;
+    // Splits the solver part of Step() into this many substeps (TGS style)
+    // when more than one. Every substep integrates the bodies over dt /
+    // substeps and runs `iterations` velocity iterations plus one relax
+    // iteration, reusing the contact points found at the start of the step,
+    // so tall stacks settle with 1 or 2 iterations and 4 to 8 substeps where
+    // a single step needs 20 iterations. The accumulated contact impulses
+    // (also those of contact events) are then per substep.
+    usize substeps;
+    // Position iterations run after the velocity iterations and the position
+    // integration (split impulse). When not zero, penetration is no longer
+    // fed into the contact velocities with a Baumgarte bias but resolved by
+    // moving the bodies directly, so pushing boxes apart adds no kinetic
+    // energy and impacts do not pop them apart. 2 to 4 are enough, the
+    // iterations stop early once no contact is deeper than three times the
+    // penetration slop. Ignored when sub-stepping, whose substeps already
+    // push out from separations updated by the motion of the bodies.
+    usize position_iterations;
+    // Begin and end contact events are always reported. Persist events are
+    // one event per touching contact per step, so they are opt-in.
+    bool enable_persist_events;
+    // Publish a q3SceneSnapshots snapshot at the end of every Step() for
+    // queries from other threads. Costs one world transform per box.
+    bool enable_snapshots;
+    // Runs the broadphase, narrowphase, island solve and per-body integration
+    // loops of Step() on a q3JobSystem or the game's own q3JobInterface. The
+    // islands are solved in parallel with each other, the contact iterations
+    // of one island stay on one thread, so a scene that is a single island
+    // (e.g. one big stack) only gets its per-body loops spread. Null (the
+    // default) runs everything on the calling thread. Either way the
+    // simulation produces the same results.
+    q3JobInterface* jobs;
+    // Orders new contacts by body id instead of by broadphase proxy index, so
+    // two scenes built by the same calls step identically even if their proxy
+    // slots were reused differently (e.g. after removing bodies), and stores
+    // StateHash() in state_hash after every step for lockstep checks.
+    bool deterministic;
+    u64 state_hash;
+    // Id of the next body created
+    u32 next_body_id;
     q3ContactManager contact_manager;
     LinkedList<q3Body> bodies;
+    // Islands of the last Step(), kept so their arrays keep their capacity
+    ArrayList<q3Island> islands;
+    // Body of the static world boxes (see SetStaticWorld), not in bodies
+    q3Body static_body;
+    q3SceneSnapshots snapshots;
+    // Body writes deferred to the start of the next Step() or StepAsync()
+    q3CommandQueue commands;
+    q3AsyncStepper async_stepper;
+    // Set by q3Recorder::Start while the scene is being recorded
+    q3Recorder* recorder;
+    // Phase timings and counters of the last Step(), only with -DQ3_STEP_STATS
+    Q3_STATS(q3StepStats stats;)
 
     q3Scene(
         r32 dt, const q3Vec3& gravity = q3Vec3(r32(0.0), r32(-9.8), r32(0.0)), usize iterations = 20
@@ -58,8 +119,30 @@ struct q3Scene {
     ~q3Scene();
 
     // Run the simulation forward in time by dt (fixed timestep). Variable
-    // timestep is not supported.
+    // timestep is not supported. Queued commands are applied first.
     void Step();
+
+    // Applies the queued commands and runs Step() on the scene's step thread
+    // (and on jobs, if set), returning right away. Until WaitStep() (or
+    // IsStepDone()) confirms the step completed, bodies must not be read or
+    // written and no scene function other than FrontTransforms(), commands,
+    // snapshot views and IsStepDone() may be called. Waits for the previous
+    // asynchronous step if it is still running.
+    // With jobs set, the step thread uses them as worker 0, the index of the
+    // thread that owns a q3JobSystem. A q3JobSystem takes one such thread at a
+    // time, so the game must not use the same one until the step completed:
+    // give the game's own work another job system or run it after WaitStep().
+    q3StepToken StepAsync();
+    bool IsStepDone(q3StepToken token) const;
+    void WaitStep(q3StepToken token);
+
+    // Every body's transform as it was when the last StepAsync() started,
+    // i.e. the result of the step before it. Stays valid and unchanged while
+    // the step runs and until the next StepAsync().
+    Slice<q3BodyTransform> FrontTransforms() const;
+
+    // helper for `q3Scene::Step` and `q3Scene::StepAsync`, simulates one step
+    void Simulate();
     // helper for `q3Scene::Step`
     void BuildIsland(q3Island* island, q3Body* seed);
 
@@ -71,18 +154,108 @@ struct q3Scene {
 
     void RemoveAllBodies();
 
+    // Uses the boxes of a read-only static world (see q3StaticWorld.h) as
+    // static geometry, besides the static bodies. The world is not copied and
+    // must outlive the scene or be detached first by passing null. The scene
+    // queries report its boxes as the q3Box proxies of static_body, created
+    // the first time a box is reported (q3ContactManager::StaticProxy), so
+    // with a static world they must not run on several threads at once. The
+    // world's own queries report box indices and are safe from any thread.
+    void SetStaticWorld(const q3StaticWorld* world);
+
+    // Writes a binary checkpoint of the scene (see q3SceneState.h). Load
+    // replaces every body with the saved ones and restores the settings and
+    // contacts, so stepping the loaded scene gives the same results as
+    // stepping the saved one. The jobs pointer and the published snapshots
+    // are not part of the file.
+    ErrOrVoid Save(FILE* file) const;
+    ErrOrVoid Load(FILE* file);
+
+    // Rollback: copies the body transforms and velocities, the broadphase
+    // proxies and the contacts with their impulses into state, reusing its
+    // arrays (see q3Rollback.h). RestoreState rewinds the scene to a state
+    // saved from it, after which stepping repeats the same results.
+    void SaveState(q3RollbackState* state) const;
+    void RestoreState(const q3RollbackState& state);
+
+    // 64-bit FNV-1a hash over the id, position, orientation and velocities of
+    // every body, bit for bit. Equal hashes after the same steps on two
+    // machines (or thread counts) mean the simulations have not diverged.
+    u64 StateHash() const;
+
+    // Sensor overlap begin/end events generated by the last Step() call. The
+    // buffer is owned by the scene and is overwritten by the next Step().
+    // Removing a body does not generate end events for its sensor contacts.
+    Slice<q3SensorEvent> SensorEvents() const;
+
+    // Contact begin/persist/end events generated by the last Step() call, in
+    // one contiguous buffer so they can be consumed in bulk (even on another
+    // thread) before the next Step(). Same lifetime rules as SensorEvents().
+    Slice<q3ContactEvent> ContactEvents() const;
+
     // Query the world to find any shapes that can potentially intersect
     // the provided AABB. This works by querying the broadphase with an
     // AAABB -- only *potential* intersections are reported. Perhaps the
     // user might use lmDistance as fine-grained collision detection.
     void QueryAABB(q3QueryCallback* cb, const q3AABB& aabb);
 
+    // Same query without a virtual call per shape: fn(q3Box*) is called for
+    // every box whose AABB overlaps aabb and returns false to stop the query.
+    // Unlike the callback version the AABBs are exact, so there is no need for
+    // a fine-grained check against the box AABB in fn.
+    template <typename F>
+    void QueryAABB(const q3AABB& aabb, F&& fn) {
+        bool more = true;
+        auto report = [&more, &fn](q3Box* box) { return more = fn(box); };
+        contact_manager.m_broadphase.QueryTight(aabb, report);
+        const q3StaticWorld* world = contact_manager.static_world;
+        if (!more || world == nullptr) return;
+        world->QueryAABB(aabb, [this, &fn](u32 index) {
+            return fn(contact_manager.StaticProxy(index));
+        });
+    }
+
+    // Writes the boxes whose AABB overlaps aabb to results, up to results.len
+    // of them, and returns how many boxes overlap (which may be more).
+    usize QueryAABB(const q3AABB& aabb, Slice<q3Box*> results);
+
     // Query the world to find any shapes intersecting a world space point.
     void QueryPoint(q3QueryCallback* cb, const q3Vec3& point);
 
+    // Functor version of QueryPoint, fn(q3Box*) returns false to stop the query
+    template <typename F>
+    void QueryPoint(const q3Vec3& point, F&& fn) {
+        auto test = [&point, &fn](q3Box* box) {
+            return !box->TestPoint(box->body->m_tx, point) || fn(box);
+        };
+        QueryAABB(q3AABB{.min = point, .max = point}, test);
+    }
+
     // Query the world to find any shapes intersecting a ray.
     void RayCast(q3QueryCallback* cb, q3RaycastData& rayCast);
 
+    // Finds the closest box hit by the ray and returns it, or null when there
+    // is none. The hit's time of impact and normal are left in rayCast.toi and
+    // rayCast.normal (toi = t and a zero normal when nothing was hit). The ray
+    // is shortened to every hit found while traversing, so farther proxies are
+    // rejected by their AABB test alone.
+    q3Box* RayCastClosest(q3RaycastData& rayCast);
+
+    // Sweeps the oriented box of `cast` along cast.dir and returns the first box
+    // it hits, or null when there is none. The time of impact and the normal of
+    // the hit box are left in cast.toi and cast.normal (toi = t and a zero
+    // normal when nothing was hit, toi = 0 and a zero normal when the cast
+    // starts overlapping a box). Boxes whose category is not in cast.maskBits
+    // are ignored, e.g. to skip the body being moved.
+    q3Box* BoxCast(q3BoxCastData& cast);
+
+    // Casts every ray (read only) and writes the closest hit of rays[i] to
+    // hits[i], which must hold at least rays.len entries. Rays are traced in
+    // packets of four with SIMD tests against the broadphase and the boxes,
+    // without any callbacks. Static world boxes are then traced one ray at a
+    // time, clipped at the packet's hits.
+    void RayCastBatch(Slice<q3RaycastData> rays, Slice<q3RayHit> hits);
+
     // Render the scene with an interpolated time between the last frame and
     // the current simulation step.
     void Render(q3Render* render);
@@ -0,0 +1,132 @@
+/**
+@file	q3SceneSnapshot.cpp
+
+        This software is provided 'as-is', without any express or implied
+        warranty. In no event will the authors be held liable for any damages
+        arising from the use of this software.
+
+        Permission is granted to anyone to use this software for any purpose,
+        including commercial applications, and to alter it and redistribute it
+        freely, subject to the following restrictions:
+          1. The origin of this software must not be misrepresented; you must
+not claim that you wrote the original software. If you use this software in a
+product, an acknowledgment in the product documentation would be appreciated but
+is not required.
+          2. Altered source versions must be plainly marked as such, and must
+not be misrepresented as being the original software.
+          3. This notice may not be removed or altered from any source
+distribution.
+*/
+
+#include <thread>
+
+#include "q3SceneSnapshot.h"
+#include "../broadphase/q3BroadPhase.h"
+#include "../collision/q3Box.h"
+#include "../dynamics/q3Body.h"
+
+q3SceneSnapshots::q3SceneSnapshots(Allocator allocator) {
+    for (u32 i = 0; i < 2; ++i) {
+        buffers[i] = ArrayList<q3SnapshotProxy>::init(allocator);
+        sequences[i] = 0;
+        readers[i].store(0);
+    }
+    published.store(0);
+}
+
+q3SceneSnapshots::~q3SceneSnapshots() {
+    for (u32 i = 0; i < 2; ++i) buffers[i].deinit();
+}
+
+q3SnapshotView q3SceneSnapshots::Acquire() {
+    for (;;) {
+        u32 buffer = published.load();
+        readers[buffer].fetch_add(1);
+
+        // Publish may have started refilling the buffer between the load and
+        // the pin, in which case it is no longer the published one
+        if (published.load() == buffer) {
+            return q3SnapshotView{
+                .proxies = buffers[buffer].items,
+                .sequence = sequences[buffer],
+                .owner = this,
+                .buffer = buffer,
+            };
+        }
+
+        readers[buffer].fetch_sub(1);
+    }
+}
+
+void q3SceneSnapshots::Publish(const q3BroadPhase* broadPhase) {
+    u32 buffer = 1 - published.load(std::memory_order_relaxed);
+
+    // Views acquired before the previous Publish may still read this buffer
+    while (readers[buffer].load() != 0) std::this_thread::yield();
+
+    ArrayList<q3SnapshotProxy>* proxies = &buffers[buffer];
+    proxies->shrinkRetainingCapacity(0);
+    proxies->ensureTotalCapacity(broadPhase->boxes.items.len).unwrap();
+
+    for (const BoxInfo& info : broadPhase->boxes.items) {
+        q3Box* box = info.box;
+        if (box == nullptr) continue;
+
+        q3SnapshotProxy proxy;
+        proxy.box = box;
+        proxy.body = box->body;
+        proxy.tx = q3Mul(box->body->m_tx, box->local);
+        proxy.e = box->e;
+        proxy.aabb = info.tight_aabb;
+        proxies->append(proxy).unwrap();
+    }
+
+    sequences[buffer] = sequences[1 - buffer] + 1;
+    published.store(buffer);
+}
+
+void q3SnapshotView::Release() {
+    owner->readers[buffer].fetch_sub(1);
+}
+
+void q3SnapshotView::QueryAABB(q3SnapshotCallback* cb, const q3AABB& aabb) const {
+    for (const q3SnapshotProxy& proxy : proxies) {
+        if (q3AABBtoAABB(aabb, proxy.aabb) && !cb->ReportProxy(proxy)) return;
+    }
+}
+
+void q3SnapshotView::QueryPoint(q3SnapshotCallback* cb, const q3Vec3& point) const {
+    for (const q3SnapshotProxy& proxy : proxies) {
+        if (!proxy.aabb.Contains(point)) continue;
+        if (q3TestPointOBB(proxy.tx, proxy.e, point) && !cb->ReportProxy(proxy)) return;
+    }
+}
+
+void q3SnapshotView::RayCast(q3SnapshotCallback* cb, q3RaycastData& rayCast) const {
+    q3Vec3 p1 = rayCast.start + rayCast.dir * rayCast.t;
+
+    for (const q3SnapshotProxy& proxy : proxies) {
+        if (!q3SegmentAABB(rayCast.start, p1, proxy.aabb)) continue;
+        if (q3RaycastOBB(proxy.tx, proxy.e, &rayCast) && !cb->ReportProxy(proxy)) return;
+    }
+}
+
+const q3SnapshotProxy* q3SnapshotView::RayCastClosest(q3RaycastData& rayCast) const {
+    const q3SnapshotProxy* closest = nullptr;
+    r32 t = rayCast.t;
+    rayCast.toi = t;
+    rayCast.normal.Set(r32(0.0), r32(0.0), r32(0.0));
+    q3Vec3 p1 = rayCast.start + rayCast.dir * t;
+
+    for (const q3SnapshotProxy& proxy : proxies) {
+        if (!q3SegmentAABB(rayCast.start, p1, proxy.aabb)) continue;
+        if (q3RaycastOBB(proxy.tx, proxy.e, &rayCast)) {
+            closest = &proxy;
+            rayCast.t = rayCast.toi;
+            p1 = rayCast.start + rayCast.dir * rayCast.t;
+        }
+    }
+
+    rayCast.t = t;
+    return closest;
+}
@@ -0,0 +1,90 @@
+/**
+@file	q3SceneSnapshot.h
+
+        This software is provided 'as-is', without any express or implied
+        warranty. In no event will the authors be held liable for any damages
+        arising from the use of this software.
+
+        Permission is granted to anyone to use this software for any purpose,
+        including commercial applications, and to alter it and redistribute it
+        freely, subject to the following restrictions:
+          1. The origin of this software must not be misrepresented; you must
+not claim that you wrote the original software. If you use this software in a
+product, an acknowledgment in the product documentation would be appreciated but
+is not required.
+          2. Altered source versions must be plainly marked as such, and must
+not be misrepresented as being the original software.
+          3. This notice may not be removed or altered from any source
+distribution.
+*/
+
+#pragma once
+
+#include <atomic>
+
+#include "../common/q3Geometry.h"
+#include "../common/q3Types.h"
+#include "../math/q3Transform.h"
+
+// Read-only copies of every box, published by q3Scene::Step so that any
+// number of threads can query the scene while the next Step runs, without
+// locks. Enable with q3Scene::enable_snapshots.
+//
+//     q3SnapshotView view = scene.snapshots.Acquire(); // Any thread
+//     defer(view.Release());
+//     view.RayCast(&callback, ray);
+//
+// Two buffers are kept: Step fills the one no reader can acquire anymore and
+// then publishes it. A view pins its buffer, so Step waits for views that are
+// still held two Steps later. Release views promptly.
+
+// One box as of the end of a Step
+struct q3SnapshotProxy {
+    // Identify the box, they must not be dereferenced while Step runs and
+    // dangle once the body is removed
+    q3Box* box;
+    q3Body* body;
+    q3Transform tx; // World transform of the box
+    q3Vec3 e;       // Half extents
+    q3AABB aabb;    // Tight world AABB
+};
+
+struct q3SnapshotCallback {
+    virtual ~q3SnapshotCallback() {}
+
+    virtual bool ReportProxy(const q3SnapshotProxy& proxy) = 0;
+};
+
+struct q3SnapshotView {
+    Slice<q3SnapshotProxy> proxies;
+    u64 sequence; // Number of snapshots published before this one
+    q3SceneSnapshots* owner;
+    u32 buffer;
+
+    // Same semantics as the q3Scene queries of the same names
+    void QueryAABB(q3SnapshotCallback* cb, const q3AABB& aabb) const;
+    void QueryPoint(q3SnapshotCallback* cb, const q3Vec3& point) const;
+    void RayCast(q3SnapshotCallback* cb, q3RaycastData& rayCast) const;
+    const q3SnapshotProxy* RayCastClosest(q3RaycastData& rayCast) const;
+
+    // Unpins the buffer, the view must not be used afterwards
+    void Release();
+};
+
+struct q3SceneSnapshots {
+    ArrayList<q3SnapshotProxy> buffers[2];
+    u64 sequences[2];
+    std::atomic<u32> published;
+    std::atomic<u32> readers[2];
+
+    q3SceneSnapshots(Allocator allocator);
+    ~q3SceneSnapshots();
+
+    // Pins and returns the latest snapshot (empty before the first Publish).
+    // Safe to call from any thread.
+    q3SnapshotView Acquire();
+
+    // Copies the proxies of the broadphase into the buffer not published and
+    // publishes it. Called by q3Scene::Step, only one thread may publish.
+    void Publish(const q3BroadPhase* broadPhase);
+};
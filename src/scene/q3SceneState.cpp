@@ -0,0 +1,431 @@
+/**
+@file	q3SceneState.cpp
+
+        This software is provided 'as-is', without any express or implied
+        warranty. In no event will the authors be held liable for any damages
+        arising from the use of this software.
+
+        Permission is granted to anyone to use this software for any purpose,
+        including commercial applications, and to alter it and redistribute it
+        freely, subject to the following restrictions:
+          1. The origin of this software must not be misrepresented; you must
+not claim that you wrote the original software. If you use this software in a
+product, an acknowledgment in the product documentation would be appreciated but
+is not required.
+          2. Altered source versions must be plainly marked as such, and must
+not be misrepresented as being the original software.
+          3. This notice may not be removed or altered from any source
+distribution.
+*/
+
+
+#include <algorithm>
+#include <string.h>
+
+#include "q3SceneState.h"
+#include "q3Scene.h"
+#include "q3StaticWorld.h"
+#include "../collision/q3Box.h"
+#include "../dynamics/q3Body.h"
+#include "../dynamics/q3Contact.h"
+
+static void q3Put(r32* out, const q3Vec3& v) {
+    out[0] = v.x;
+    out[1] = v.y;
+    out[2] = v.z;
+}
+
+static void q3Put(r32* out, const q3Mat3& m) {
+    q3Put(out, m[0]);
+    q3Put(out + 3, m[1]);
+    q3Put(out + 6, m[2]);
+}
+
+static void q3Put(r32* out, const q3AABB& aabb) {
+    q3Put(out, aabb.min);
+    q3Put(out + 3, aabb.max);
+}
+
+static q3Vec3 q3GetVec3(const r32* in) {
+    return q3Vec3(in[0], in[1], in[2]);
+}
+
+static q3Mat3 q3GetMat3(const r32* in) {
+    return q3Mat3(q3GetVec3(in), q3GetVec3(in + 3), q3GetVec3(in + 6));
+}
+
+static q3AABB q3GetAABB(const r32* in) {
+    return q3AABB{.min = q3GetVec3(in), .max = q3GetVec3(in + 3)};
+}
+
+q3SceneState::q3SceneState(Allocator allocator) :
+    header({}),
+    bodies(ArrayList<q3BodyRecord>::init(allocator)),
+    free_slots(ArrayList<u32>::init(allocator)),
+    contacts(ArrayList<q3ContactRecord>::init(allocator)),
+    points(ArrayList<q3ContactPointRecord>::init(allocator)) {}
+
+q3SceneState::~q3SceneState() {
+    bodies.deinit();
+    free_slots.deinit();
+    contacts.deinit();
+    points.deinit();
+}
+
+void q3SceneState::Capture(const q3Scene* scene) {
+    const q3ContactManager* manager = &scene->contact_manager;
+    const q3BroadPhase* broadphase = &manager->m_broadphase;
+
+    header = {};
+    header.magic = q3_scene_magic;
+    header.version = q3_scene_version;
+    header.body_count = intCast<u32>(scene->bodies.len);
+    header.slot_count = intCast<u32>(broadphase->boxes.items.len);
+    header.free_slot_count = intCast<u32>(broadphase->unused_boxes.items.len);
+    header.contact_count = intCast<u32>(manager->contacts.len);
+    header.dt = scene->dt;
+    q3Put(header.gravity, scene->gravity);
+    header.iterations = intCast<u32>(scene->iterations);
+    header.substeps = intCast<u32>(scene->substeps);
+    header.position_iterations = intCast<u32>(scene->position_iterations);
+    header.next_body_id = scene->next_body_id;
+    header.enable_friction = scene->enable_friction;
+    header.enable_persist_events = scene->enable_persist_events;
+    header.enable_snapshots = scene->enable_snapshots;
+    header.deterministic = scene->deterministic;
+
+    // Contacts refer to their bodies by record index, looked up by body id
+    auto record_index = ArrayList<u32>::init(bodies.allocator);
+    defer(record_index.deinit());
+    record_index.resize(scene->next_body_id).unwrap();
+
+    bodies.resize(header.body_count).unwrap();
+    u32 index = 0;
+    for (q3Body* body : scene->bodies.ptrIter()) {
+        debug::assert(body->id < scene->next_body_id);
+        record_index.items[body->id] = index;
+
+        q3BodyRecord* r = &bodies.items[index++];
+        *r = {};
+        r->id = body->id;
+        r->type = u8(
+            body->flags.Static ? eStaticBody : body->flags.Kinematic ? eKinematicBody : eDynamicBody
+        );
+        q3Put(r->position, body->m_tx.position);
+        q3Put(r->rotation, body->m_tx.rotation);
+        for (i32 i = 0; i < 4; ++i) r->q[i] = body->m_q.v[i];
+        q3Put(r->local_center, body->m_localCenter);
+        q3Put(r->world_center, body->m_worldCenter);
+        q3Put(r->linear_velocity, body->m_linearVelocity);
+        q3Put(r->angular_velocity, body->m_angularVelocity);
+        q3Put(r->force, body->m_force);
+        q3Put(r->torque, body->m_torque);
+        r->mass = body->m_mass;
+        r->inv_mass = body->m_invMass;
+        q3Put(r->inv_inertia_model, body->m_invInertiaModel);
+        q3Put(r->inv_inertia_world, body->m_invInertiaWorld);
+        r->gravity_scale = body->m_gravityScale;
+        r->linear_damping = body->m_linearDamping;
+        r->angular_damping = body->m_angularDamping;
+
+        const q3Box* box = &body->box;
+        const BoxInfo& proxy = broadphase->boxes.items[box->broadPhaseIndex];
+        r->sensor = box->sensor;
+        q3Put(r->box_position, box->local.position);
+        q3Put(r->box_rotation, box->local.rotation);
+        q3Put(r->extent, box->e);
+        r->friction = box->friction;
+        r->restitution = box->restitution;
+        r->density = box->density;
+        r->category_bits = box->categoryBits;
+        r->mask_bits = box->maskBits;
+        r->group_index = box->groupIndex;
+        r->slot = box->broadPhaseIndex;
+        q3Put(r->aabb, proxy.aabb);
+        q3Put(r->tight_aabb, proxy.tight_aabb);
+    }
+
+    free_slots.resize(header.free_slot_count).unwrap();
+    for (usize i = 0; i < header.free_slot_count; ++i) {
+        free_slots.items[i] = intCast<u32>(broadphase->unused_boxes.items[i]);
+    }
+
+    contacts.resize(header.contact_count).unwrap();
+    points.shrinkRetainingCapacity(0);
+    index = 0;
+    for (q3ContactConstraint* contact : manager->contacts.ptrIter()) {
+        const q3Manifold* m = &contact->manifold;
+        q3ContactRecord* r = &contacts.items[index++];
+        *r = {};
+        r->body_a = record_index.items[contact->bodyA->id];
+        if (contact->bodyB == &scene->static_body) {
+            r->body_b = q3_scene_static_body;
+            r->static_box = u32(-1 - contact->B->broadPhaseIndex);
+        } else {
+            r->body_b = record_index.items[contact->bodyB->id];
+        }
+        r->colliding = contact->flags.Colliding;
+        r->was_colliding = contact->flags.WasColliding;
+        r->friction = contact->friction;
+        r->restitution = contact->restitution;
+        q3Put(r->normal, m->normal);
+        q3Put(r->tangents, m->tangentVectors[0]);
+        q3Put(r->tangents + 3, m->tangentVectors[1]);
+        r->point_count = intCast<u32>(m->contactCount);
+
+        for (i32 i = 0; i < m->contactCount; ++i) {
+            const q3Contact* c = m->contacts + i;
+            q3ContactPointRecord p = {};
+            q3Put(p.position, c->position);
+            p.penetration = c->penetration;
+            p.normal_impulse = c->normalImpulse;
+            p.tangent_impulse[0] = c->tangentImpulse[0];
+            p.tangent_impulse[1] = c->tangentImpulse[1];
+            p.bias = c->bias;
+            p.normal_mass = c->normalMass;
+            p.tangent_mass[0] = c->tangentMass[0];
+            p.tangent_mass[1] = c->tangentMass[1];
+            p.key = c->fp.key;
+            points.append(p).unwrap();
+        }
+    }
+    header.point_count = intCast<u32>(points.items.len);
+}
+
+bool q3SceneState::MatchesStaticWorld(const q3Scene* scene) const {
+    const q3StaticWorld* world = scene->contact_manager.static_world;
+    for (const q3ContactRecord& r : contacts.items) {
+        if (r.body_b != q3_scene_static_body) continue;
+        if (world == nullptr || r.static_box >= world->box_count) return false;
+    }
+    return true;
+}
+
+ErrOrVoid q3SceneState::Restore(q3Scene* scene) const {
+    debug::assert(MatchesStaticWorld(scene));
+    auto body_ptrs = ArrayList<q3Body*>::init(scene->allocator);
+    defer(body_ptrs.deinit());
+    try_expr(body_ptrs.resize(header.body_count));
+    scene->RemoveAllBodies();
+
+    scene->dt = header.dt;
+    scene->gravity = q3GetVec3(header.gravity);
+    scene->iterations = header.iterations;
+    scene->substeps = header.substeps;
+    scene->position_iterations = header.position_iterations;
+    scene->next_body_id = header.next_body_id;
+    scene->enable_friction = header.enable_friction;
+    scene->enable_persist_events = header.enable_persist_events;
+    scene->enable_snapshots = header.enable_snapshots;
+    scene->deterministic = header.deterministic;
+
+    // The proxy slots are rebuilt wholesale instead of inserting box by box
+    q3ContactManager* manager = &scene->contact_manager;
+    q3BroadPhase* broadphase = &manager->m_broadphase;
+    broadphase->pairs.shrinkRetainingCapacity(0);
+    try_expr(broadphase->boxes.resize(header.slot_count));
+    for (BoxInfo& proxy : broadphase->boxes.items) {
+        proxy = {.box = nullptr, .aabb = undefined, .tight_aabb = undefined};
+    }
+    try_expr(broadphase->unused_boxes.resize(header.free_slot_count));
+    for (usize i = 0; i < header.free_slot_count; ++i) {
+        broadphase->unused_boxes.items[i] = free_slots.items[i];
+    }
+
+    // Bodies are prepended, so the records are walked backwards to keep the
+    // list order (which decides the island order)
+    for (usize i = header.body_count; i > 0; --i) {
+        const q3BodyRecord* r = &bodies.items[i - 1];
+        q3BodyDef def;
+        def.bodyType = q3BodyType(r->type);
+        q3Body* body = &scene->bodies.prepend(q3Body(def, scene)).unwrap()->data;
+        body_ptrs.items[i - 1] = body;
+
+        body->id = r->id;
+        body->m_tx.position = q3GetVec3(r->position);
+        body->m_tx.rotation = q3GetMat3(r->rotation);
+        for (i32 j = 0; j < 4; ++j) body->m_q.v[j] = r->q[j];
+        body->m_localCenter = q3GetVec3(r->local_center);
+        body->m_worldCenter = q3GetVec3(r->world_center);
+        body->m_linearVelocity = q3GetVec3(r->linear_velocity);
+        body->m_angularVelocity = q3GetVec3(r->angular_velocity);
+        body->m_force = q3GetVec3(r->force);
+        body->m_torque = q3GetVec3(r->torque);
+        body->m_mass = r->mass;
+        body->m_invMass = r->inv_mass;
+        body->m_invInertiaModel = q3GetMat3(r->inv_inertia_model);
+        body->m_invInertiaWorld = q3GetMat3(r->inv_inertia_world);
+        body->m_gravityScale = r->gravity_scale;
+        body->m_linearDamping = r->linear_damping;
+        body->m_angularDamping = r->angular_damping;
+
+        q3Box* box = &body->box;
+        box->local.position = q3GetVec3(r->box_position);
+        box->local.rotation = q3GetMat3(r->box_rotation);
+        box->e = q3GetVec3(r->extent);
+        box->body = body;
+        box->friction = r->friction;
+        box->restitution = r->restitution;
+        box->density = r->density;
+        box->sensor = r->sensor;
+        box->categoryBits = r->category_bits;
+        box->maskBits = r->mask_bits;
+        box->groupIndex = r->group_index;
+        box->broadPhaseIndex = r->slot;
+        broadphase->boxes.items[r->slot] = {
+            .box = box, .aabb = q3GetAABB(r->aabb), .tight_aabb = q3GetAABB(r->tight_aabb)
+        };
+    }
+    scene->new_box = header.body_count > 0;
+
+    // Contacts and the bodies' edge lists are prepended too, walking backwards
+    // recreates both orders
+    usize point = header.point_count;
+    for (usize i = header.contact_count; i > 0; --i) {
+        const q3ContactRecord* r = &contacts.items[i - 1];
+        q3Body* bodyA = body_ptrs.items[r->body_a];
+        bool is_static = r->body_b == q3_scene_static_body;
+        q3Body* bodyB = is_static ? &scene->static_body : body_ptrs.items[r->body_b];
+
+        q3ContactConstraint* contact = &manager->contacts.prepend({}).unwrap()->data;
+        contact->A = &bodyA->box;
+        contact->B = is_static ? manager->StaticProxy(r->static_box) : &bodyB->box;
+        contact->bodyA = bodyA;
+        contact->bodyB = bodyB;
+        contact->friction = r->friction;
+        contact->restitution = r->restitution;
+        contact->flags = {};
+        contact->flags.Colliding = r->colliding;
+        contact->flags.WasColliding = r->was_colliding;
+
+        q3Manifold* m = &contact->manifold;
+        m->SetPair(contact->A, contact->B);
+        m->normal = q3GetVec3(r->normal);
+        m->tangentVectors[0] = q3GetVec3(r->tangents);
+        m->tangentVectors[1] = q3GetVec3(r->tangents + 3);
+        m->contactCount = i32(r->point_count);
+
+        point -= r->point_count;
+        for (i32 j = 0; j < m->contactCount; ++j) {
+            const q3ContactPointRecord* p = &points.items[point + usize(j)];
+            q3Contact* c = m->contacts + j;
+            c->position = q3GetVec3(p->position);
+            c->penetration = p->penetration;
+            c->normalImpulse = p->normal_impulse;
+            c->tangentImpulse[0] = p->tangent_impulse[0];
+            c->tangentImpulse[1] = p->tangent_impulse[1];
+            c->bias = p->bias;
+            c->normalMass = p->normal_mass;
+            c->tangentMass[0] = p->tangent_mass[0];
+            c->tangentMass[1] = p->tangent_mass[1];
+            c->fp.key = p->key;
+        }
+
+        contact->edgeA.constraint = contact;
+        contact->edgeA.other = bodyB;
+        bodyA->linkEdgeIntoList(&contact->edgeA);
+        contact->edgeB.constraint = contact;
+        contact->edgeB.other = bodyA;
+        bodyB->linkEdgeIntoList(&contact->edgeB);
+    }
+    debug::assert(point == 0);
+    return {};
+}
+
+template <typename T>
+static ErrOrVoid q3WriteArray(FILE* file, Slice<T> items) {
+    if (items.len == 0) return {};
+    if (fwrite(items.ptr, sizeof(T), items.len, file) != items.len) return Error::Unexpected;
+    return {};
+}
+
+// Fails when the file ends before the given number of bytes, so that counts
+// from a corrupt header are not allocated
+static ErrOrVoid q3CheckRemaining(FILE* file, u64 bytes) {
+    long start = ftell(file);
+    if (start < 0 || fseek(file, 0, SEEK_END) != 0) return Error::Unseekable;
+    long end = ftell(file);
+    if (end < 0 || fseek(file, start, SEEK_SET) != 0) return Error::Unseekable;
+    if (u64(end - start) < bytes) return Error::UnexpectedEndOfFile;
+    return {};
+}
+
+template <typename T>
+static ErrOrVoid q3ReadArray(FILE* file, ArrayList<T>* list, u32 count) {
+    try_expr(list->resize(count));
+    if (count == 0) return {};
+    if (fread(list->items.ptr, sizeof(T), count, file) != count) return Error::UnexpectedEndOfFile;
+    return {};
+}
+
+ErrOrVoid q3SceneState::Write(FILE* file) const {
+    if (fwrite(&header, sizeof(header), 1, file) != 1) return Error::Unexpected;
+    try_expr(q3WriteArray(file, bodies.items));
+    try_expr(q3WriteArray(file, free_slots.items));
+    try_expr(q3WriteArray(file, contacts.items));
+    try_expr(q3WriteArray(file, points.items));
+    return {};
+}
+
+ErrOrVoid q3SceneState::Read(FILE* file) {
+    if (fread(&header, sizeof(header), 1, file) != 1) return Error::UnexpectedEndOfFile;
+    if (header.magic != q3_scene_magic || header.version != q3_scene_version) {
+        return Error::ParseError;
+    }
+    if (u64(header.slot_count) != u64(header.body_count) + header.free_slot_count) {
+        return Error::ParseError;
+    }
+    try_expr(q3CheckRemaining(
+        file, u64(header.body_count) * sizeof(q3BodyRecord) +
+                  u64(header.free_slot_count) * sizeof(u32) +
+                  u64(header.contact_count) * sizeof(q3ContactRecord) +
+                  u64(header.point_count) * sizeof(q3ContactPointRecord)
+    ));
+    try_expr(q3ReadArray(file, &bodies, header.body_count));
+    try_expr(q3ReadArray(file, &free_slots, header.free_slot_count));
+    try_expr(q3ReadArray(file, &contacts, header.contact_count));
+    try_expr(q3ReadArray(file, &points, header.point_count));
+
+    // Indices are checked once here so that Restore can trust them. Every
+    // slot is either used by exactly one body or free exactly once.
+    auto used_slots = ArrayList<bool>::init(bodies.allocator);
+    defer(used_slots.deinit());
+    try_expr(used_slots.resize(header.slot_count));
+    for (bool& used : used_slots.items) used = false;
+    auto mark_slot = [&](u32 slot) {
+        if (slot >= header.slot_count || used_slots.items[slot]) return false;
+        used_slots.items[slot] = true;
+        return true;
+    };
+    for (const q3BodyRecord& r : bodies.items) {
+        if (r.slot < 0 || !mark_slot(u32(r.slot)) || r.type > eKinematicBody) {
+            return Error::ParseError;
+        }
+        if (r.id >= header.next_body_id) return Error::ParseError;
+    }
+    for (u32 slot : free_slots.items) {
+        if (!mark_slot(slot)) return Error::ParseError;
+    }
+
+    // Ids are unique. Sorted instead of marked, next_body_id is not bounded by
+    // the file size.
+    auto ids = ArrayList<u32>::init(bodies.allocator);
+    defer(ids.deinit());
+    try_expr(ids.resize(header.body_count));
+    for (usize i = 0; i < header.body_count; ++i) ids.items[i] = bodies.items[i].id;
+    std::sort(ids.items.ptr, ids.items.ptr + ids.items.len);
+    for (usize i = 1; i < ids.items.len; ++i) {
+        if (ids.items[i] == ids.items[i - 1]) return Error::ParseError;
+    }
+    u64 point_count = 0;
+    for (const q3ContactRecord& r : contacts.items) {
+        if (r.body_a >= header.body_count) return Error::ParseError;
+        if (r.body_b >= header.body_count && r.body_b != q3_scene_static_body) {
+            return Error::ParseError;
+        }
+        if (r.point_count > 8) return Error::ParseError;
+        point_count += r.point_count;
+    }
+    if (point_count != header.point_count) return Error::ParseError;
+    return {};
+}
@@ -0,0 +1,163 @@
+/**
+@file	q3SceneState.h
+
+        This software is provided 'as-is', without any express or implied
+        warranty. In no event will the authors be held liable for any damages
+        arising from the use of this software.
+
+        Permission is granted to anyone to use this software for any purpose,
+        including commercial applications, and to alter it and redistribute it
+        freely, subject to the following restrictions:
+          1. The origin of this software must not be misrepresented; you must
+not claim that you wrote the original software. If you use this software in a
+product, an acknowledgment in the product documentation would be appreciated but
+is not required.
+          2. Altered source versions must be plainly marked as such, and must
+not be misrepresented as being the original software.
+          3. This notice may not be removed or altered from any source
+distribution.
+*/
+
+
+#pragma once
+
+#include <stdio.h>
+
+#include "../common/q3Types.h"
+
+// Binary checkpoint of a whole scene, see q3Scene::Save and q3Scene::Load.
+// Holds every body and its box, the broadphase proxy slots and every contact
+// with its manifold and accumulated impulses, so a loaded scene continues
+// exactly like the one that was saved (also without deterministic mode).
+//
+// File layout, all little endian, each section one bulk write:
+//
+//     q3SceneHeader
+//     q3BodyRecord[body_count]          in q3Scene::bodies order
+//     u32[free_slot_count]              broadphase slots free for reuse
+//     q3ContactRecord[contact_count]    in q3ContactManager::contacts order
+//     q3ContactPointRecord[point_count] manifold points of all contacts
+//
+// Contacts with the boxes of an attached q3StaticWorld refer to them by index,
+// so such files have to be loaded into a scene with the same static world.
+//
+// Records only hold fixed size fields (no q3Vec3, which is padded in SIMD
+// builds), so files are shared between scalar and SIMD builds.
+
+constexpr u32 q3_scene_magic = 0x43533351; // "Q3SC"
+constexpr u32 q3_scene_version = 4;
+// q3ContactRecord::body_b of a contact with a static world box
+constexpr u32 q3_scene_static_body = 0xFFFFFFFF;
+
+struct q3SceneHeader {
+    u32 magic;
+    u32 version;
+    u32 body_count;
+    u32 slot_count; // Broadphase proxy slots, used and free
+    u32 free_slot_count;
+    u32 contact_count;
+    u32 point_count;
+
+    // Scene settings
+    r32 dt;
+    r32 gravity[3];
+    u32 iterations;
+    u32 substeps;
+    u32 position_iterations;
+    u32 next_body_id;
+    u8 enable_friction;
+    u8 enable_persist_events;
+    u8 enable_snapshots;
+    u8 deterministic;
+};
+
+struct q3BodyRecord {
+    u32 id;
+    u8 type; // q3BodyType
+    u8 sensor;
+    u8 padding[2];
+
+    r32 position[3];
+    r32 rotation[9];
+    r32 q[4];
+    r32 local_center[3];
+    r32 world_center[3];
+    r32 linear_velocity[3];
+    r32 angular_velocity[3];
+    r32 force[3];
+    r32 torque[3];
+    r32 mass;
+    r32 inv_mass;
+    r32 inv_inertia_model[9];
+    r32 inv_inertia_world[9];
+    r32 gravity_scale;
+    r32 linear_damping;
+    r32 angular_damping;
+
+    // Box
+    r32 box_position[3];
+    r32 box_rotation[9];
+    r32 extent[3];
+    r32 friction;
+    r32 restitution;
+    r32 density;
+    u32 category_bits;
+    u32 mask_bits;
+    i32 group_index;
+    i32 slot;         // Broadphase proxy index
+    r32 aabb[6];      // Fat broadphase AABB
+    r32 tight_aabb[6];
+};
+
+struct q3ContactRecord {
+    u32 body_a; // Indices into the body records
+    u32 body_b; // Or q3_scene_static_body
+    u32 static_box; // Static world box index when body_b is the static body
+    u8 colliding;
+    u8 was_colliding;
+    u8 padding[2];
+    r32 friction;
+    r32 restitution;
+    r32 normal[3];
+    r32 tangents[6];
+    u32 point_count;
+};
+
+struct q3ContactPointRecord {
+    r32 position[3];
+    r32 penetration;
+    r32 normal_impulse;
+    r32 tangent_impulse[2];
+    r32 bias;
+    r32 normal_mass;
+    r32 tangent_mass[2];
+    i32 key; // q3FeaturePair
+};
+
+// A scene decoded into flat record arrays, the in-memory form of the file
+struct q3SceneState {
+    q3SceneHeader header;
+    ArrayList<q3BodyRecord> bodies;
+    ArrayList<u32> free_slots;
+    ArrayList<q3ContactRecord> contacts;
+    ArrayList<q3ContactPointRecord> points;
+
+    q3SceneState(Allocator allocator);
+    ~q3SceneState();
+
+    // Records the scene, reusing the arrays of a previous Capture
+    void Capture(const q3Scene* scene);
+    // Whether the contacts with static world boxes fit the static world
+    // attached to scene, which Restore requires
+    bool MatchesStaticWorld(const q3Scene* scene) const;
+    // Replaces every body and contact of scene with the recorded ones. Bodies
+    // are recreated, so pointers to the old bodies and boxes dangle. Out of
+    // memory can leave the scene without bodies.
+    ErrOrVoid Restore(q3Scene* scene) const;
+
+    ErrOrVoid Write(FILE* file) const;
+    // Error::ParseError for a file of another format or version or with
+    // inconsistent indices. The file has to be seekable, the counts of the
+    // header are checked against its size before anything is allocated.
+    ErrOrVoid Read(FILE* file);
+};
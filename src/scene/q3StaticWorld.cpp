@@ -0,0 +1,316 @@
+/**
+@file	q3StaticWorld.cpp
+
+        This software is provided 'as-is', without any express or implied
+        warranty. In no event will the authors be held liable for any damages
+        arising from the use of this software.
+
+        Permission is granted to anyone to use this software for any purpose,
+        including commercial applications, and to alter it and redistribute it
+        freely, subject to the following restrictions:
+          1. The origin of this software must not be misrepresented; you must
+not claim that you wrote the original software. If you use this software in a
+product, an acknowledgment in the product documentation would be appreciated but
+is not required.
+          2. Altered source versions must be plainly marked as such, and must
+not be misrepresented as being the original software.
+          3. This notice may not be removed or altered from any source
+distribution.
+*/
+
+
+#include <algorithm>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "q3StaticWorld.h"
+#include "../collision/q3Box.h"
+
+static q3Vec3 q3GetVec3(const r32* in) {
+    return q3Vec3(in[0], in[1], in[2]);
+}
+
+static void q3Put(r32* out, const q3Vec3& v) {
+    out[0] = v.x;
+    out[1] = v.y;
+    out[2] = v.z;
+}
+
+q3Transform q3StaticBox::GetTransform() const {
+    return q3Transform{
+        .position = q3GetVec3(position),
+        .rotation = q3Mat3(q3GetVec3(rotation), q3GetVec3(rotation + 3), q3GetVec3(rotation + 6)),
+    };
+}
+
+q3Vec3 q3StaticBox::GetExtent() const {
+    return q3GetVec3(e);
+}
+
+q3AABB q3StaticBox::GetAABB() const {
+    return q3AABB{.min = q3GetVec3(aabb), .max = q3GetVec3(aabb + 3)};
+}
+
+q3AABB q3StaticWorld::GetAABB(const q3StaticNode* node) {
+    return q3AABB{.min = q3GetVec3(node->min), .max = q3GetVec3(node->max)};
+}
+
+// Top down median split over the box centroids, four boxes per leaf
+struct q3StaticWorldBuilder {
+    Slice<q3StaticBox> boxes;
+    Slice<u32> order; // Boxes of each node are contiguous in here
+    ArrayList<q3StaticNode> nodes;
+
+    void Build(u32 node_index, u32 begin, u32 end) {
+        const u32 k_leaf_size = 4;
+
+        q3AABB bounds = boxes[order[begin]].GetAABB();
+        q3AABB centers = {.min = q3Vec3(0, 0, 0), .max = q3Vec3(0, 0, 0)};
+        for (u32 i = begin; i < end; ++i) {
+            q3AABB aabb = boxes[order[i]].GetAABB();
+            q3Vec3 c = (aabb.min + aabb.max) * r32(0.5);
+            bounds.min = q3Min(bounds.min, aabb.min);
+            bounds.max = q3Max(bounds.max, aabb.max);
+            centers.min = i == begin ? c : q3Min(centers.min, c);
+            centers.max = i == begin ? c : q3Max(centers.max, c);
+        }
+
+        q3StaticNode* node = &nodes.items[node_index];
+        q3Put(node->min, bounds.min);
+        q3Put(node->max, bounds.max);
+        if (end - begin <= k_leaf_size) {
+            node->first = begin;
+            node->count = end - begin;
+            return;
+        }
+
+        q3Vec3 extent = centers.max - centers.min;
+        i32 axis = 0;
+        if (extent.y > extent[axis]) axis = 1;
+        if (extent.z > extent[axis]) axis = 2;
+
+        u32 mid = begin + (end - begin) / 2;
+        Slice<q3StaticBox> all = boxes;
+        std::nth_element(
+            order.ptr + begin, order.ptr + mid, order.ptr + end,
+            [&all, axis](u32 a, u32 b) {
+                return all[a].aabb[axis] + all[a].aabb[axis + 3] <
+                       all[b].aabb[axis] + all[b].aabb[axis + 3];
+            }
+        );
+
+        u32 first = intCast<u32>(nodes.items.len);
+        node->first = first;
+        node->count = 0;
+        nodes.append({}).unwrap();
+        nodes.append({}).unwrap();
+        Build(first, begin, mid);
+        Build(first + 1, mid, end);
+    }
+};
+
+ErrOrVoid q3WriteStaticWorld(FILE* file, Slice<q3BoxDef> defs, Allocator allocator) {
+    u32 count = intCast<u32>(defs.len);
+    auto boxes = ArrayList<q3StaticBox>::init(allocator);
+    defer(boxes.deinit());
+    auto order = ArrayList<u32>::init(allocator);
+    defer(order.deinit());
+    try_expr(boxes.resize(count));
+    try_expr(order.resize(count));
+
+    for (u32 i = 0; i < count; ++i) {
+        const q3BoxDef& def = defs[i];
+        q3StaticBox* box = &boxes.items[i];
+        *box = {};
+        q3Put(box->position, def.m_tx.position);
+        q3Put(box->rotation, def.m_tx.rotation[0]);
+        q3Put(box->rotation + 3, def.m_tx.rotation[1]);
+        q3Put(box->rotation + 6, def.m_tx.rotation[2]);
+        q3Put(box->e, def.m_e);
+        q3AABB aabb;
+        q3Box shape = {};
+        shape.local = def.m_tx;
+        shape.e = def.m_e;
+        q3Transform identity;
+        q3Identity(identity);
+        shape.ComputeAABB(identity, &aabb);
+        q3Put(box->aabb, aabb.min);
+        q3Put(box->aabb + 3, aabb.max);
+        box->friction = def.m_friction;
+        box->restitution = def.m_restitution;
+        box->categoryBits = def.m_categoryBits;
+        box->maskBits = def.m_maskBits;
+        box->groupIndex = def.m_groupIndex;
+        box->sensor = def.m_sensor;
+        order.items[i] = i;
+    }
+
+    q3StaticWorldBuilder builder = {
+        .boxes = boxes.items,
+        .order = order.items,
+        .nodes = ArrayList<q3StaticNode>::init(allocator),
+    };
+    defer(builder.nodes.deinit());
+    if (count > 0) {
+        try_expr(builder.nodes.ensureTotalCapacity(2 * usize(count)));
+        builder.nodes.append({}).unwrap();
+        builder.Build(0, 0, count);
+    }
+
+    q3StaticWorldHeader header = {};
+    header.magic = q3_static_world_magic;
+    header.version = q3_static_world_version;
+    header.box_count = count;
+    header.node_count = intCast<u32>(builder.nodes.items.len);
+    header.boxes_offset = sizeof(header);
+    header.nodes_offset = header.boxes_offset + u64(count) * sizeof(q3StaticBox);
+
+    if (fwrite(&header, sizeof(header), 1, file) != 1) return Error::Unexpected;
+    for (u32 i = 0; i < count; ++i) {
+        if (fwrite(&boxes.items[order.items[i]], sizeof(q3StaticBox), 1, file) != 1) {
+            return Error::Unexpected;
+        }
+    }
+    usize node_count = builder.nodes.items.len;
+    if (node_count > 0 &&
+        fwrite(builder.nodes.items.ptr, sizeof(q3StaticNode), node_count, file) != node_count) {
+        return Error::Unexpected;
+    }
+    return {};
+}
+
+// Walks the tree like the queries do, so that they can index the nodes and
+// boxes and fill their stacks without checks
+static ErrOrVoid q3ValidateTree(const q3StaticNode* nodes, u32 node_count, u32 box_count) {
+    if (node_count == 0) return {};
+    struct Entry {
+        u32 node;
+        u32 depth;
+    };
+    Entry stack[q3_static_world_max_depth + 1];
+    u32 count = 0;
+    u32 visited = 0;
+    stack[count++] = {0, 0};
+    while (count > 0) {
+        Entry entry = stack[--count];
+        const q3StaticNode* node = nodes + entry.node;
+        if (++visited > node_count) return Error::ParseError;
+        if (node->count > 0) {
+            if (u64(node->first) + node->count > box_count) return Error::ParseError;
+            continue;
+        }
+        // Children after the parent rule out cycles
+        if (node->first <= entry.node || u64(node->first) + 1 >= node_count) {
+            return Error::ParseError;
+        }
+        if (entry.depth == q3_static_world_max_depth) return Error::ParseError;
+        stack[count++] = {node->first, entry.depth + 1};
+        stack[count++] = {node->first + 1, entry.depth + 1};
+    }
+    return {};
+}
+
+ErrOrVoid q3StaticWorld::Open(const void* data, usize size) {
+    q3StaticWorldHeader header;
+    if (size < sizeof(header)) return Error::UnexpectedEndOfFile;
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != q3_static_world_magic || header.version != q3_static_world_version) {
+        return Error::ParseError;
+    }
+
+    u64 boxes_end = header.boxes_offset + u64(header.box_count) * sizeof(q3StaticBox);
+    u64 nodes_end = header.nodes_offset + u64(header.node_count) * sizeof(q3StaticNode);
+    if (boxes_end > size || nodes_end > size) return Error::UnexpectedEndOfFile;
+    if (header.boxes_offset % alignof(q3StaticBox) || header.nodes_offset % alignof(q3StaticNode)) {
+        return Error::ParseError;
+    }
+
+    const u8* bytes = (const u8*)data;
+    const q3StaticNode* tree = (const q3StaticNode*)(bytes + header.nodes_offset);
+    try_expr(q3ValidateTree(tree, header.node_count, header.box_count));
+
+    boxes = (const q3StaticBox*)(bytes + header.boxes_offset);
+    nodes = tree;
+    box_count = header.box_count;
+    node_count = header.node_count;
+    return {};
+}
+
+static u64 q3HashBytes(u64 hash, const void* data, usize size) {
+    const u8* bytes = (const u8*)data;
+    for (usize i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+u64 q3StaticWorld::ContentHash() const {
+    u64 hash = 0xcbf29ce484222325ull;
+    hash = q3HashBytes(hash, boxes, usize(box_count) * sizeof(q3StaticBox));
+    hash = q3HashBytes(hash, nodes, usize(node_count) * sizeof(q3StaticNode));
+    return hash;
+}
+
+ErrOrVoid q3StaticWorld::Map(const char* path) {
+#ifdef _WIN32
+    Q3_UNUSED(path);
+    return Error::Unexpected;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return Error::FileNotFound;
+    defer(close(fd));
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) return Error::Unexpected;
+    usize size = usize(st.st_size);
+    if (size == 0) return Error::UnexpectedEndOfFile;
+
+    // Shared pages: every process mapping the file uses the same memory
+    void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) return Error::Unexpected;
+
+    ErrOrVoid opened = Open(data, size);
+    if (opened.is_err()) {
+        munmap(data, size);
+        return opened;
+    }
+    mapping = data;
+    mapping_size = size;
+    return {};
+#endif
+}
+
+void q3StaticWorld::Unmap() {
+#ifndef _WIN32
+    if (mapping) munmap(mapping, mapping_size);
+#endif
+    *this = {};
+}
+
+i32 q3StaticWorld::RayCastClosest(q3RaycastData& rayCast) const {
+    r32 t = rayCast.t;
+    rayCast.toi = t;
+    rayCast.normal.Set(r32(0.0), r32(0.0), r32(0.0));
+    i32 closest = -1;
+
+    // The ray is shortened to every hit, so farther nodes are culled
+    q3Vec3 zero(r32(0.0), r32(0.0), r32(0.0));
+    QuerySegment(rayCast, zero, [&](u32 i) {
+        const q3StaticBox& box = boxes[i];
+        if (q3RaycastOBB(box.GetTransform(), box.GetExtent(), &rayCast)) {
+            closest = i32(i);
+            rayCast.t = rayCast.toi;
+        }
+        return true;
+    });
+
+    rayCast.t = t;
+    return closest;
+}
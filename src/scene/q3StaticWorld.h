@@ -0,0 +1,184 @@
+/**
+@file	q3StaticWorld.h
+
+        This software is provided 'as-is', without any express or implied
+        warranty. In no event will the authors be held liable for any damages
+        arising from the use of this software.
+
+        Permission is granted to anyone to use this software for any purpose,
+        including commercial applications, and to alter it and redistribute it
+        freely, subject to the following restrictions:
+          1. The origin of this software must not be misrepresented; you must
+not claim that you wrote the original software. If you use this software in a
+product, an acknowledgment in the product documentation would be appreciated but
+is not required.
+          2. Altered source versions must be plainly marked as such, and must
+not be misrepresented as being the original software.
+          3. This notice may not be removed or altered from any source
+distribution.
+*/
+
+
+#pragma once
+
+#include <stdio.h>
+
+#include "../collision/q3Box.h"
+#include "../common/q3Geometry.h"
+#include "../common/q3Types.h"
+#include "../math/q3Transform.h"
+
+// Read-only static level geometry that is used in place, e.g. straight from a
+// memory mapped file shared by every process running the same level:
+//
+//     q3WriteStaticWorld(file, level_boxes, allocator); // Offline, once
+//
+//     q3StaticWorld world;
+//     world.Map("level.q3sw").unwrap(); // At startup, only the BVH is checked
+//     scene.SetStaticWorld(&world);
+//
+// The file holds the boxes (world space transform, extents, material and
+// collision filter) and a prebuilt BVH over them, referenced by offsets only,
+// so it does not matter where it is mapped. Nothing in it is ever written: a
+// scene creates a q3Box (owned by the scene, see q3ContactManager::StaticProxy)
+// for a static box the first time a body touches it, because contacts link
+// into the edge lists of their bodies and boxes.
+
+constexpr u32 q3_static_world_magic = 0x57533351; // "Q3SW"
+constexpr u32 q3_static_world_version = 1;
+
+struct q3StaticWorldHeader {
+    u32 magic;
+    u32 version;
+    u32 box_count;
+    u32 node_count;
+    u64 boxes_offset; // From the start of the file
+    u64 nodes_offset;
+};
+
+struct q3StaticBox {
+    r32 position[3];
+    r32 rotation[9];
+    r32 e[3];
+    r32 aabb[6];
+    r32 friction;
+    r32 restitution;
+    u32 categoryBits;
+    u32 maskBits;
+    i32 groupIndex;
+    u32 sensor;
+
+    q3Transform GetTransform() const;
+    q3Vec3 GetExtent() const;
+    q3AABB GetAABB() const;
+};
+
+// q3ShouldCollide against a static world box
+inline bool q3ShouldCollide(const q3Box* a, const q3StaticBox& b) {
+    return q3ShouldCollide(
+        a->categoryBits, a->maskBits, a->groupIndex, b.categoryBits, b.maskBits, b.groupIndex
+    );
+}
+
+// Node of the BVH, the root is node 0. Inner nodes (count == 0) have their
+// children at first and first + 1, leaves hold the boxes [first, first + count).
+// Children come after their parent in the node array.
+struct q3StaticNode {
+    r32 min[3];
+    r32 max[3];
+    u32 first;
+    u32 count;
+};
+
+// Deepest BVH node, the root being at depth 0. Bounds the traversal stacks of
+// the queries; the median split of q3WriteStaticWorld stays near
+// log2(box_count / 4), so only hand made or corrupt files come close.
+constexpr u32 q3_static_world_max_depth = 48;
+
+// Builds the BVH over boxes (m_tx being the world transform of each box) and
+// writes a static world file. The boxes are stored in BVH leaf order.
+ErrOrVoid q3WriteStaticWorld(FILE* file, Slice<q3BoxDef> boxes, Allocator allocator);
+
+struct q3StaticWorld {
+    const q3StaticBox* boxes = nullptr;
+    const q3StaticNode* nodes = nullptr;
+    u32 box_count = 0;
+    u32 node_count = 0;
+
+    // Set by Map, Unmap releases it
+    void* mapping = nullptr;
+    usize mapping_size = 0;
+
+    // Uses a static world file already in memory, which must stay valid and
+    // unchanged while the world is used. The header and the BVH indices are
+    // checked (one pass over the nodes: child and box ranges in bounds, every
+    // node reached once, at most q3_static_world_max_depth deep), the box
+    // contents are trusted. Error::ParseError for a file of another format or
+    // version or a malformed tree.
+    ErrOrVoid Open(const void* data, usize size);
+    // Maps the file read-only and opens it (POSIX only, elsewhere read the
+    // file and use Open)
+    ErrOrVoid Map(const char* path);
+    void Unmap();
+
+    // 64-bit FNV-1a hash over the boxes and nodes, so recordings can tell
+    // apart two worlds of the same size. Reads the whole world, not for use
+    // every step.
+    u64 ContentHash() const;
+
+    // Calls fn(index) for every box whose AABB overlaps aabb, until fn returns
+    // false. Safe to call from any number of threads.
+    template <typename F>
+    void QueryAABB(const q3AABB& aabb, F&& fn) const {
+        if (node_count == 0) return;
+        u32 stack[q3_static_world_max_depth + 1];
+        u32 count = 0;
+        stack[count++] = 0;
+        while (count > 0) {
+            const q3StaticNode* node = nodes + stack[--count];
+            if (!q3AABBtoAABB(aabb, GetAABB(node))) continue;
+            if (node->count == 0) {
+                stack[count++] = node->first;
+                stack[count++] = node->first + 1;
+                continue;
+            }
+            for (u32 i = node->first; i < node->first + node->count; ++i) {
+                if (q3AABBtoAABB(aabb, boxes[i].GetAABB()) && !fn(i)) return;
+            }
+        }
+    }
+
+    // Calls fn(index) for every box whose AABB, grown by `extent` (zero for a
+    // ray, the half extents of the swept AABB for a box cast), is overlapped by
+    // the segment [0, ray.t] of ray, until fn returns false. fn may shrink
+    // ray.t to cull the remaining nodes and boxes, like q3BroadPhase::Query.
+    template <typename F>
+    void QuerySegment(const q3RaycastData& ray, const q3Vec3& extent, F&& fn) const {
+        if (node_count == 0) return;
+        auto overlaps = [&ray, &extent](const q3AABB& aabb) {
+            q3AABB grown = {.min = aabb.min - extent, .max = aabb.max + extent};
+            return q3SegmentAABB(ray.start, ray.start + ray.dir * ray.t, grown);
+        };
+        u32 stack[q3_static_world_max_depth + 1];
+        u32 count = 0;
+        stack[count++] = 0;
+        while (count > 0) {
+            const q3StaticNode* node = nodes + stack[--count];
+            if (!overlaps(GetAABB(node))) continue;
+            if (node->count == 0) {
+                stack[count++] = node->first;
+                stack[count++] = node->first + 1;
+                continue;
+            }
+            for (u32 i = node->first; i < node->first + node->count; ++i) {
+                if (overlaps(boxes[i].GetAABB()) && !fn(i)) return;
+            }
+        }
+    }
+
+    // Returns the index of the closest box hit by the ray, or -1. The time of
+    // impact and normal are left in rayCast like q3Scene::RayCastClosest does.
+    i32 RayCastClosest(q3RaycastData& rayCast) const;
+
+    static q3AABB GetAABB(const q3StaticNode* node);
+};
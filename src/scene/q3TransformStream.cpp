@@ -0,0 +1,313 @@
+/**
+@file	q3TransformStream.cpp
+
+        This software is provided 'as-is', without any express or implied
+        warranty. In no event will the authors be held liable for any damages
+        arising from the use of this software.
+
+        Permission is granted to anyone to use this software for any purpose,
+        including commercial applications, and to alter it and redistribute it
+        freely, subject to the following restrictions:
+          1. The origin of this software must not be misrepresented; you must
+not claim that you wrote the original software. If you use this software in a
+product, an acknowledgment in the product documentation would be appreciated but
+is not required.
+          2. Altered source versions must be plainly marked as such, and must
+not be misrepresented as being the original software.
+          3. This notice may not be removed or altered from any source
+distribution.
+*/
+
+#include "q3TransformStream.h"
+#include "q3Scene.h"
+#include "../dynamics/q3Body.h"
+
+// Largest magnitude of the three smallest components of a unit quaternion
+constexpr r32 q3_smallest_three_range = r32(0.70710678);
+constexpr u32 q3_smallest_three_bits = 10;
+constexpr u32 q3_smallest_three_max = (1u << q3_smallest_three_bits) - 1;
+
+u32 q3PackQuaternion(const q3Quaternion& q) {
+    u32 largest = 0;
+    for (u32 i = 1; i < 4; ++i) {
+        if (q3Abs(q.v[i]) > q3Abs(q.v[largest])) largest = i;
+    }
+
+    // q and -q are the same rotation, the largest one is sent as positive
+    r32 sign = q.v[largest] < r32(0.0) ? r32(-1.0) : r32(1.0);
+    u32 packed = largest;
+    for (u32 i = 0; i < 4; ++i) {
+        if (i == largest) continue;
+        r32 v = q3Clamp(-q3_smallest_three_range, q3_smallest_three_range, q.v[i] * sign);
+        r32 unit = (v + q3_smallest_three_range) / (r32(2.0) * q3_smallest_three_range);
+        u32 bits = u32(unit * r32(q3_smallest_three_max) + r32(0.5));
+        packed = (packed << q3_smallest_three_bits) | bits;
+    }
+    return packed;
+}
+
+q3Quaternion q3UnpackQuaternion(u32 packed) {
+    u32 largest = packed >> (3 * q3_smallest_three_bits);
+    q3Quaternion q;
+    r32 sum = r32(0.0);
+    i32 shift = 2 * q3_smallest_three_bits;
+    for (u32 i = 0; i < 4; ++i) {
+        if (i == largest) continue;
+        u32 bits = (packed >> shift) & q3_smallest_three_max;
+        shift -= q3_smallest_three_bits;
+        r32 unit = r32(bits) / r32(q3_smallest_three_max);
+        q.v[i] = unit * r32(2.0) * q3_smallest_three_range - q3_smallest_three_range;
+        sum += q.v[i] * q.v[i];
+    }
+    q.v[largest] = std::sqrt(q3Max(r32(0.0), r32(1.0) - sum));
+    return q;
+}
+
+static void q3WriteVarint(ArrayList<u8>* bytes, u64 value) {
+    while (value >= 0x80) {
+        bytes->append(u8(value | 0x80)).unwrap();
+        value >>= 7;
+    }
+    bytes->append(u8(value)).unwrap();
+}
+
+static void q3WriteSigned(ArrayList<u8>* bytes, i64 value) {
+    q3WriteVarint(bytes, (u64(value) << 1) ^ u64(value >> 63));
+}
+
+static i32 q3Quantize(r32 value, r32 precision) {
+    return i32(std::floor(value / precision + r32(0.5)));
+}
+
+struct q3StreamReader {
+    Slice<u8> bytes;
+    usize offset;
+    bool failed;
+
+    u64 ReadVarint() {
+        u64 value = 0;
+        for (u32 shift = 0; shift < 64; shift += 7) {
+            if (offset >= bytes.len) break;
+            u8 byte = bytes[offset++];
+            value |= u64(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) return value;
+        }
+        failed = true;
+        return 0;
+    }
+
+    i64 ReadSigned() {
+        u64 value = ReadVarint();
+        return i64(value >> 1) ^ -i64(value & 1);
+    }
+
+    u32 ReadU32() {
+        if (offset + 4 > bytes.len) {
+            failed = true;
+            return 0;
+        }
+        u32 value = 0;
+        for (u32 i = 0; i < 4; ++i) value |= u32(bytes[offset++]) << (8 * i);
+        return value;
+    }
+};
+
+static ErrOrVoid q3GrowBaselines(ArrayList<q3StreamBaseline>* baselines, usize count) {
+    usize old_len = baselines->items.len;
+    if (count <= old_len) return {};
+    try_expr(baselines->resize(count));
+    for (usize i = old_len; i < count; ++i) baselines->items[i] = {};
+    return {};
+}
+
+// One body of a packet as read, before it is applied to the baselines
+struct q3StreamRecord {
+    i64 id;
+    i32 position_delta[3];
+    u32 orientation;
+    q3Vec3 velocities[2];
+};
+
+static void q3ReadStreamRecord(
+    q3StreamReader* reader, u8 flags, const q3StreamSettings& settings, q3StreamRecord* record
+) {
+    record->id += reader->ReadSigned();
+    for (i32 i = 0; i < 3; ++i) record->position_delta[i] = i32(reader->ReadSigned());
+    record->orientation = reader->ReadU32();
+    if (flags & q3_stream_velocities) {
+        for (i32 i = 0; i < 6; ++i) {
+            record->velocities[i / 3][i % 3] =
+                r32(reader->ReadSigned()) * settings.velocity_precision;
+        }
+    }
+}
+
+q3TransformEncoder::q3TransformEncoder(Allocator allocator, const q3StreamSettings& settings) :
+    settings(settings),
+    baselines(ArrayList<q3StreamBaseline>::init(allocator)),
+    bytes(ArrayList<u8>::init(allocator)) {}
+
+q3TransformEncoder::~q3TransformEncoder() {
+    baselines.deinit();
+    bytes.deinit();
+}
+
+Slice<u8> q3TransformEncoder::Encode(const q3Scene* scene, bool key_frame) {
+    q3GrowBaselines(&baselines, scene->next_body_id).unwrap();
+    if (key_frame) {
+        for (q3StreamBaseline& baseline : baselines.items) baseline = {};
+    }
+
+    // The body count is only known at the end, so the bodies are written
+    // first and moved behind the header afterwards
+    bytes.shrinkRetainingCapacity(0);
+    u32 count = 0;
+    u32 previous_id = 0;
+    r32 cos_half_threshold = std::cos(settings.rotation_threshold * r32(0.5));
+
+    for (const q3Body* body : scene->bodies.ptrIter()) {
+        if (body->flags.Static) continue;
+        q3StreamBaseline* baseline = &baselines.items[body->id];
+
+        i32 position[3];
+        for (i32 i = 0; i < 3; ++i) {
+            position[i] = q3Quantize(body->m_tx.position[i], settings.position_precision);
+        }
+        u32 orientation = q3PackQuaternion(body->m_q);
+
+        if (baseline->sent) {
+            // Distance and angle to what the client has, not to the exact
+            // values last sent, so quantization errors do not add up
+            q3Vec3 sent(
+                r32(baseline->position[0]) * settings.position_precision,
+                r32(baseline->position[1]) * settings.position_precision,
+                r32(baseline->position[2]) * settings.position_precision
+            );
+            q3Quaternion sent_q = q3UnpackQuaternion(baseline->orientation);
+            r32 dot = sent_q.x * body->m_q.x + sent_q.y * body->m_q.y + sent_q.z * body->m_q.z +
+                      sent_q.w * body->m_q.w;
+            bool moved = q3Length(body->m_tx.position - sent) > settings.position_threshold;
+            bool turned = q3Abs(dot) < cos_half_threshold;
+            if (!moved && !turned) continue;
+        }
+
+        q3WriteSigned(&bytes, i64(body->id) - i64(previous_id));
+        previous_id = body->id;
+        for (i32 i = 0; i < 3; ++i) {
+            q3WriteSigned(&bytes, i64(position[i]) - i64(baseline->position[i]));
+            baseline->position[i] = position[i];
+        }
+        for (u32 i = 0; i < 4; ++i) bytes.append(u8(orientation >> (8 * i))).unwrap();
+        baseline->orientation = orientation;
+        baseline->sent = true;
+
+        if (settings.velocities) {
+            for (i32 i = 0; i < 3; ++i) {
+                q3WriteSigned(
+                    &bytes, q3Quantize(body->m_linearVelocity[i], settings.velocity_precision)
+                );
+            }
+            for (i32 i = 0; i < 3; ++i) {
+                q3WriteSigned(
+                    &bytes, q3Quantize(body->m_angularVelocity[i], settings.velocity_precision)
+                );
+            }
+        }
+        count += 1;
+    }
+
+    // Header: flags and count
+    u8 header[11];
+    usize header_len = 0;
+    header[header_len++] =
+        (key_frame ? q3_stream_key_frame : 0) | (settings.velocities ? q3_stream_velocities : 0);
+    for (u32 value = count;; value >>= 7) {
+        if (value < 0x80) {
+            header[header_len++] = u8(value);
+            break;
+        }
+        header[header_len++] = u8(value | 0x80);
+    }
+
+    usize body_len = bytes.items.len;
+    bytes.resize(body_len + header_len).unwrap();
+    memmove(bytes.items.ptr + header_len, bytes.items.ptr, body_len);
+    memcpy(bytes.items.ptr, header, header_len);
+    return bytes.items;
+}
+
+q3TransformDecoder::q3TransformDecoder(Allocator allocator, const q3StreamSettings& settings) :
+    settings(settings),
+    baselines(ArrayList<q3StreamBaseline>::init(allocator)),
+    bodies(ArrayList<q3Body*>::init(allocator)) {}
+
+q3TransformDecoder::~q3TransformDecoder() {
+    baselines.deinit();
+    bodies.deinit();
+}
+
+ErrOrVoid q3TransformDecoder::Apply(q3Scene* scene, Slice<u8> packet) {
+    if (packet.len == 0) return Error::ParseError;
+    u8 flags = packet[0];
+
+    // The whole packet is read once before anything changes, so a malformed
+    // one leaves the baselines in step with the encoder
+    q3StreamReader reader = {.bytes = packet, .offset = 1, .failed = false};
+    u64 count = reader.ReadVarint();
+    usize body_offset = reader.offset;
+    q3StreamRecord record = {};
+    i64 max_id = -1;
+    i64 id_limit = i64(scene->next_body_id) + i64(q3_stream_id_slack);
+    for (u64 n = 0; n < count && !reader.failed; ++n) {
+        q3ReadStreamRecord(&reader, flags, settings, &record);
+        if (record.id < 0 || record.id >= id_limit) return Error::ParseError;
+        if (record.id > max_id) max_id = record.id;
+    }
+    if (reader.failed || reader.offset != packet.len) return Error::ParseError;
+    try_expr(q3GrowBaselines(&baselines, usize(max_id + 1)));
+
+    if (flags & q3_stream_key_frame) {
+        for (q3StreamBaseline& baseline : baselines.items) baseline = {};
+    }
+
+    // Body lookup by id, rebuilt if a body was created or removed
+    bool stale = bodies.items.len != scene->next_body_id;
+    for (q3Body* body : scene->bodies.ptrIter()) {
+        if (stale) break;
+        stale = bodies.items[body->id] != body;
+    }
+    if (stale) {
+        bodies.resize(scene->next_body_id).unwrap();
+        for (q3Body*& body : bodies.items) body = nullptr;
+        for (q3Body* body : scene->bodies.ptrIter()) bodies.items[body->id] = body;
+    }
+
+    // Second pass, the ids are delta coded from zero again
+    reader.offset = body_offset;
+    record.id = 0;
+    for (u64 n = 0; n < count; ++n) {
+        q3ReadStreamRecord(&reader, flags, settings, &record);
+        usize index = usize(record.id);
+        q3StreamBaseline* baseline = &baselines.items[index];
+
+        q3Vec3 position;
+        for (i32 i = 0; i < 3; ++i) {
+            baseline->position[i] += record.position_delta[i];
+            position[i] = r32(baseline->position[i]) * settings.position_precision;
+        }
+        q3Quaternion q = q3UnpackQuaternion(record.orientation);
+
+        q3Body* body = index < bodies.items.len ? bodies.items[index] : nullptr;
+        if (body == nullptr) continue;
+        body->m_q = q;
+        body->m_tx.position = position;
+        body->m_tx.rotation = q.ToMat3();
+        body->m_worldCenter = position + q3Mul(body->m_tx.rotation, body->m_localCenter);
+        body->SynchronizeProxies();
+        if ((flags & q3_stream_velocities) && !body->flags.Static) {
+            body->m_linearVelocity = record.velocities[0];
+            body->m_angularVelocity = record.velocities[1];
+        }
+    }
+    return {};
+}
@@ -0,0 +1,103 @@
+/**
+@file	q3TransformStream.h
+
+        This software is provided 'as-is', without any express or implied
+        warranty. In no event will the authors be held liable for any damages
+        arising from the use of this software.
+
+        Permission is granted to anyone to use this software for any purpose,
+        including commercial applications, and to alter it and redistribute it
+        freely, subject to the following restrictions:
+          1. The origin of this software must not be misrepresented; you must
+not claim that you wrote the original software. If you use this software in a
+product, an acknowledgment in the product documentation would be appreciated but
+is not required.
+          2. Altered source versions must be plainly marked as such, and must
+not be misrepresented as being the original software.
+          3. This notice may not be removed or altered from any source
+distribution.
+*/
+
+
+#pragma once
+
+#include "../common/q3Types.h"
+#include "../math/q3Math.h"
+
+// Compact replication of body transforms from a server scene to client
+// scenes built with the same bodies (bodies are matched by q3Body::id):
+//
+//     encoder.Encode(&server_scene);              // After every server Step
+//     Send(encoder.bytes.items);
+//     ...
+//     decoder.Apply(&client_scene, received).unwrap();
+//
+// Only bodies that moved or turned more than a threshold since they were
+// last sent are written. Static bodies never are. Positions are fixed point
+// and written as varint deltas to the last position sent, orientations as
+// the three smallest quaternion components in 32 bits. Because of the deltas
+// the packets must arrive reliably and in order; a key frame (every body,
+// deltas to zero) resynchronizes a client that missed some or just joined.
+//
+// Packet layout:
+//
+//     u8 flags                     q3_stream_key_frame, q3_stream_velocities
+//     varint count
+//     count times:
+//         varint id delta          zigzag, to the previous body of the packet
+//         varint position[3]       zigzag, in position_precision units
+//         u32 orientation          2 bit largest component, 3 x 10 bits
+//         varint velocity[6]       zigzag, linear then angular, if enabled
+
+constexpr u8 q3_stream_key_frame = 1;
+constexpr u8 q3_stream_velocities = 2;
+// Ids a packet may have past the decoding scene's next body id, for bodies
+// the server created that the client has not yet
+constexpr u32 q3_stream_id_slack = 1 << 16;
+
+// Has to be the same on both ends
+struct q3StreamSettings {
+    r32 position_precision = r32(1.0 / 1024.0); // Meters
+    r32 velocity_precision = r32(1.0 / 256.0);
+    r32 position_threshold = r32(1.0 / 512.0); // Meters moved before resending
+    r32 rotation_threshold = r32(0.004);       // Radians turned before resending
+    bool velocities = true; // Also send velocities, e.g. for extrapolation
+};
+
+// Last values sent for a body, indexed by body id on both ends
+struct q3StreamBaseline {
+    i32 position[3]; // Quantized
+    u32 orientation; // Packed, encoder only
+    bool sent;
+};
+
+struct q3TransformEncoder {
+    q3StreamSettings settings;
+    ArrayList<q3StreamBaseline> baselines;
+    ArrayList<u8> bytes; // The packet of the last Encode
+
+    q3TransformEncoder(Allocator allocator, const q3StreamSettings& settings = {});
+    ~q3TransformEncoder();
+
+    // Writes the packet for the current state of scene into bytes. A key
+    // frame includes every non-static body.
+    Slice<u8> Encode(const q3Scene* scene, bool key_frame = false);
+};
+
+struct q3TransformDecoder {
+    q3StreamSettings settings;
+    ArrayList<q3StreamBaseline> baselines;
+    ArrayList<q3Body*> bodies; // By id, rebuilt when the scene's bodies change
+
+    q3TransformDecoder(Allocator allocator, const q3StreamSettings& settings = {});
+    ~q3TransformDecoder();
+
+    // Moves the bodies of scene to the transforms (and velocities) in packet.
+    // Ids without a body are skipped. Error::ParseError for a truncated or
+    // malformed packet, which changes neither the scene nor the baselines.
+    ErrOrVoid Apply(q3Scene* scene, Slice<u8> packet);
+};
+
+// Smallest three quaternion encoding, exposed for tools
+u32 q3PackQuaternion(const q3Quaternion& q);
+q3Quaternion q3UnpackQuaternion(u32 packed);
@@ -5,11 +5,40 @@
 #include "base.cpp"
 #include "debug.cpp"
 
+// With -DQ3_STEP_STATS every allocator call is counted in `allocator_stats`,
+// otherwise the counting compiles out.
+#ifdef Q3_STEP_STATS
+#include <atomic>
+
+struct AllocatorStats {
+    std::atomic<usize> alloc_calls; // alloc, create and realloc
+    std::atomic<usize> free_calls;  // free and destroy
+    std::atomic<usize> live_bytes;
+};
+
+inline AllocatorStats allocator_stats;
+
+inline void allocatorStatsAlloc(usize bytes) {
+    allocator_stats.alloc_calls.fetch_add(1, std::memory_order_relaxed);
+    allocator_stats.live_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+inline void allocatorStatsFree(usize bytes) {
+    allocator_stats.free_calls.fetch_add(1, std::memory_order_relaxed);
+    allocator_stats.live_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+#define ALLOCATOR_STATS(...) __VA_ARGS__
+#else
+#define ALLOCATOR_STATS(...)
+#endif
+
 struct Allocator {
     template <typename T>
     ErrOr<Slice<T>> alloc(usize n) {
         T* ptr = (T*)malloc(sizeof(T) * n);
         debug::assert(ptr != nullptr);
+        ALLOCATOR_STATS(allocatorStatsAlloc(sizeof(T) * n));
         return Slice<T>(ptr, n);
     }
 
@@ -25,6 +54,7 @@ struct Allocator {
     ErrOr<T*> create() {
         T* ptr = (T*)malloc(sizeof(T));
         debug::assert(ptr != nullptr);
+        ALLOCATOR_STATS(allocatorStatsAlloc(sizeof(T)));
         // debug::print("created %p\n", ptr);
         // debug::printStackTrace(stderr);
         *ptr = undefined;
@@ -33,6 +63,8 @@ struct Allocator {
 
     template <typename T>
     void free(Slice<T> memory) {
+        if (memory.ptr == nullptr) return;
+        ALLOCATOR_STATS(allocatorStatsFree(sizeof(T) * memory.len));
         ::free(memory.ptr);
     }
 
@@ -43,6 +75,7 @@ struct Allocator {
 
     template <typename T>
     void destroy(T* ptr) {
+        ALLOCATOR_STATS(allocatorStatsFree(sizeof(T)));
         *ptr = undefined;
         ::free((void*)ptr);
         // debug::print("destroyed %p\n", ptr);
@@ -53,12 +86,16 @@ struct Allocator {
     ErrOr<Slice<T>> realloc(Slice<T> old_mem, usize new_len) {
         T* ptr = (T*)::realloc(old_mem.ptr, sizeof(T) * new_len);
         debug::assert(ptr != nullptr);
+        // Counted as one allocation call that grows (or shrinks) the live bytes
+        ALLOCATOR_STATS(allocatorStatsAlloc(sizeof(T) * new_len - sizeof(T) * old_mem.len));
         return Slice<T>(ptr, new_len);
     }
 
     template <typename T>
     Slice<T> shrink(Slice<T> old_mem, usize new_len) {
         debug::assert(new_len <= old_mem.len);
+        // The tail is freed with the shorter slice later, so it stops counting now
+        ALLOCATOR_STATS(allocator_stats.live_bytes -= sizeof(T) * (old_mem.len - new_len));
         // TODO: other allocators should call the vtable resize, but c allocator
         // doesnt need to do anything
         return Slice<T>(old_mem.ptr, new_len);
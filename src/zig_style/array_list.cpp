@@ -70,7 +70,7 @@ struct ArrayList {
     }
 
     ErrOrVoid resize(usize new_len) {
-        this->ensureTotalCapacity(new_len);
+        try_expr(this->ensureTotalCapacity(new_len));
         this->items.len = new_len;
         return {};
     }
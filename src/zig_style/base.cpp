@@ -88,8 +88,9 @@ static Dst ptrCast(Src src_ptr) {
 }
 
 struct Undefined {
+    // aligned like T so over-aligned types (SIMD vectors) can be read from it
     template <typename T>
-    struct UndefinedBytes {
+    struct alignas(T) UndefinedBytes {
         u8 bytes[sizeof(T)];
 
         constexpr UndefinedBytes() {